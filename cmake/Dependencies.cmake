@@ -24,9 +24,13 @@ list(APPEND Caffe_LINKER_LIBS ${GFLAGS_LIBRARIES})
 include(cmake/ProtoBuf.cmake)
 
 # ---[ HDF5
-find_package(HDF5 COMPONENTS HL REQUIRED)
-include_directories(SYSTEM ${HDF5_INCLUDE_DIRS} ${HDF5_HL_INCLUDE_DIR})
-list(APPEND Caffe_LINKER_LIBS ${HDF5_LIBRARIES} ${HDF5_HL_LIBRARIES})
+if(INFERENCE_ONLY)
+  add_definitions(-DINFERENCE_ONLY)
+else()
+  find_package(HDF5 COMPONENTS HL REQUIRED)
+  include_directories(SYSTEM ${HDF5_INCLUDE_DIRS} ${HDF5_HL_INCLUDE_DIR})
+  list(APPEND Caffe_LINKER_LIBS ${HDF5_LIBRARIES} ${HDF5_HL_LIBRARIES})
+endif()
 
 # ---[ LMDB
 if(USE_LMDB)
@@ -92,6 +96,7 @@ if(NOT APPLE)
     find_package(OpenBLAS REQUIRED)
     include_directories(SYSTEM ${OpenBLAS_INCLUDE_DIR})
     list(APPEND Caffe_LINKER_LIBS ${OpenBLAS_LIB})
+    add_definitions(-DUSE_OPENBLAS)
   elseif(BLAS STREQUAL "MKL" OR BLAS STREQUAL "mkl")
     find_package(MKL REQUIRED)
     include_directories(SYSTEM ${MKL_INCLUDE_DIR})
@@ -0,0 +1,173 @@
+################################################################################################
+# Helper function returning the layer types a source registers with REGISTER_LAYER_CLASS or
+# REGISTER_LAYER_CREATOR
+# Usage:
+#   caffe_registered_layer_types(<output_variable> <source>)
+function(caffe_registered_layer_types variable source)
+  file(STRINGS ${source} __lines REGEX "^REGISTER_LAYER_(CLASS|CREATOR)\\(")
+  set(__types "")
+  foreach(__line ${__lines})
+    string(REGEX REPLACE "^REGISTER_LAYER_[A-Z]+\\(([A-Za-z0-9_]+).*" "\\1" __type "${__line}")
+    list(APPEND __types ${__type})
+  endforeach()
+  set(${variable} ${__types} PARENT_SCOPE)
+endfunction()
+
+################################################################################################
+# Helper function returning what a layer (or other) source needs besides itself: the layers whose
+# headers it or its own header includes, and the layer types it creates through the registry
+# Usage:
+#   caffe_layer_dependencies(<layers_variable> <types_variable> <source>)
+function(caffe_layer_dependencies layers_variable types_variable source)
+  get_filename_component(__name ${source} NAME_WE)
+  set(__files ${source})
+  if(EXISTS ${PROJECT_SOURCE_DIR}/include/caffe/layers/${__name}.hpp)
+    list(APPEND __files ${PROJECT_SOURCE_DIR}/include/caffe/layers/${__name}.hpp)
+  endif()
+  set(__layers "")
+  set(__types "")
+  foreach(__file ${__files})
+    file(STRINGS ${__file} __includes REGEX "#include \"caffe/layers/[a-z0-9_]+\\.hpp\"")
+    foreach(__line ${__includes})
+      string(REGEX REPLACE ".*caffe/layers/([a-z0-9_]+)\\.hpp.*" "\\1" __layer "${__line}")
+      list(APPEND __layers ${__layer})
+    endforeach()
+    file(STRINGS ${__file} __created REGEX "set_type\\(\"[A-Za-z0-9_]+\"\\)")
+    foreach(__line ${__created})
+      string(REGEX REPLACE ".*set_type\\(\"([A-Za-z0-9_]+)\"\\).*" "\\1" __type "${__line}")
+      list(APPEND __types ${__type})
+    endforeach()
+  endforeach()
+  set(${layers_variable} ${__layers} PARENT_SCOPE)
+  set(${types_variable} ${__types} PARENT_SCOPE)
+endfunction()
+
+################################################################################################
+# Removes from the Caffe sources what an inference-only library does without: the solvers,
+# parallel training and HDF5. If INFERENCE_LAYERS_FROM lists deploy prototxts, also removes the
+# layers none of those nets uses, directly or through the layers it uses, and generates the
+# whitelist of the types layer_factory.cpp registers.
+# Usage:
+#   caffe_inference_only_sources(<srcs_variable> <cuda_variable>)
+function(caffe_inference_only_sources srcs_variable cuda_variable)
+  set(__srcs ${${srcs_variable}})
+  set(__cuda ${${cuda_variable}})
+  set(__training "")
+  foreach(__file ${__srcs} ${__cuda})
+    if(__file MATCHES "/src/caffe/(solver|parallel)\\.(cpp|cu)$" OR
+       __file MATCHES "/src/caffe/solvers/" OR
+       __file MATCHES "/src/caffe/util/hdf5\\.cpp$" OR
+       __file MATCHES "/src/caffe/layers/hdf5_[a-z_]+\\.(cpp|cu)$")
+      list(APPEND __training ${__file})
+    endif()
+  endforeach()
+  if(__training)
+    list(REMOVE_ITEM __srcs ${__training})
+    list(REMOVE_ITEM __cuda ${__training})
+  endif()
+
+  if(NOT INFERENCE_LAYERS_FROM)
+    set(${srcs_variable} ${__srcs} PARENT_SCOPE)
+    set(${cuda_variable} ${__cuda} PARENT_SCOPE)
+    return()
+  endif()
+
+  # the layer types of the nets, quoted either way
+  set(__types "")
+  foreach(__model ${INFERENCE_LAYERS_FROM})
+    file(STRINGS ${__model} __lines REGEX "type *: *[\"'][A-Za-z0-9_]+[\"']")
+    set(__model_types "")
+    foreach(__line ${__lines})
+      string(REGEX REPLACE ".*type *: *[\"']([A-Za-z0-9_]+)[\"'].*" "\\1" __type "${__line}")
+      list(APPEND __model_types ${__type})
+    endforeach()
+    if(NOT __model_types)
+      message(FATAL_ERROR "No layer types found in ${__model}; "
+                          "upgrade it to the current format with upgrade_net_proto_text.")
+    endif()
+    list(APPEND __types ${__model_types})
+  endforeach()
+
+  # The layer sources registering types are built only if their types are needed. The other
+  # sources are always built, and so are the layers they need.
+  set(__registering "")
+  set(__needed_layers "")
+  foreach(__file ${__srcs})
+    if(__file MATCHES "\\.cpp$")
+      caffe_registered_layer_types(__registered ${__file})
+      get_filename_component(__name ${__file} NAME_WE)
+      if(__registered AND __file MATCHES "/src/caffe/layers/")
+        list(APPEND __registering ${__name})
+        set(__registered_${__name} ${__registered})
+        set(__source_${__name} ${__file})
+      else()
+        # only layers need the code of the layers they include
+        caffe_layer_dependencies(__layers __created ${__file})
+        if(__file MATCHES "/src/caffe/layers/")
+          list(APPEND __needed_layers ${__layers})
+        endif()
+        list(APPEND __types ${__created})
+      endif()
+    endif()
+  endforeach()
+
+  set(__kept "")
+  set(__changed TRUE)
+  while(__changed)
+    set(__changed FALSE)
+    foreach(__layer ${__needed_layers})
+      list(FIND __registering ${__layer} __index)
+      if(NOT __index EQUAL -1)
+        list(APPEND __types ${__registered_${__layer}})
+      endif()
+    endforeach()
+    set(__needed_layers "")
+    foreach(__name ${__registering})
+      list(FIND __kept ${__name} __index)
+      if(__index EQUAL -1)
+        foreach(__type ${__registered_${__name}})
+          list(FIND __types ${__type} __type_index)
+          if(NOT __type_index EQUAL -1)
+            list(FIND __kept ${__name} __index)
+            if(__index EQUAL -1)
+              list(APPEND __kept ${__name})
+              caffe_layer_dependencies(__layers __created ${__source_${__name}})
+              list(APPEND __needed_layers ${__layers})
+              list(APPEND __types ${__created})
+              set(__changed TRUE)
+            endif()
+          endif()
+        endforeach()
+      endif()
+    endforeach()
+  endwhile()
+
+  foreach(__name ${__registering})
+    list(FIND __kept ${__name} __index)
+    if(__index EQUAL -1)
+      list(REMOVE_ITEM __srcs ${__source_${__name}})
+      string(REGEX REPLACE "\\.cpp$" ".cu" __cu ${__source_${__name}})
+      list(REMOVE_ITEM __cuda ${__cu})
+    endif()
+  endforeach()
+
+  # the types registered by layer_factory.cpp, whose classes are always built
+  caffe_list_unique(__types)
+  string(REPLACE ";" ", " __models "${INFERENCE_LAYERS_FROM}")
+  set(__whitelist "// Generated from ${__models}; do not edit.\n")
+  foreach(__type ${__types})
+    set(__whitelist "${__whitelist}#define CAFFE_USE_LAYER_${__type}\n")
+  endforeach()
+  file(WRITE ${PROJECT_BINARY_DIR}/caffe_layer_whitelist.h.tmp "${__whitelist}")
+  # only touch the header when it changes, not to rebuild layer_factory.cpp each time
+  execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different
+                  ${PROJECT_BINARY_DIR}/caffe_layer_whitelist.h.tmp
+                  ${PROJECT_BINARY_DIR}/caffe_layer_whitelist.h)
+  set_property(SOURCE ${PROJECT_SOURCE_DIR}/src/caffe/layer_factory.cpp
+               APPEND PROPERTY COMPILE_DEFINITIONS CAFFE_LAYER_WHITELIST)
+
+  string(REPLACE ";" ", " __list "${__kept}")
+  message(STATUS "Inference-only registered layer sources: ${__list}")
+  set(${srcs_variable} ${__srcs} PARENT_SCOPE)
+  set(${cuda_variable} ${__cuda} PARENT_SCOPE)
+endfunction()
@@ -114,6 +114,10 @@ function(caffe_print_configuration_summary)
   caffe_status("  BUILD_matlab      :   ${BUILD_matlab}")
   caffe_status("  BUILD_docs        :   ${BUILD_docs}")
   caffe_status("  CPU_ONLY          :   ${CPU_ONLY}")
+  caffe_status("  INFERENCE_ONLY    :   ${INFERENCE_ONLY}")
+  if(INFERENCE_ONLY AND INFERENCE_LAYERS_FROM)
+    caffe_status("  Layers from       :   ${INFERENCE_LAYERS_FROM}")
+  endif()
   caffe_status("  USE_OPENCV        :   ${USE_OPENCV}")
   caffe_status("  USE_LEVELDB       :   ${USE_LEVELDB}")
   caffe_status("  USE_LMDB          :   ${USE_LMDB}")
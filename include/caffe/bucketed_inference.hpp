@@ -0,0 +1,75 @@
+#ifndef CAFFE_BUCKETED_INFERENCE_HPP_
+#define CAFFE_BUCKETED_INFERENCE_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/inference_session.hpp"
+#include "caffe/net.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Runs the inputs of varying shapes of a single input net without
+ *        reshaping it, by padding each to one of a few planned shapes.
+ *
+ * Each bucket, i.e. planned input shape, has its own context of the shared
+ * InferenceSession, reshaped and run once up front: its activations and
+ * layer scratch buffers are allocated and its layers' shape dependent state
+ * computed once. An input is then copied into the smallest bucket holding
+ * it in every axis, at the origin and padded with pad_value, and that
+ * bucket's net runs as is: switching between sizes costs no Net::Reshape
+ * and no allocation. The caller crops the outputs to the region of the
+ * input if needed, e.g. for fully convolutional nets.
+ *
+ * Inputs larger than every bucket run in a spare context, reshaped for each
+ * of them.
+ */
+template <typename Dtype>
+class BucketedInference {
+ public:
+  BucketedInference(shared_ptr<InferenceSession<Dtype> > session,
+      const vector<vector<int> >& bucket_shapes, Dtype pad_value = 0);
+
+  /**
+   * @brief Returns the smallest bucket holding an input of shape, i.e. of
+   *        the least count, or -1 if none does.
+   */
+  int FindBucket(const vector<int>& shape) const;
+
+  /**
+   * @brief Runs input in its bucket and returns the outputs of the bucket's
+   *        net, valid until the next call.
+   * @param bucket if not NULL, set to the bucket run, or -1 for the spare
+   *        context.
+   */
+  const vector<Blob<Dtype>*>& Forward(const Blob<Dtype>& input,
+      int* bucket = NULL);
+
+  int num_buckets() const { return buckets_.size(); }
+  const vector<int>& bucket_shape(int bucket) const {
+    return bucket_shapes_[bucket];
+  }
+  Net<Dtype>* bucket_net(int bucket) { return buckets_[bucket]->net(); }
+
+ protected:
+  shared_ptr<InferenceSession<Dtype> > session_;
+  vector<vector<int> > bucket_shapes_;
+  vector<shared_ptr<InferenceContext<Dtype> > > buckets_;
+  shared_ptr<InferenceContext<Dtype> > spare_;
+  const Dtype pad_value_;
+
+  DISABLE_COPY_AND_ASSIGN(BucketedInference);
+};
+
+/**
+ * @brief Copies src into the origin of dst, which is at least as large in
+ *        every axis, and sets the rest of dst to pad_value.
+ */
+template <typename Dtype>
+void PadCopy(const Blob<Dtype>& src, Dtype pad_value, Blob<Dtype>* dst);
+
+}  // namespace caffe
+
+#endif  // CAFFE_BUCKETED_INFERENCE_HPP_
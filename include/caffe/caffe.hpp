@@ -5,8 +5,10 @@
 #define CAFFE_CAFFE_HPP_
 
 #include "caffe/blob.hpp"
+#include "caffe/bucketed_inference.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/inference_session.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/layer_factory.hpp"
 #include "caffe/net.hpp"
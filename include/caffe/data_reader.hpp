@@ -9,6 +9,7 @@
 #include "caffe/internal_thread.hpp"
 #include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
+#include "caffe/util/ring_queue.hpp"
 
 namespace caffe {
 
@@ -25,22 +26,26 @@ class DataReader {
   explicit DataReader(const LayerParameter& param);
   ~DataReader();
 
-  inline BlockingQueue<Datum*>& free() const {
+  inline RingQueue<Datum*>& free() const {
     return queue_pair_->free_;
   }
-  inline BlockingQueue<Datum*>& full() const {
+  inline RingQueue<Datum*>& full() const {
     return queue_pair_->full_;
   }
 
  protected:
-  // Queue pairs are shared between a body and its readers
+  // Queue pairs are shared between a body and its readers. Their datums,
+  // allocated together once, are recycled between the queues and parsed
+  // into in place, reusing the buffers they grew to hold earlier records.
+  // Each queue has a single producer and a single consumer: the body's
+  // thread and the prefetch thread of the reader's layer.
   class QueuePair {
    public:
     explicit QueuePair(int size);
-    ~QueuePair();
 
-    BlockingQueue<Datum*> free_;
-    BlockingQueue<Datum*> full_;
+    vector<Datum> datums_;
+    RingQueue<Datum*> free_;
+    RingQueue<Datum*> full_;
 
   DISABLE_COPY_AND_ASSIGN(QueuePair);
   };
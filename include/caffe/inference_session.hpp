@@ -0,0 +1,91 @@
+#ifndef CAFFE_INFERENCE_SESSION_HPP_
+#define CAFFE_INFERENCE_SESSION_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+template <typename Dtype>
+class InferenceContext;
+
+/**
+ * @brief One immutable set of trained weights for TEST phase inference,
+ *        shared by any number of InferenceContext%s, one per thread.
+ *
+ * Each context is a Net of its own, with its own activations and layer
+ * scratch buffers (e.g. the im2col buffers), whose parameters are the
+ * session's. The weights are synchronized to the device of the session up
+ * front, so that concurrent forward passes only read them. Layers updating
+ * their parameters in the forward pass, i.e. BatchNorm without global
+ * statistics, are rejected.
+ */
+template <typename Dtype>
+class InferenceSession {
+ public:
+  /**
+   * @param param the net, built in the TEST phase whatever its state says.
+   * @param weights an optional .caffemodel or .h5 file of trained weights.
+   *
+   * The contexts run in the Caffe mode and on the device current in the
+   * thread creating the session.
+   */
+  explicit InferenceSession(const NetParameter& param,
+      const string& weights = "");
+  explicit InferenceSession(const string& param_file,
+      const string& weights = "");
+
+  /// @brief Creates a context; safe to call from several threads.
+  shared_ptr<InferenceContext<Dtype> > CreateContext() const;
+
+  /// @brief The net owning the weights. Not to be run.
+  const Net<Dtype>& weights() const { return *weights_; }
+  const NetParameter& param() const { return param_; }
+
+ protected:
+  void Init(const NetParameter& param, const string& weights);
+
+  NetParameter param_;
+  shared_ptr<Net<Dtype> > weights_;
+  Caffe::Brew mode_;
+  int device_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceSession);
+};
+
+/**
+ * @brief The activations and scratch buffers of one thread running an
+ *        InferenceSession. A context is used by one thread at a time.
+ */
+template <typename Dtype>
+class InferenceContext {
+ public:
+  /// @brief The net of the context: fill its inputs, read its outputs.
+  Net<Dtype>* net() { return net_.get(); }
+
+  /**
+   * @brief Runs the net forward in the calling thread, after setting the
+   *        thread's Caffe mode and device to the session's.
+   */
+  const vector<Blob<Dtype>*>& Forward(Dtype* loss = NULL);
+
+ protected:
+  InferenceContext(const InferenceSession<Dtype>& session,
+      Caffe::Brew mode, int device);
+
+  shared_ptr<Net<Dtype> > net_;
+  const Caffe::Brew mode_;
+  const int device_;
+
+  friend class InferenceSession<Dtype>;
+  DISABLE_COPY_AND_ASSIGN(InferenceContext);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_SESSION_HPP_
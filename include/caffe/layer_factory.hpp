@@ -78,9 +78,10 @@ class LayerRegistry {
     }
     const string& type = param.type();
     CreatorRegistry& registry = Registry();
-    CHECK_EQ(registry.count(type), 1) << "Unknown layer type: " << type
+    typename CreatorRegistry::const_iterator creator = registry.find(type);
+    CHECK(creator != registry.end()) << "Unknown layer type: " << type
         << " (known types: " << LayerTypeListString() << ")";
-    return registry[type](param);
+    return creator->second(param);
   }
 
   static vector<string> LayerTypeList() {
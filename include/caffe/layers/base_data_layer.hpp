@@ -8,7 +8,7 @@
 #include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
-#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/ring_queue.hpp"
 
 namespace caffe {
 
@@ -73,12 +73,23 @@ class BasePrefetchingDataLayer :
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  /**
+   * @brief Reports to the Profiler how long the running load_batch spent
+   *        reading (and decoding) and transforming its items.
+   */
+  void ProfileLoadBatch(double read_us, double transform_us);
 
   Batch<Dtype> prefetch_[PREFETCH_COUNT];
-  BlockingQueue<Batch<Dtype>*> prefetch_free_;
-  BlockingQueue<Batch<Dtype>*> prefetch_full_;
+  // Lock-free hand-offs with the prefetch thread. They take any number of
+  // consumers, as solvers running in parallel share the data layers.
+  RingQueue<Batch<Dtype>*> prefetch_free_;
+  RingQueue<Batch<Dtype>*> prefetch_full_;
 
   Blob<Dtype> transformed_data_;
+
+ private:
+  // Profiler time at which the running load_batch started, or -1.
+  int64_t load_batch_start_us_;
 };
 
 }  // namespace caffe
@@ -24,6 +24,13 @@ namespace caffe {
  *   parameters, but they take the opposite sense as in ConvolutionLayer (so
  *   padding is removed from the output rather than added to the input, and
  *   stride results in upsampling rather than downsampling).
+ *
+ *   On the CPU, 2D upsampling whose kernel is a multiple of the stride, e.g.
+ *   kernel 2 * stride as in learned and bilinear upsampling, is computed as a
+ *   sub-pixel convolution: each of the stride_h * stride_w phases of the output
+ *   is a small convolution of the input, computed by one gemm for all phases
+ *   and interleaved into the output, without col2im. force_nd_im2col selects
+ *   the general path.
  */
 template <typename Dtype>
 class DeconvolutionLayer : public BaseConvolutionLayer<Dtype> {
@@ -31,6 +38,9 @@ class DeconvolutionLayer : public BaseConvolutionLayer<Dtype> {
   explicit DeconvolutionLayer(const LayerParameter& param)
       : BaseConvolutionLayer<Dtype>(param) {}
 
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
   virtual inline const char* type() const { return "Deconvolution"; }
 
  protected:
@@ -44,6 +54,25 @@ class DeconvolutionLayer : public BaseConvolutionLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual inline bool reverse_dimensions() { return true; }
   virtual void compute_output_shape();
+
+  /// @brief Rearranges the weights into phase_weight_.
+  void phase_weights_cpu(const Dtype* weights);
+  /// @brief The sub-pixel forward pass of one image.
+  void forward_cpu_phases(const Dtype* input, Dtype* output);
+
+  /// @brief Whether Forward_cpu takes the sub-pixel path.
+  bool use_phases_;
+  /// @brief The kernel taps per stride, kernel / stride, along h and w.
+  int taps_h_, taps_w_;
+  /// @brief The first phase row and column of the output, and their number.
+  int phase_h_begin_, phase_w_begin_;
+  int phase_height_, phase_width_;
+  /// @brief The weights as a gemm from the taps to the phases, per group.
+  Blob<Dtype> phase_weight_;
+  /// @brief The input at the taps of each phase position.
+  Blob<Dtype> phase_col_buffer_;
+  /// @brief The phases of the output before interleaving.
+  Blob<Dtype> phase_output_;
 };
 
 }  // namespace caffe
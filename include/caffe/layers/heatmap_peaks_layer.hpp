@@ -0,0 +1,73 @@
+#ifndef CAFFE_HEATMAP_PEAKS_LAYER_HPP_
+#define CAFFE_HEATMAP_PEAKS_LAYER_HPP_
+
+#include <utility>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Finds the peaks of each channel of heatmaps, e.g. the keypoints of
+ *        several people: the pixels that are the maximum of the
+ *        kernel_size x kernel_size window around them and reach the
+ *        threshold. The top_k highest are output for each channel.
+ *
+ * The window maxima are computed separably, along the rows and then along
+ * the columns, so that the suppression is one pass over each plane.
+ *
+ * NOTE: does not implement Backwards operation.
+ */
+template <typename Dtype>
+class HeatmapPeaksLayer : public Layer<Dtype> {
+ public:
+  explicit HeatmapPeaksLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "HeatmapPeaks"; }
+  virtual inline int ExactNumBottomBlobs() const { return 1; }
+  virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline int MaxTopBlobs() const { return 2; }
+
+ protected:
+  /**
+   * @param bottom input Blob vector (length 1)
+   *   -# @f$ (N \times C \times H \times W) @f$
+   *      the heatmaps
+   * @param top output Blob vector (length 1 or 2)
+   *   -# @f$ (N \times C \times K \times 3) @f$
+   *      the peaks of each channel as (x, y, value), highest first; the rows
+   *      beyond the peaks found are (-1, -1, 0)
+   *   -# @f$ (N \times C) @f$
+   *      the number of peaks output for each channel
+   */
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  /// @brief Not implemented (non-differentiable function)
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    NOT_IMPLEMENTED;
+  }
+
+  int radius_;
+  Dtype threshold_;
+  int top_k_;
+  int height_, width_;
+  /// the maxima of the windows along each row of a plane
+  Blob<Dtype> row_max_;
+  /// the maxima of the windows around a row
+  Blob<Dtype> window_max_;
+  /// the peaks of a plane, as (value, index)
+  vector<std::pair<Dtype, int> > peaks_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_HEATMAP_PEAKS_LAYER_HPP_
@@ -17,6 +17,10 @@ namespace caffe {
 /**
  * @brief Provides data to the Net from image files.
  *
+ * The images are decoded ahead of the batches by image_data_param's
+ * decode_threads reader threads, into a ring buffer of decode_ahead images
+ * handed out in list order.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
@@ -37,8 +41,22 @@ class ImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
   virtual void ShuffleImages();
   virtual void load_batch(Batch<Dtype>* batch);
 
-  vector<std::pair<std::string, int> > lines_;
+  // Returns the path of a line, relative to the root folder.
+  const char* path(int line) const {
+    return &path_arena_[lines_[line].first];
+  }
+  // Returns (a copy of) the next line to read, reshuffling lines_ at the end
+  // of each epoch.
+  std::pair<int, int> NextLine();
+
+  // The distinct paths of the list, each terminated by '\0', back to back.
+  vector<char> path_arena_;
+  // The offset of each line's path in path_arena_ and its label.
+  vector<std::pair<int, int> > lines_;
   int lines_id_;
+
+  class Decoder;
+  shared_ptr<Decoder> decoder_;
 };
 
 
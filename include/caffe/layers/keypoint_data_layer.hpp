@@ -0,0 +1,63 @@
+#ifndef CAFFE_KEYPOINT_DATA_LAYER_HPP_
+#define CAFFE_KEYPOINT_DATA_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/data_reader.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/internal_thread.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Provides images and keypoint heatmaps to the Net from a LevelDB or
+ *        LMDB of Datums with keypoint annotations, e.g. made by
+ *        tools/convert_keypoints.
+ *
+ * The records are read by a DataReader as for DataLayer, given by
+ * data_param, and the images transformed by transform_param, which may not
+ * crop or mirror them as that would move the keypoints. The heatmaps are
+ * rendered as for HeatmapDataLayer, given by the label_height, label_width
+ * and label_sigma of heatmap_data_param.
+ *
+ * Tops:
+ *   -# the images, @f$ (N \times C \times H \times W) @f$
+ *   -# one heatmap per keypoint, @f$ (N \times K \times H_l \times W_l) @f$,
+ *      all zero for keypoints not visible
+ */
+template <typename Dtype>
+class KeypointDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  explicit KeypointDataLayer(const LayerParameter& param);
+  virtual ~KeypointDataLayer();
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // KeypointDataLayer uses DataReader instead for sharing for parallelism
+  virtual inline bool ShareInParallel() const { return false; }
+  virtual inline const char* type() const { return "KeypointData"; }
+  virtual inline int ExactNumBottomBlobs() const { return 0; }
+  virtual inline int ExactNumTopBlobs() const { return 2; }
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch);
+
+  DataReader reader_;
+};
+
+/**
+ * @brief Renders the keypoints of datum, in the pixel coordinates of an
+ *        image of height x width, as one Gaussian heatmap each of
+ *        label_height x label_width, as HeatmapDataLayer does. The heatmaps
+ *        of keypoints not visible are zero.
+ */
+template <typename Dtype>
+void RenderKeypointHeatmaps(const Datum& datum, int height, int width,
+    int label_height, int label_width, float sigma, Dtype* heatmaps);
+
+}  // namespace caffe
+
+#endif  // CAFFE_KEYPOINT_DATA_LAYER_HPP_
@@ -0,0 +1,60 @@
+#ifndef CAFFE_RESIZE_LAYER_HPP_
+#define CAFFE_RESIZE_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Resizes the height and width of a Blob by nearest or bilinear
+ *        interpolation, e.g. to upsample feature maps without a fixed
+ *        bilinear DeconvolutionLayer.
+ *
+ * The output size is that of the optional second bottom, or given by
+ * ResizeParameter. Bilinear interpolation is separable: the input rows are
+ * resampled to the output width, and the output rows blend two of them with
+ * BLAS; the backward pass runs the same steps transposed.
+ */
+template <typename Dtype>
+class ResizeLayer : public Layer<Dtype> {
+ public:
+  explicit ResizeLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "Resize"; }
+  virtual inline int MinBottomBlobs() const { return 1; }
+  virtual inline int MaxBottomBlobs() const { return 2; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// @brief Sets, for each of the size_out positions of an axis, the two
+  ///        input positions it interpolates and their weights.
+  void ComputeTaps(int size_in, int size_out, vector<int>* low,
+      vector<int>* high, vector<Dtype>* low_weight,
+      vector<Dtype>* high_weight);
+
+  bool nearest_;
+  int num_planes_;
+  int height_, width_, resized_height_, resized_width_;
+  vector<int> h_low_, h_high_, w_low_, w_high_;
+  vector<Dtype> h_low_weight_, h_high_weight_, w_low_weight_, w_high_weight_;
+  /// @brief Whether any output row interpolates each input row.
+  vector<bool> row_used_;
+  /// @brief The input rows of a plane resampled to the output width.
+  Blob<Dtype> rows_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_RESIZE_LAYER_HPP_
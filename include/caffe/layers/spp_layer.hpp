@@ -14,6 +14,12 @@ namespace caffe {
  *        by taking the max, average, etc. within regions
  *        so that the result vector of different sized
  *        images are of the same size.
+ *
+ * Level l of the pyramid pools the image into 2^l x 2^l bins, and the levels
+ * are written one after the other into the output, coarsest first. Where the
+ * bins of a level are unions of those of the next finer one, the level is
+ * computed from the finer results instead of from the input: max pooling
+ * takes the max of the four finer maxes, and average pooling sums their sums.
  */
 template <typename Dtype>
 class SPPLayer : public Layer<Dtype> {
@@ -34,41 +40,33 @@ class SPPLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
-  // calculates the kernel and stride dimensions for the pooling layer,
-  // returns a correctly configured LayerParameter for a PoolingLayer
-  virtual LayerParameter GetPoolingParam(const int pyramid_level,
-      const int bottom_h, const int bottom_w, const SPPParameter spp_param);
+  // calculates the bins of a pyramid level along an axis of the given size:
+  // their extent in the input, clipped to it, and their padded size, by
+  // which average pooling divides
+  void ComputeBins(const int pyramid_level, const int size,
+      vector<int>* start, vector<int>* end, vector<int>* padded_size);
+  // pools channel c of an image into a level, from the input or from the
+  // next finer level if nested_ says so, leaving sums for average pooling
+  void PoolLevel(const int pyramid_level, const int c,
+      const Dtype* bottom_data, Dtype* top_data, int* mask);
 
   int pyramid_height_;
   int bottom_h_, bottom_w_;
   int num_;
   int channels_;
-  int kernel_h_, kernel_w_;
-  int pad_h_, pad_w_;
-  bool reshaped_first_time_;
-
-  /// the internal Split layer that feeds the pooling layers
-  shared_ptr<SplitLayer<Dtype> > split_layer_;
-  /// top vector holder used in call to the underlying SplitLayer::Forward
-  vector<Blob<Dtype>*> split_top_vec_;
-  /// bottom vector holder used in call to the underlying PoolingLayer::Forward
-  vector<vector<Blob<Dtype>*>*> pooling_bottom_vecs_;
-  /// the internal Pooling layers of different kernel sizes
-  vector<shared_ptr<PoolingLayer<Dtype> > > pooling_layers_;
-  /// top vector holders used in call to the underlying PoolingLayer::Forward
-  vector<vector<Blob<Dtype>*>*> pooling_top_vecs_;
-  /// pooling_outputs stores the outputs of the PoolingLayers
-  vector<Blob<Dtype>*> pooling_outputs_;
-  /// the internal Flatten layers that the Pooling layers feed into
-  vector<FlattenLayer<Dtype>*> flatten_layers_;
-  /// top vector holders used in call to the underlying FlattenLayer::Forward
-  vector<vector<Blob<Dtype>*>*> flatten_top_vecs_;
-  /// flatten_outputs stores the outputs of the FlattenLayers
-  vector<Blob<Dtype>*> flatten_outputs_;
-  /// bottom vector holder used in call to the underlying ConcatLayer::Forward
-  vector<Blob<Dtype>*> concat_bottom_vec_;
-  /// the internal Concat layers that the Flatten layers feed into
-  shared_ptr<ConcatLayer<Dtype> > concat_layer_;
+  /// the number of bins of all levels of a plane
+  int pyramid_bins_;
+  /// the offset of each level in the bins of a plane
+  vector<int> level_offset_;
+  /// the bins of each level along height and width
+  vector<vector<int> > h_start_, h_end_, h_size_;
+  vector<vector<int> > w_start_, w_end_, w_size_;
+  /// whether the bins of a level are unions of those of the next level
+  vector<bool> nested_;
+  /// the input index of each max, or -1 for bins outside the input
+  Blob<int> max_idx_;
+  /// the per-pixel gradient of each bin in the average pooling backward
+  Blob<Dtype> bin_diff_;
 };
 
 }  // namespace caffe
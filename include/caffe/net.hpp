@@ -1,8 +1,9 @@
 #ifndef CAFFE_NET_HPP_
 #define CAFFE_NET_HPP_
 
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 #include <map>
-#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -217,7 +218,30 @@ class Net {
 
   void set_debug_info(const bool value) { debug_info_ = value; }
 
+  /// @brief Enables or disables the early exits of the net, which are
+  ///        enabled in the TEST phase.
+  void set_early_exit(const bool value) { early_exit_ = value; }
+  /**
+   * @brief For each item of the batch of the last Forward, the index of the
+   *        early exit it took, or -1 if it went through the whole net; empty
+   *        if Forward reached no exit.
+   */
+  inline const vector<int>& item_exits() const { return item_exits_; }
+
   // Helpers for Init.
+  /**
+   * @brief Prepare a net for Init once and for all: filter its layers for its
+   *        state, insert splits and set the phase of its layers. The result
+   *        is marked compiled, and Init builds it as it is.
+   */
+  static void Compile(const NetParameter& param,
+      NetParameter* param_compiled);
+  /**
+   * @brief Record the shapes of the tops of this net, in the order of its
+   *        layers, as those Init checks when it builds the compiled net
+   *        param, which this net is to be built from.
+   */
+  void RecordTopShapes(NetParameter* param_compiled) const;
   /**
    * @brief Remove layers that the user specified should be excluded given the current
    *        phase, level, and stage.
@@ -232,16 +256,28 @@ class Net {
   // Helpers for Init.
   /// @brief Append a new top blob to the net.
   void AppendTop(const NetParameter& param, const int layer_id,
-                 const int top_id, set<string>* available_blobs,
-                 map<string, int>* blob_name_to_idx);
+                 const int top_id,
+                 boost::unordered_set<string>* available_blobs,
+                 boost::unordered_map<string, int>* blob_name_to_idx);
   /// @brief Append a new bottom blob to the net.
   int AppendBottom(const NetParameter& param, const int layer_id,
-                   const int bottom_id, set<string>* available_blobs,
-                   map<string, int>* blob_name_to_idx);
+                   const int bottom_id,
+                   boost::unordered_set<string>* available_blobs,
+                   boost::unordered_map<string, int>* blob_name_to_idx);
   /// @brief Append a new parameter blob to the net.
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Helper for Init: finds the layers and blobs of the early exits.
+  void InitEarlyExits(const NetParameter& param);
+  /**
+   * @brief Helper for Forward: takes the confident items at an early exit
+   *        out of the batch. Returns whether any item is left.
+   */
+  bool EarlyExit(const int exit_id);
+  /// @brief Helper for Forward: gathers the outputs of all items of a batch
+  ///        that went through early exits.
+  void FinishEarlyExits(const int end);
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -256,12 +292,12 @@ class Net {
   /// @brief Individual layers in the net
   vector<shared_ptr<Layer<Dtype> > > layers_;
   vector<string> layer_names_;
-  map<string, int> layer_names_index_;
+  boost::unordered_map<string, int> layer_names_index_;
   vector<bool> layer_need_backward_;
   /// @brief the blobs storing intermediate results between the layer.
   vector<shared_ptr<Blob<Dtype> > > blobs_;
   vector<string> blob_names_;
-  map<string, int> blob_names_index_;
+  boost::unordered_map<string, int> blob_names_index_;
   vector<bool> blob_need_backward_;
   /// bottom_vecs stores the vectors containing the input for each layer.
   /// They don't actually host the blobs (blobs_ does), so we simply store
@@ -306,6 +342,30 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Whether Forward takes the early exits.
+  bool early_exit_;
+  /// For each early exit, in the order of the net: its parameters, the layer
+  /// after which it is checked, its blob, and the blobs computed up to that
+  /// layer that later layers read, from which it drops items.
+  vector<EarlyExitParameter> exit_params_;
+  vector<int> exit_layer_ids_;
+  vector<int> exit_blob_ids_;
+  vector<vector<int> > exit_live_blob_ids_;
+  /// The output the exits stand in for, and the last layer writing it.
+  int exit_output_id_;
+  int exit_output_layer_id_;
+  /// In Forward, the item of the batch at each position left in the blobs,
+  /// and the exit taken by each item.
+  vector<int> exit_items_;
+  vector<int> item_exits_;
+  /// The outputs of all items of the batch.
+  Blob<Dtype> exit_outputs_;
+  /// The tops of the layers without bottoms, e.g. the inputs, which need not
+  /// be set again before the next Forward: copies of them are taken before
+  /// items are dropped from them, and restored after Forward.
+  vector<int> exit_source_ids_;
+  vector<shared_ptr<Blob<Dtype> > > exit_source_copies_;
+  vector<bool> exit_source_saved_;
   /// The root net that actually holds the shared layers in data parallelism
   const Net* const root_net_;
   DISABLE_COPY_AND_ASSIGN(Net);
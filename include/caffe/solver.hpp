@@ -66,7 +66,7 @@ class Solver {
   // function that produces a SolverState protocol buffer that needs to be
   // written to disk together with the learned net.
   void Snapshot();
-  virtual ~Solver() {}
+  virtual ~Solver();
   inline const SolverParameter& param() const { return param_; }
   inline shared_ptr<Net<Dtype> > net() { return net_; }
   inline const vector<shared_ptr<Net<Dtype> > >& test_nets() {
@@ -98,6 +98,11 @@ class Solver {
   // Make and apply the update value for the current iteration.
   virtual void ApplyUpdate() = 0;
   string SnapshotFilename(const string extension);
+  // The file the profile of the iterations up to the current one goes to.
+  string ProfileFilename(const string& suffix);
+  // Writes out the events that no profile_interval exported yet, and stops
+  // profiling.
+  void ExportFinalProfile();
   string SnapshotToBinaryProto();
   string SnapshotToHDF5();
   // The test routine
@@ -129,6 +134,10 @@ class Solver {
   // True iff a request to stop early was received.
   bool requested_early_exit_;
 
+  // True iff this solver enabled the Profiler and has not disabled it yet:
+  // the events name the layers of its nets, which die with it.
+  bool profiling_;
+
   DISABLE_COPY_AND_ASSIGN(Solver);
 };
 
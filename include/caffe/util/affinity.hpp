@@ -0,0 +1,75 @@
+#ifndef CAFFE_UTIL_AFFINITY_H_
+#define CAFFE_UTIL_AFFINITY_H_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/// @brief Parses a list of CPU ids such as "0-3,8,10-11", sorted and unique.
+vector<int> ParseCpuList(const string& cpu_list);
+/// @brief Formats CPU ids as a list such as "0-3,8,10-11".
+string FormatCpuList(const vector<int>& cpus);
+
+/**
+ * @brief Returns the CPUs of each NUMA node, as reported by Linux in
+ *        /sys/devices/system/node. Without that information, all the online
+ *        CPUs form a single node.
+ */
+vector<vector<int> > NumaNodeCpus();
+
+/**
+ * @brief Restricts the calling thread to run on cpus. An empty list leaves
+ *        the thread's CPUs as they are. Returns false if the platform does
+ *        not support thread affinity or the CPUs are not available.
+ */
+bool SetCurrentThreadAffinity(const vector<int>& cpus);
+/// @brief The CPUs the calling thread may run on, or none if the platform
+///        does not support thread affinity.
+vector<int> GetCurrentThreadAffinity();
+
+/**
+ * @brief Process-wide placement of Caffe's threads on CPUs.
+ *
+ * Each role of thread gets its own set of CPUs, so that data loading does
+ * not compete with computation on dual-socket machines:
+ * - COMPUTE: the thread running the solver or the net. Pinning it before
+ *   the nets are created also places the blobs on its NUMA node: Linux
+ *   allocates a page on the node of the thread that first touches it, and
+ *   SyncedMemory zero-fills (touches) its host memory in the thread that
+ *   first accesses it.
+ * - PREFETCH: the prefetch threads of the data layers.
+ * - READER: the DataReader threads reading from the databases.
+ * - BLAS: the worker threads of the BLAS library, which it starts when it
+ *   is loaded rather than from the compute thread. They are pinned by
+ *   PinBlasThreads, which only OpenBLAS on Linux supports.
+ *
+ * The sets must be configured before the threads start: each thread pins
+ * itself once when it starts. An empty set leaves the role unrestricted: its
+ * threads run on all the CPUs the process was allowed when the first set was
+ * configured, rather than on those of the thread that started them.
+ */
+class ThreadAffinity {
+ public:
+  enum Role { COMPUTE = 0, PREFETCH, READER, BLAS, NUM_ROLES };
+
+  static void set_cpus(Role role, const vector<int>& cpus);
+  static vector<int> cpus(Role role);
+  /// @brief Pins the calling thread to the CPUs of role, or unpins it if
+  ///        role has none.
+  static void Apply(Role role);
+  /**
+   * @brief Runs the BLAS library on as many threads as the BLAS role has
+   *        CPUs, and pins its worker threads to them. The calling thread,
+   *        which takes a share of each BLAS call, keeps its own CPUs.
+   */
+  static void PinBlasThreads();
+  /// @brief Logs the NUMA topology and the CPUs and nodes of every role.
+  static void LogTopology();
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_AFFINITY_H_
@@ -3,6 +3,8 @@
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <vector>
+
 #include "caffe/util/device_alternate.hpp"
 
 namespace caffe {
@@ -47,6 +49,10 @@ class CPUTimer : public Timer {
   virtual float MicroSeconds();
 };
 
+/// @brief Returns the nearest-rank p-th percentile (0 < p <= 100) of values
+///        sorted in ascending order, or 0 if there are none.
+double Percentile(const std::vector<double>& sorted, double p);
+
 }  // namespace caffe
 
 #endif   // CAFFE_UTIL_BENCHMARK_H_
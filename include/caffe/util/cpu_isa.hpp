@@ -0,0 +1,87 @@
+#ifndef CAFFE_UTIL_CPU_ISA_H_
+#define CAFFE_UTIL_CPU_ISA_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief The hot CPU kernels compiled for one instruction set level.
+ *
+ * Each works on the elements [begin, end) of its arrays, so that large
+ * arrays can be split over threads. All levels give the same results to
+ * the bit: they run the same operations in the same order, without fused
+ * multiply-adds, only on wider vectors.
+ */
+struct CpuKernels {
+  typedef void (*FloatBinary)(const float* a, const float* b, float* y,
+      int begin, int end);
+  typedef void (*DoubleBinary)(const double* a, const double* b, double* y,
+      int begin, int end);
+  typedef void (*FloatUnary)(const float* a, float* y, int begin, int end);
+  typedef void (*DoubleUnary)(const double* a, double* y, int begin,
+      int end);
+  typedef void (*FloatPowx)(const float* a, float b, float* y, int begin,
+      int end);
+  typedef void (*DoublePowx)(const double* a, float b, double* y, int begin,
+      int end);
+
+  FloatBinary vsAdd, vsSub, vsMul, vsDiv;
+  DoubleBinary vdAdd, vdSub, vdMul, vdDiv;
+  FloatUnary vsSqr, vsAbs;
+  DoubleUnary vdSqr, vdAbs;
+  /// @brief Within 1 ulp of exp and log, as in Cephes expf and logf.
+  FloatUnary vsExp, vsLn;
+  /// @brief Only for the exponents that PowxVectorized accepts.
+  FloatPowx vsPowx;
+  DoublePowx vdPowx;
+  /// @brief y[i] = (x[i] - mean[i]) * scale, or mean_value for all i if
+  ///        mean is NULL: the conversion of pixels by DataTransformer.
+  void (*NormalizeBytes)(const uint8_t* x, const float* mean,
+      float mean_value, float scale, float* y, int begin, int end);
+
+  /// @brief Whether vsPowx and vdPowx compute pow(a, b): for exponents
+  ///        that sqrt and division give, those of the normalization layers.
+  static bool PowxVectorized(float b) {
+    return b == 1.f || b == 2.f || b == 0.5f || b == -0.5f || b == -1.f ||
+        b == 0.75f || b == -0.75f;
+  }
+};
+
+/**
+ * @brief Selects the kernels for the instruction sets of the running CPU.
+ *
+ * Caffe is built for a generic target, SSE2 on x86-64; the kernels of
+ * CpuKernels are also compiled for AVX2 and AVX-512 and the best level the
+ * CPU supports is used, unless a lower one is forced with set_level, e.g. to
+ * test or compare them.
+ */
+class CpuIsa {
+ public:
+  enum Level { GENERIC = 0, AVX2, AVX512, NUM_LEVELS };
+
+  /// @brief The best level both the CPU and the build support.
+  static Level Detected();
+  /// @brief Whether the kernels of level can run here.
+  static bool Supported(Level level) { return level <= Detected(); }
+  /// @brief The level whose kernels run: Detected() unless set.
+  static Level level();
+  /// @brief Forces the level of the kernels; it has to be supported.
+  static void set_level(Level level);
+  /// @brief The kernels of the current level.
+  static const CpuKernels& kernels() { return kernels(level()); }
+  static const CpuKernels& kernels(Level level);
+
+  /// @brief "generic", "avx2" or "avx512".
+  static string Name(Level level);
+  /// @brief The level named name, or Detected() for "auto".
+  static Level FromName(const string& name);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CPU_ISA_H_
@@ -0,0 +1,40 @@
+#ifndef CAFFE_UTIL_DATA_BENCHMARK_H_
+#define CAFFE_UTIL_DATA_BENCHMARK_H_
+
+#include <map>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/// @brief What BenchmarkDataLayer measured over the timed batches.
+struct DataBenchmarkResult {
+  int batches;
+  int images;
+  double seconds;
+  // The time spent in the layers' forward passes, summed over instances.
+  double forward_us;
+  // The profiled time and number of events per category, e.g. load_batch,
+  // data_read, data_transform and data_wait.
+  std::map<string, double> category_us;
+  std::map<string, int> category_count;
+};
+
+/**
+ * @brief Runs num_instances independent instances of the data layer
+ *        described by param concurrently, each with its own consumer thread,
+ *        and times how fast they produce iterations batches each after
+ *        warmup untimed ones.
+ *
+ * Each instance reads its source on its own: instances of layers sharing a
+ * DataReader, such as Data, are given distinct reader keys. The per-category
+ * breakdown is only filled in while the Profiler is enabled.
+ */
+DataBenchmarkResult BenchmarkDataLayer(const LayerParameter& param,
+    int num_instances, int warmup, int iterations);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DATA_BENCHMARK_H_
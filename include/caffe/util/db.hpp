@@ -18,6 +18,17 @@ class Cursor {
   virtual void Next() = 0;
   virtual string key() = 0;
   virtual string value() = 0;
+  /**
+   * @brief Parses the current value into message. The backends parse it in
+   *        place, saving the allocation and copy of value().
+   */
+  virtual bool ParseValue(google::protobuf::Message* message) {
+    return message->ParseFromString(value());
+  }
+  /// @brief Copies the current value into value, reusing its buffer.
+  virtual void ReadValue(string* value) {
+    *value = this->value();
+  }
   virtual bool valid() = 0;
 
   DISABLE_COPY_AND_ASSIGN(Cursor);
@@ -20,6 +20,14 @@ class LevelDBCursor : public Cursor {
   virtual void Next() { iter_->Next(); }
   virtual string key() { return iter_->key().ToString(); }
   virtual string value() { return iter_->value().ToString(); }
+  virtual bool ParseValue(google::protobuf::Message* message) {
+    const leveldb::Slice value = iter_->value();
+    return message->ParseFromArray(value.data(), value.size());
+  }
+  virtual void ReadValue(string* value) {
+    const leveldb::Slice slice = iter_->value();
+    value->assign(slice.data(), slice.size());
+  }
   virtual bool valid() { return iter_->Valid(); }
 
  private:
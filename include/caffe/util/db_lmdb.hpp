@@ -34,6 +34,13 @@ class LMDBCursor : public Cursor {
     return string(static_cast<const char*>(mdb_value_.mv_data),
         mdb_value_.mv_size);
   }
+  virtual bool ParseValue(google::protobuf::Message* message) {
+    return message->ParseFromArray(mdb_value_.mv_data, mdb_value_.mv_size);
+  }
+  virtual void ReadValue(string* value) {
+    value->assign(static_cast<const char*>(mdb_value_.mv_data),
+        mdb_value_.mv_size);
+  }
   virtual bool valid() { return valid_; }
 
  private:
@@ -94,6 +94,18 @@ void caffe_log(const int n, const Dtype* a, Dtype* y);
 template <typename Dtype>
 void caffe_abs(const int n, const Dtype* a, Dtype* y);
 
+// The number of threads, the calling one included, that the element-wise
+// functions above split large arrays over when Caffe is built without MKL,
+// which threads its own. Defaults to 1.
+void caffe_set_cpu_math_threads(const int threads);
+int caffe_cpu_math_threads();
+
+// y[i] = (x[i] - mean[i]) * scale, or with mean_value for all i if mean is
+// NULL: the conversion of 8-bit pixels, vectorized for floats.
+template <typename Dtype>
+void caffe_cpu_normalize_bytes(const int n, const uint8_t* x,
+    const Dtype* mean, const Dtype mean_value, const Dtype scale, Dtype* y);
+
 template <typename Dtype>
 Dtype caffe_cpu_dot(const int n, const Dtype* x, const Dtype* y);
 
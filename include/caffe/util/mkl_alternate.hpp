@@ -17,70 +17,39 @@ extern "C" {
 
 #include <math.h>
 
-// Functions that caffe uses but are not present if MKL is not linked.
+// Functions that caffe uses but are not present if MKL is not linked. They
+// are implemented in util/mkl_alternate.cpp with the kernels of the
+// instruction set CpuIsa selects, and split over the threads set by
+// caffe_set_cpu_math_threads for large arrays.
 
-// A simple way to define the vsl unary functions. The operation should
-// be in the form e.g. y[i] = sqrt(a[i])
-#define DEFINE_VSL_UNARY_FUNC(name, operation) \
-  template<typename Dtype> \
-  void v##name(const int n, const Dtype* a, Dtype* y) { \
-    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
-    for (int i = 0; i < n; ++i) { operation; } \
-  } \
-  inline void vs##name( \
-    const int n, const float* a, float* y) { \
-    v##name<float>(n, a, y); \
-  } \
-  inline void vd##name( \
-      const int n, const double* a, double* y) { \
-    v##name<double>(n, a, y); \
-  }
+// The vsl unary functions, e.g. y[i] = sqrt(a[i]).
+#define DECLARE_VSL_UNARY_FUNC(name) \
+  void vs##name(const int n, const float* a, float* y); \
+  void vd##name(const int n, const double* a, double* y)
 
-DEFINE_VSL_UNARY_FUNC(Sqr, y[i] = a[i] * a[i]);
-DEFINE_VSL_UNARY_FUNC(Exp, y[i] = exp(a[i]));
-DEFINE_VSL_UNARY_FUNC(Ln, y[i] = log(a[i]));
-DEFINE_VSL_UNARY_FUNC(Abs, y[i] = fabs(a[i]));
+DECLARE_VSL_UNARY_FUNC(Sqr);
+// Within 1 ulp of exp(a[i]) for floats, except where it is denormal.
+DECLARE_VSL_UNARY_FUNC(Exp);
+// Within 1 ulp of log(a[i]) for floats, denormals included.
+DECLARE_VSL_UNARY_FUNC(Ln);
+DECLARE_VSL_UNARY_FUNC(Abs);
 
-// A simple way to define the vsl unary functions with singular parameter b.
-// The operation should be in the form e.g. y[i] = pow(a[i], b)
-#define DEFINE_VSL_UNARY_FUNC_WITH_PARAM(name, operation) \
-  template<typename Dtype> \
-  void v##name(const int n, const Dtype* a, const Dtype b, Dtype* y) { \
-    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
-    for (int i = 0; i < n; ++i) { operation; } \
-  } \
-  inline void vs##name( \
-    const int n, const float* a, const float b, float* y) { \
-    v##name<float>(n, a, b, y); \
-  } \
-  inline void vd##name( \
-      const int n, const double* a, const float b, double* y) { \
-    v##name<double>(n, a, b, y); \
-  }
+// The vsl unary functions with singular parameter b, e.g. y[i] = pow(a[i], b).
+#define DECLARE_VSL_UNARY_FUNC_WITH_PARAM(name) \
+  void vs##name(const int n, const float* a, const float b, float* y); \
+  void vd##name(const int n, const double* a, const float b, double* y)
 
-DEFINE_VSL_UNARY_FUNC_WITH_PARAM(Powx, y[i] = pow(a[i], b));
+DECLARE_VSL_UNARY_FUNC_WITH_PARAM(Powx);
 
-// A simple way to define the vsl binary functions. The operation should
-// be in the form e.g. y[i] = a[i] + b[i]
-#define DEFINE_VSL_BINARY_FUNC(name, operation) \
-  template<typename Dtype> \
-  void v##name(const int n, const Dtype* a, const Dtype* b, Dtype* y) { \
-    CHECK_GT(n, 0); CHECK(a); CHECK(b); CHECK(y); \
-    for (int i = 0; i < n; ++i) { operation; } \
-  } \
-  inline void vs##name( \
-    const int n, const float* a, const float* b, float* y) { \
-    v##name<float>(n, a, b, y); \
-  } \
-  inline void vd##name( \
-      const int n, const double* a, const double* b, double* y) { \
-    v##name<double>(n, a, b, y); \
-  }
+// The vsl binary functions, e.g. y[i] = a[i] + b[i].
+#define DECLARE_VSL_BINARY_FUNC(name) \
+  void vs##name(const int n, const float* a, const float* b, float* y); \
+  void vd##name(const int n, const double* a, const double* b, double* y)
 
-DEFINE_VSL_BINARY_FUNC(Add, y[i] = a[i] + b[i]);
-DEFINE_VSL_BINARY_FUNC(Sub, y[i] = a[i] - b[i]);
-DEFINE_VSL_BINARY_FUNC(Mul, y[i] = a[i] * b[i]);
-DEFINE_VSL_BINARY_FUNC(Div, y[i] = a[i] / b[i]);
+DECLARE_VSL_BINARY_FUNC(Add);
+DECLARE_VSL_BINARY_FUNC(Sub);
+DECLARE_VSL_BINARY_FUNC(Mul);
+DECLARE_VSL_BINARY_FUNC(Div);
 
 // In addition, MKL comes with an additional function axpby that is not present
 // in standard blas. We will simply use a two-step (inefficient, of course) way
@@ -0,0 +1,122 @@
+#ifndef CAFFE_UTIL_PROFILER_H_
+#define CAFFE_UTIL_PROFILER_H_
+
+#include <boost/atomic.hpp>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A completed span of work, e.g. one layer's forward pass.
+ *
+ * name and category are not copied: they must be string literals or strings
+ * that outlive the next export, such as the layer names owned by a Net.
+ */
+struct ProfileEvent {
+  const char* name;
+  const char* category;
+  int64_t start_us;
+  int64_t duration_us;
+  int iter;
+  int thread_id;
+};
+
+/**
+ * @brief Process-wide, opt-in recorder of timed spans, used to see where
+ *        the time goes in a real training run.
+ *
+ * Events are written into a fixed-capacity ring buffer. A writer claims a
+ * slot with a single atomic increment, so recording never takes a lock and
+ * can happen from any thread; when the profiler is disabled, recording costs
+ * a single branch. If more events are recorded between two exports than the
+ * buffer holds, the oldest ones are overwritten and counted as dropped.
+ *
+ * Times are host wall-clock times: in GPU mode they measure kernel launches
+ * rather than kernel execution unless the work synchronizes.
+ *
+ * Enable and Disable reallocate the buffer and must not race with recording.
+ */
+class Profiler {
+ public:
+  static Profiler& Get();
+  ~Profiler();
+
+  /// @brief Starts recording into a ring buffer of capacity events.
+  void Enable(int capacity);
+  /// @brief Stops recording and drops any event not yet exported.
+  void Disable();
+  inline bool enabled() const {
+    return enabled_.load(boost::memory_order_acquire);
+  }
+
+  /// @brief Sets the solver iteration attached to subsequent events.
+  inline void set_iter(int iter) {
+    iter_.store(iter, boost::memory_order_relaxed);
+  }
+  /// @brief Microseconds since the profiler was enabled.
+  int64_t NowMicros() const;
+  void Record(const char* name, const char* category, int64_t start_us,
+      int64_t duration_us);
+
+  /// @brief Moves the events recorded since the last drain or export into
+  ///        events, oldest first.
+  void Drain(vector<ProfileEvent>* events);
+  /**
+   * @brief Writes the events recorded since the last drain or export to
+   *        filename in the Chrome trace-event JSON format, and returns the
+   *        number of events written.
+   */
+  int ExportChromeTrace(const string& filename);
+  /// @brief The number of events overwritten before they could be exported.
+  uint64_t dropped() const { return dropped_; }
+
+ private:
+  Profiler();
+
+  class Ring;
+
+  // Read by every recording thread while the solver thread updates them.
+  boost::atomic<bool> enabled_;
+  boost::atomic<int> iter_;
+  uint64_t dropped_;
+  shared_ptr<Ring> ring_;
+
+  DISABLE_COPY_AND_ASSIGN(Profiler);
+};
+
+/**
+ * @brief Records the lifetime of the scope as one event, if the Profiler is
+ *        enabled when the scope is entered.
+ */
+class ProfileScope {
+ public:
+  ProfileScope(const char* name, const char* category)
+      : name_(name), category_(category),
+        start_us_(Profiler::Get().enabled() ?
+                  Profiler::Get().NowMicros() : -1) {}
+  /// @brief The scope's start time, or -1 if the Profiler is disabled.
+  inline int64_t start_us() const { return start_us_; }
+
+  ~ProfileScope() {
+    if (start_us_ >= 0) {
+      Profiler& profiler = Profiler::Get();
+      profiler.Record(name_, category_, start_us_,
+          profiler.NowMicros() - start_us_);
+    }
+  }
+
+ private:
+  const char* name_;
+  const char* category_;
+  const int64_t start_us_;
+
+  DISABLE_COPY_AND_ASSIGN(ProfileScope);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PROFILER_H_
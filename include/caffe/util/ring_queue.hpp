@@ -0,0 +1,68 @@
+#ifndef CAFFE_UTIL_RING_QUEUE_HPP_
+#define CAFFE_UTIL_RING_QUEUE_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A bounded lock-free queue, for the hand-offs between threads on the
+ *        data path, with the interface of BlockingQueue.
+ *
+ * Items live in a fixed ring of capacity slots. In SPSC mode, one producer
+ * and one consumer exchange items through two indices, with no atomic
+ * read-modify-write at all; in MPMC mode, any number of threads claim slots
+ * with a compare-and-swap. The blocking calls first spin on the ring, and
+ * only park on a condition variable, where they can be interrupted, if the
+ * wait outlasts the spin. Producers only touch the condition variable when
+ * somebody is parked.
+ *
+ * The time callers spend blocked is counted, for profiling the pipeline.
+ * peek() and try_peek() need a single consumer, in both modes.
+ */
+template<typename T>
+class RingQueue {
+ public:
+  enum Mode { SPSC, MPMC };
+
+  RingQueue(int capacity, Mode mode);
+
+  // Blocks while the queue is full.
+  void push(const T& t);
+
+  bool try_push(const T& t);
+
+  bool try_pop(T* t);
+
+  // This logs a message if the threads needs to be blocked
+  // useful for detecting e.g. when data feeding is too slow
+  T pop(const string& log_on_wait = "");
+
+  bool try_peek(T* t);
+
+  // Return element without removing it
+  T peek();
+
+  size_t size() const;
+  int capacity() const;
+
+  // The number of push/pop/peek calls that found the queue full or empty,
+  // and the total microseconds they waited.
+  uint64_t waits() const;
+  uint64_t wait_us() const;
+
+ protected:
+  // The ring and its atomics, kept out of this header for NVCC, like the
+  // synchronization fields of BlockingQueue.
+  class Ring;
+
+  shared_ptr<Ring> ring_;
+
+DISABLE_COPY_AND_ASSIGN(RingQueue);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_RING_QUEUE_HPP_
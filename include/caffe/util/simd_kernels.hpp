@@ -0,0 +1,512 @@
+// The kernels of CpuKernels, written once for vectors of any width.
+//
+// Not a regular header: util/cpu_isa.cpp includes it once per instruction
+// set level, inside a namespace of its own and with the compiler targeting
+// that level, after defining one of CAFFE_SIMD_AVX512, CAFFE_SIMD_AVX2 or
+// CAFFE_SIMD_SSE2; with none, the vectors are single scalars. The
+// intrinsics headers and <algorithm> and <cstring> are included by then.
+// The guard only keeps it from being included twice for one level; the file
+// undefines it for the next.
+#ifndef CAFFE_UTIL_SIMD_KERNELS_H_
+#define CAFFE_UTIL_SIMD_KERNELS_H_
+
+// SimdFloat and SimdDouble wrap the vectors of the level: loads, stores and
+// the arithmetic the kernels use. Masks are the results of comparisons,
+// for Select.
+#if defined(CAFFE_SIMD_AVX512)
+
+struct SimdFloat {
+  typedef __m512 Vec;
+  typedef __m512i Int;
+  typedef __mmask16 Mask;
+  static const int kWidth = 16;
+  static Vec Load(const float* p) { return _mm512_loadu_ps(p); }
+  static void Store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+  static Vec LoadBytes(const uint8_t* p) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+  }
+  static Vec Set(float x) { return _mm512_set1_ps(x); }
+  static Vec Add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+  static Vec Sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+  static Vec Mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+  static Vec Div(Vec a, Vec b) { return _mm512_div_ps(a, b); }
+  static Vec Min(Vec a, Vec b) { return _mm512_min_ps(a, b); }
+  static Vec Max(Vec a, Vec b) { return _mm512_max_ps(a, b); }
+  static Vec Sqrt(Vec a) { return _mm512_sqrt_ps(a); }
+  static Vec AndBits(Vec a, int32_t bits) {
+    return _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(a),
+        _mm512_set1_epi32(bits)));
+  }
+  static Vec OrBits(Vec a, int32_t bits) {
+    return _mm512_castsi512_ps(_mm512_or_epi32(_mm512_castps_si512(a),
+        _mm512_set1_epi32(bits)));
+  }
+  static Mask Lt(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+  static Mask Gt(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+  static Mask Eq(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+  static Mask NotGe(Vec a, Vec b) {
+    return _mm512_cmp_ps_mask(a, b, _CMP_NGE_UQ);
+  }
+  static Mask IsNan(Vec a) { return _mm512_cmp_ps_mask(a, a, _CMP_UNORD_Q); }
+  static Vec Select(Mask m, Vec a, Vec b) {
+    return _mm512_mask_blend_ps(m, b, a);
+  }
+  static Int Truncate(Vec a) { return _mm512_cvttps_epi32(a); }
+  static Vec ToFloat(Int a) { return _mm512_cvtepi32_ps(a); }
+  static Int Half(Int a) { return _mm512_srai_epi32(a, 1); }
+  static Int Sub(Int a, Int b) { return _mm512_sub_epi32(a, b); }
+  // 2^n for n in [-126, 127].
+  static Vec Pow2(Int n) {
+    return _mm512_castsi512_ps(_mm512_slli_epi32(
+        _mm512_add_epi32(n, _mm512_set1_epi32(127)), 23));
+  }
+  // The biased exponent of a positive a.
+  static Int Exponent(Vec a) {
+    return _mm512_srli_epi32(_mm512_castps_si512(a), 23);
+  }
+};
+
+struct SimdDouble {
+  typedef __m512d Vec;
+  static const int kWidth = 8;
+  static Vec Load(const double* p) { return _mm512_loadu_pd(p); }
+  static void Store(double* p, Vec v) { _mm512_storeu_pd(p, v); }
+  static Vec Set(double x) { return _mm512_set1_pd(x); }
+  static Vec Add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+  static Vec Sub(Vec a, Vec b) { return _mm512_sub_pd(a, b); }
+  static Vec Mul(Vec a, Vec b) { return _mm512_mul_pd(a, b); }
+  static Vec Div(Vec a, Vec b) { return _mm512_div_pd(a, b); }
+  static Vec Sqrt(Vec a) { return _mm512_sqrt_pd(a); }
+  static Vec Abs(Vec a) {
+    return _mm512_castsi512_pd(_mm512_and_epi64(_mm512_castpd_si512(a),
+        _mm512_set1_epi64(0x7fffffffffffffffLL)));
+  }
+};
+
+#elif defined(CAFFE_SIMD_AVX2)
+
+struct SimdFloat {
+  typedef __m256 Vec;
+  typedef __m256i Int;
+  typedef __m256 Mask;
+  static const int kWidth = 8;
+  static Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+  static void Store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+  static Vec LoadBytes(const uint8_t* p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+  }
+  static Vec Set(float x) { return _mm256_set1_ps(x); }
+  static Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+  static Vec Sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+  static Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+  static Vec Div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+  static Vec Min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+  static Vec Max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+  static Vec Sqrt(Vec a) { return _mm256_sqrt_ps(a); }
+  static Vec AndBits(Vec a, int32_t bits) {
+    return _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(bits)));
+  }
+  static Vec OrBits(Vec a, int32_t bits) {
+    return _mm256_or_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(bits)));
+  }
+  static Mask Lt(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static Mask Gt(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+  static Mask Eq(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+  static Mask NotGe(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_NGE_UQ); }
+  static Mask IsNan(Vec a) { return _mm256_cmp_ps(a, a, _CMP_UNORD_Q); }
+  static Vec Select(Mask m, Vec a, Vec b) { return _mm256_blendv_ps(b, a, m); }
+  static Int Truncate(Vec a) { return _mm256_cvttps_epi32(a); }
+  static Vec ToFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+  static Int Half(Int a) { return _mm256_srai_epi32(a, 1); }
+  static Int Sub(Int a, Int b) { return _mm256_sub_epi32(a, b); }
+  static Vec Pow2(Int n) {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_add_epi32(n, _mm256_set1_epi32(127)), 23));
+  }
+  static Int Exponent(Vec a) {
+    return _mm256_srli_epi32(_mm256_castps_si256(a), 23);
+  }
+};
+
+struct SimdDouble {
+  typedef __m256d Vec;
+  static const int kWidth = 4;
+  static Vec Load(const double* p) { return _mm256_loadu_pd(p); }
+  static void Store(double* p, Vec v) { _mm256_storeu_pd(p, v); }
+  static Vec Set(double x) { return _mm256_set1_pd(x); }
+  static Vec Add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+  static Vec Sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+  static Vec Mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+  static Vec Div(Vec a, Vec b) { return _mm256_div_pd(a, b); }
+  static Vec Sqrt(Vec a) { return _mm256_sqrt_pd(a); }
+  static Vec Abs(Vec a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.), a); }
+};
+
+#elif defined(CAFFE_SIMD_SSE2)
+
+struct SimdFloat {
+  typedef __m128 Vec;
+  typedef __m128i Int;
+  typedef __m128 Mask;
+  static const int kWidth = 4;
+  static Vec Load(const float* p) { return _mm_loadu_ps(p); }
+  static void Store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+  static Vec LoadBytes(const uint8_t* p) {
+    int32_t bytes;
+    memcpy(&bytes, p, sizeof(bytes));  // NOLINT(caffe/alt_fn)
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(
+        _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero));
+  }
+  static Vec Set(float x) { return _mm_set1_ps(x); }
+  static Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+  static Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+  static Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+  static Vec Div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+  static Vec Min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+  static Vec Max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+  static Vec Sqrt(Vec a) { return _mm_sqrt_ps(a); }
+  static Vec AndBits(Vec a, int32_t bits) {
+    return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(bits)));
+  }
+  static Vec OrBits(Vec a, int32_t bits) {
+    return _mm_or_ps(a, _mm_castsi128_ps(_mm_set1_epi32(bits)));
+  }
+  static Mask Lt(Vec a, Vec b) { return _mm_cmplt_ps(a, b); }
+  static Mask Gt(Vec a, Vec b) { return _mm_cmpgt_ps(a, b); }
+  static Mask Eq(Vec a, Vec b) { return _mm_cmpeq_ps(a, b); }
+  static Mask NotGe(Vec a, Vec b) { return _mm_cmpnge_ps(a, b); }
+  static Mask IsNan(Vec a) { return _mm_cmpunord_ps(a, a); }
+  static Vec Select(Mask m, Vec a, Vec b) {
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+  }
+  static Int Truncate(Vec a) { return _mm_cvttps_epi32(a); }
+  static Vec ToFloat(Int a) { return _mm_cvtepi32_ps(a); }
+  static Int Half(Int a) { return _mm_srai_epi32(a, 1); }
+  static Int Sub(Int a, Int b) { return _mm_sub_epi32(a, b); }
+  static Vec Pow2(Int n) {
+    return _mm_castsi128_ps(_mm_slli_epi32(
+        _mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+  }
+  static Int Exponent(Vec a) {
+    return _mm_srli_epi32(_mm_castps_si128(a), 23);
+  }
+};
+
+struct SimdDouble {
+  typedef __m128d Vec;
+  static const int kWidth = 2;
+  static Vec Load(const double* p) { return _mm_loadu_pd(p); }
+  static void Store(double* p, Vec v) { _mm_storeu_pd(p, v); }
+  static Vec Set(double x) { return _mm_set1_pd(x); }
+  static Vec Add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+  static Vec Sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+  static Vec Mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+  static Vec Div(Vec a, Vec b) { return _mm_div_pd(a, b); }
+  static Vec Sqrt(Vec a) { return _mm_sqrt_pd(a); }
+  static Vec Abs(Vec a) { return _mm_andnot_pd(_mm_set1_pd(-0.), a); }
+};
+
+#else  // Scalars, with the semantics of the SSE2 instructions.
+
+struct SimdFloat {
+  typedef float Vec;
+  typedef int32_t Int;
+  typedef bool Mask;
+  static const int kWidth = 1;
+  static Vec Load(const float* p) { return *p; }
+  static void Store(float* p, Vec v) { *p = v; }
+  static Vec LoadBytes(const uint8_t* p) { return *p; }
+  static Vec Set(float x) { return x; }
+  static Vec Add(Vec a, Vec b) { return a + b; }
+  static Vec Sub(Vec a, Vec b) { return a - b; }
+  static Vec Mul(Vec a, Vec b) { return a * b; }
+  static Vec Div(Vec a, Vec b) { return a / b; }
+  static Vec Min(Vec a, Vec b) { return a < b ? a : b; }
+  static Vec Max(Vec a, Vec b) { return a > b ? a : b; }
+  static Vec Sqrt(Vec a) { return std::sqrt(a); }
+  static Vec AndBits(Vec a, int32_t bits) {
+    int32_t a_bits;
+    memcpy(&a_bits, &a, sizeof(a));  // NOLINT(caffe/alt_fn)
+    a_bits &= bits;
+    memcpy(&a, &a_bits, sizeof(a));  // NOLINT(caffe/alt_fn)
+    return a;
+  }
+  static Vec OrBits(Vec a, int32_t bits) {
+    int32_t a_bits;
+    memcpy(&a_bits, &a, sizeof(a));  // NOLINT(caffe/alt_fn)
+    a_bits |= bits;
+    memcpy(&a, &a_bits, sizeof(a));  // NOLINT(caffe/alt_fn)
+    return a;
+  }
+  static Mask Lt(Vec a, Vec b) { return a < b; }
+  static Mask Gt(Vec a, Vec b) { return a > b; }
+  static Mask Eq(Vec a, Vec b) { return a == b; }
+  static Mask NotGe(Vec a, Vec b) { return !(a >= b); }
+  static Mask IsNan(Vec a) { return a != a; }
+  static Vec Select(Mask m, Vec a, Vec b) { return m ? a : b; }
+  static Int Truncate(Vec a) { return static_cast<Int>(a); }
+  static Vec ToFloat(Int a) { return static_cast<Vec>(a); }
+  static Int Half(Int a) { return a >> 1; }
+  static Int Sub(Int a, Int b) { return a - b; }
+  static Vec Pow2(Int n) {
+    const int32_t bits = (n + 127) << 23;
+    Vec a;
+    memcpy(&a, &bits, sizeof(a));  // NOLINT(caffe/alt_fn)
+    return a;
+  }
+  static Int Exponent(Vec a) {
+    uint32_t bits;
+    memcpy(&bits, &a, sizeof(a));  // NOLINT(caffe/alt_fn)
+    return bits >> 23;
+  }
+};
+
+struct SimdDouble {
+  typedef double Vec;
+  static const int kWidth = 1;
+  static Vec Load(const double* p) { return *p; }
+  static void Store(double* p, Vec v) { *p = v; }
+  static Vec Set(double x) { return x; }
+  static Vec Add(Vec a, Vec b) { return a + b; }
+  static Vec Sub(Vec a, Vec b) { return a - b; }
+  static Vec Mul(Vec a, Vec b) { return a * b; }
+  static Vec Div(Vec a, Vec b) { return a / b; }
+  static Vec Sqrt(Vec a) { return std::sqrt(a); }
+  static Vec Abs(Vec a) { return std::fabs(a); }
+};
+
+#endif
+
+// exp(x) as in Cephes expf: x = n log(2) + r, |r| <= log(2) / 2, and exp(r)
+// by a polynomial. 2^n is applied in two halves so that results overflow to
+// inf and underflow gradually to 0 as exp does.
+inline SimdFloat::Vec Exp(SimdFloat::Vec x) {
+  typedef SimdFloat S;
+  const S::Vec one = S::Set(1.f);
+  S::Vec r = S::Min(S::Max(x, S::Set(-104.f)), S::Set(88.8f));
+  // n = floor(r / log(2) + 1/2)
+  S::Vec fn = S::Add(S::Mul(r, S::Set(1.44269504088896341f)), S::Set(0.5f));
+  const S::Vec tn = S::ToFloat(S::Truncate(fn));
+  fn = S::Sub(tn, S::Select(S::Gt(tn, fn), one, S::Set(0.f)));
+  r = S::Sub(r, S::Mul(fn, S::Set(0.693359375f)));
+  r = S::Sub(r, S::Mul(fn, S::Set(-2.12194440e-4f)));
+  S::Vec y = S::Set(1.9875691500e-4f);
+  y = S::Add(S::Mul(y, r), S::Set(1.3981999507e-3f));
+  y = S::Add(S::Mul(y, r), S::Set(8.3334519073e-3f));
+  y = S::Add(S::Mul(y, r), S::Set(4.1665795894e-2f));
+  y = S::Add(S::Mul(y, r), S::Set(1.6666665459e-1f));
+  y = S::Add(S::Mul(y, r), S::Set(5.0000001201e-1f));
+  y = S::Add(S::Add(S::Mul(y, S::Mul(r, r)), r), one);
+  const S::Int n = S::Truncate(fn);
+  const S::Int half = S::Half(n);
+  y = S::Mul(S::Mul(y, S::Pow2(half)), S::Pow2(S::Sub(n, half)));
+  return S::Select(S::IsNan(x), x, y);
+}
+
+// log(x) as in Cephes logf: x = m 2^e with sqrt(1/2) <= m < sqrt(2), and
+// log(m) by a polynomial in m - 1. Denormals are scaled up by 2^23 first.
+inline SimdFloat::Vec Log(SimdFloat::Vec x) {
+  typedef SimdFloat S;
+  const S::Vec zero = S::Set(0.f);
+  const S::Vec one = S::Set(1.f);
+  const S::Mask denormal = S::Lt(x, S::Set(1.17549435e-38f));
+  S::Vec m = S::Select(denormal, S::Mul(x, S::Set(8388608.f)), x);
+  S::Vec e = S::Sub(S::ToFloat(S::Exponent(m)),
+                    S::Select(denormal, S::Set(126.f + 23.f), S::Set(126.f)));
+  // m in [0.5, 1)
+  m = S::OrBits(S::AndBits(m, 0x007fffff), 0x3f000000);
+  const S::Mask small = S::Lt(m, S::Set(0.707106781186547524f));
+  e = S::Sub(e, S::Select(small, one, zero));
+  m = S::Add(S::Sub(m, one), S::Select(small, m, zero));
+  const S::Vec z = S::Mul(m, m);
+  S::Vec y = S::Set(7.0376836292e-2f);
+  y = S::Add(S::Mul(y, m), S::Set(-1.1514610310e-1f));
+  y = S::Add(S::Mul(y, m), S::Set(1.1676998740e-1f));
+  y = S::Add(S::Mul(y, m), S::Set(-1.2420140846e-1f));
+  y = S::Add(S::Mul(y, m), S::Set(1.4249322787e-1f));
+  y = S::Add(S::Mul(y, m), S::Set(-1.6668057665e-1f));
+  y = S::Add(S::Mul(y, m), S::Set(2.0000714765e-1f));
+  y = S::Add(S::Mul(y, m), S::Set(-2.4999993993e-1f));
+  y = S::Add(S::Mul(y, m), S::Set(3.3333331174e-1f));
+  y = S::Mul(S::Mul(y, m), z);
+  y = S::Add(y, S::Mul(e, S::Set(-2.12194440e-4f)));
+  y = S::Sub(y, S::Mul(z, S::Set(0.5f)));
+  y = S::Add(S::Add(m, y), S::Mul(e, S::Set(0.693359375f)));
+  // log(0) = -inf, log(inf) = inf, and NaN below 0 and for NaN.
+  const S::Vec inf = S::Set(std::numeric_limits<float>::infinity());
+  y = S::Select(S::Eq(x, zero), S::Sub(zero, inf), y);
+  y = S::Select(S::Eq(x, inf), inf, y);
+  return S::Select(S::NotGe(x, zero),
+                   S::Set(std::numeric_limits<float>::quiet_NaN()), y);
+}
+
+// Applies op to the vectors of [begin, end), and to the remaining elements
+// in a padded vector, so that every element goes through the same code
+// whatever the chunks.
+template <typename S, typename Dtype, typename Op>
+inline void UnaryKernel(const Dtype* a, Dtype* y, const Op& op, int begin,
+    int end) {
+  int i = begin;
+  for (; i + S::kWidth <= end; i += S::kWidth) {
+    S::Store(y + i, op(S::Load(a + i)));
+  }
+  if (i < end) {
+    Dtype in[S::kWidth] = {0}, out[S::kWidth];
+    std::copy(a + i, a + end, in);
+    S::Store(out, op(S::Load(in)));
+    std::copy(out, out + (end - i), y + i);
+  }
+}
+
+template <typename S, typename Dtype, typename Op>
+inline void BinaryKernel(const Dtype* a, const Dtype* b, Dtype* y,
+    const Op& op, int begin, int end) {
+  int i = begin;
+  for (; i + S::kWidth <= end; i += S::kWidth) {
+    S::Store(y + i, op(S::Load(a + i), S::Load(b + i)));
+  }
+  if (i < end) {
+    Dtype in_a[S::kWidth] = {0}, in_b[S::kWidth] = {0}, out[S::kWidth];
+    std::copy(a + i, a + end, in_a);
+    std::copy(b + i, b + end, in_b);
+    S::Store(out, op(S::Load(in_a), S::Load(in_b)));
+    std::copy(out, out + (end - i), y + i);
+  }
+}
+
+#define SIMD_BINARY_OP(name) \
+  template <typename S> struct name##Op { \
+    typename S::Vec operator()(typename S::Vec a, typename S::Vec b) const { \
+      return S::name(a, b); \
+    } \
+  };
+SIMD_BINARY_OP(Add)
+SIMD_BINARY_OP(Sub)
+SIMD_BINARY_OP(Mul)
+SIMD_BINARY_OP(Div)
+#undef SIMD_BINARY_OP
+
+template <typename S> struct SqrOp {
+  typename S::Vec operator()(typename S::Vec a) const { return S::Mul(a, a); }
+};
+struct FloatAbsOp {
+  SimdFloat::Vec operator()(SimdFloat::Vec a) const {
+    return SimdFloat::AndBits(a, 0x7fffffff);
+  }
+};
+struct DoubleAbsOp {
+  SimdDouble::Vec operator()(SimdDouble::Vec a) const {
+    return SimdDouble::Abs(a);
+  }
+};
+struct ExpOp {
+  SimdFloat::Vec operator()(SimdFloat::Vec a) const { return Exp(a); }
+};
+struct LnOp {
+  SimdFloat::Vec operator()(SimdFloat::Vec a) const { return Log(a); }
+};
+
+// pow(a, b) for the exponents of CpuKernels::PowxVectorized.
+template <typename S> struct PowxOp {
+  explicit PowxOp(float b) : b(b) {}
+  typename S::Vec operator()(typename S::Vec a) const {
+    const typename S::Vec one = S::Set(1);
+    if (b == 1.f) { return a; }
+    if (b == 2.f) { return S::Mul(a, a); }
+    if (b == -1.f) { return S::Div(one, a); }
+    const typename S::Vec root = S::Sqrt(a);
+    if (b == 0.5f) { return root; }
+    if (b == -0.5f) { return S::Div(one, root); }
+    const typename S::Vec three_quarters = S::Mul(root, S::Sqrt(root));
+    return b > 0 ? three_quarters : S::Div(one, three_quarters);
+  }
+  float b;
+};
+
+#define SIMD_BINARY_KERNELS(name) \
+  void vs##name(const float* a, const float* b, float* y, int begin, \
+      int end) { \
+    BinaryKernel<SimdFloat>(a, b, y, name##Op<SimdFloat>(), begin, end); \
+  } \
+  void vd##name(const double* a, const double* b, double* y, int begin, \
+      int end) { \
+    BinaryKernel<SimdDouble>(a, b, y, name##Op<SimdDouble>(), begin, end); \
+  }
+SIMD_BINARY_KERNELS(Add)
+SIMD_BINARY_KERNELS(Sub)
+SIMD_BINARY_KERNELS(Mul)
+SIMD_BINARY_KERNELS(Div)
+#undef SIMD_BINARY_KERNELS
+
+void vsSqr(const float* a, float* y, int begin, int end) {
+  UnaryKernel<SimdFloat>(a, y, SqrOp<SimdFloat>(), begin, end);
+}
+
+void vdSqr(const double* a, double* y, int begin, int end) {
+  UnaryKernel<SimdDouble>(a, y, SqrOp<SimdDouble>(), begin, end);
+}
+
+void vsAbs(const float* a, float* y, int begin, int end) {
+  UnaryKernel<SimdFloat>(a, y, FloatAbsOp(), begin, end);
+}
+
+void vdAbs(const double* a, double* y, int begin, int end) {
+  UnaryKernel<SimdDouble>(a, y, DoubleAbsOp(), begin, end);
+}
+
+void vsExp(const float* a, float* y, int begin, int end) {
+  UnaryKernel<SimdFloat>(a, y, ExpOp(), begin, end);
+}
+
+void vsLn(const float* a, float* y, int begin, int end) {
+  UnaryKernel<SimdFloat>(a, y, LnOp(), begin, end);
+}
+
+void vsPowx(const float* a, float b, float* y, int begin, int end) {
+  UnaryKernel<SimdFloat>(a, y, PowxOp<SimdFloat>(b), begin, end);
+}
+
+void vdPowx(const double* a, float b, double* y, int begin, int end) {
+  UnaryKernel<SimdDouble>(a, y, PowxOp<SimdDouble>(b), begin, end);
+}
+
+void NormalizeBytes(const uint8_t* x, const float* mean, float mean_value,
+    float scale, float* y, int begin, int end) {
+  typedef SimdFloat S;
+  const S::Vec scale_vec = S::Set(scale);
+  const S::Vec mean_vec = S::Set(mean_value);
+  int i = begin;
+  for (; i + S::kWidth <= end; i += S::kWidth) {
+    const S::Vec pixels = S::LoadBytes(x + i);
+    S::Store(y + i, S::Mul(S::Sub(pixels, mean ? S::Load(mean + i) :
+                                          mean_vec), scale_vec));
+  }
+  for (; i < end; ++i) {
+    y[i] = (static_cast<float>(x[i]) - (mean ? mean[i] : mean_value)) * scale;
+  }
+}
+
+void GetKernels(CpuKernels* kernels) {
+  kernels->vsAdd = vsAdd;
+  kernels->vsSub = vsSub;
+  kernels->vsMul = vsMul;
+  kernels->vsDiv = vsDiv;
+  kernels->vdAdd = vdAdd;
+  kernels->vdSub = vdSub;
+  kernels->vdMul = vdMul;
+  kernels->vdDiv = vdDiv;
+  kernels->vsSqr = vsSqr;
+  kernels->vsAbs = vsAbs;
+  kernels->vdSqr = vdSqr;
+  kernels->vdAbs = vdAbs;
+  kernels->vsExp = vsExp;
+  kernels->vsLn = vsLn;
+  kernels->vsPowx = vsPowx;
+  kernels->vdPowx = vdPowx;
+  kernels->NormalizeBytes = NormalizeBytes;
+}
+
+#endif  // CAFFE_UTIL_SIMD_KERNELS_H_
@@ -0,0 +1,23 @@
+#ifndef CAFFE_UTIL_SOCKET_H_
+#define CAFFE_UTIL_SOCKET_H_
+
+#include <cstddef>
+
+namespace caffe {
+
+/**
+ * @brief Reads exactly size bytes from the file descriptor fd into data,
+ *        and returns false if the peer closed it or the read failed first.
+ */
+bool ReadAll(int fd, void* data, size_t size);
+
+/**
+ * @brief Sends exactly size bytes of data to the socket fd, and returns false
+ *        if the peer closed it or the send failed first. A closed peer does
+ *        not raise SIGPIPE where MSG_NOSIGNAL is supported.
+ */
+bool WriteAll(int fd, const void* data, size_t size);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SOCKET_H_
@@ -19,6 +19,10 @@ void ReadNetParamsFromTextFileOrDie(const string& param_file,
 void ReadNetParamsFromBinaryFileOrDie(const string& param_file,
                                       NetParameter* param);
 
+// Return true iff param_file names a net written by compile_net, which ends
+// in ".caffenet" as the weights of a net end in ".caffemodel".
+bool IsCompiledNetFile(const string& param_file);
+
 // Return true iff any layer contains parameters specified using
 // deprecated V0LayerParameter.
 bool NetNeedsV0ToV1Upgrade(const NetParameter& net_param);
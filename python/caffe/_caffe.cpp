@@ -10,6 +10,7 @@
 #include <numpy/arrayobject.h>
 
 // these need to be included after boost on OS X
+#include <algorithm>  // NOLINT(build/include_order)
 #include <string>  // NOLINT(build/include_order)
 #include <vector>  // NOLINT(build/include_order)
 #include <fstream>  // NOLINT
@@ -179,6 +180,246 @@ void Net_SetInputArrays(Net<Dtype>* net, bp::object data_obj,
       PyArray_DIMS(data_arr)[0]);
 }
 
+// Releases the GIL for its lifetime, so that other Python threads, e.g. ones
+// running other nets, proceed while Caffe computes.
+class ScopedGILRelease {
+ public:
+  ScopedGILRelease() : state_(PyEval_SaveThread()) { }
+  ~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+
+ private:
+  PyThreadState* state_;
+};
+
+// Python layers call back into Python, so nets holding one keep the GIL.
+static bool NetHasPythonLayer(const Net<Dtype>& net) {
+  for (int i = 0; i < net.layers().size(); ++i) {
+    if (string("Python") == net.layers()[i]->type()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Dtype Net_ForwardFromTo(Net<Dtype>* net, int start, int end) {
+  if (NetHasPythonLayer(*net)) {
+    return net->ForwardFromTo(start, end);
+  }
+  ScopedGILRelease release;
+  return net->ForwardFromTo(start, end);
+}
+
+void Net_BackwardFromTo(Net<Dtype>* net, int start, int end) {
+  if (NetHasPythonLayer(*net)) {
+    net->BackwardFromTo(start, end);
+    return;
+  }
+  ScopedGILRelease release;
+  net->BackwardFromTo(start, end);
+}
+
+// Returns the number of items in arr, which holds either one item of
+// item_shape or a stack of them.
+static int CountItems(PyArrayObject* arr, const string& name,
+    const vector<int>& item_shape) {
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_C_CONTIGUOUS)) {
+    throw std::runtime_error(name + " arrays must be C contiguous");
+  }
+  if (PyArray_TYPE(arr) != NPY_FLOAT32) {
+    throw std::runtime_error(name + " arrays must be float32");
+  }
+  const int num_axes = item_shape.size();
+  const int stacked = PyArray_NDIM(arr) - num_axes;
+  if (stacked != 0 && stacked != 1) {
+    throw std::runtime_error(name + " arrays must have the shape of one "
+        "item or of a stack of items");
+  }
+  for (int i = 0; i < num_axes; ++i) {
+    if (PyArray_DIMS(arr)[stacked + i] != item_shape[i]) {
+      throw std::runtime_error(name + " arrays have the wrong item shape");
+    }
+  }
+  return stacked ? PyArray_DIMS(arr)[0] : 1;
+}
+
+// Returns an array viewing the data of blob, which it keeps alive.
+static bp::object BlobDataView(shared_ptr<Blob<Dtype> > blob) {
+  bp::object pyblob(blob);
+  vector<npy_intp> dims(blob->shape().begin(), blob->shape().end());
+  PyObject* arr_obj = PyArray_SimpleNewFromData(blob->num_axes(),
+      dims.data(), NPY_FLOAT32, blob->mutable_cpu_data());
+  // SetBaseObject steals a ref, so we need to INCREF.
+  Py_INCREF(pyblob.ptr());
+  PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(arr_obj),
+      pyblob.ptr());
+  return bp::object(bp::handle<>(arr_obj));
+}
+
+// Whether arr, holding all the items of blob, can stand in for its memory
+// during a pass: layers are handed it as writable, aligned float32 memory.
+static bool CanViewArray(PyArrayObject* arr, const Blob<Dtype>& blob) {
+  return PyArray_NDIM(arr) == blob.num_axes() &&
+      PyArray_CHKFLAGS(arr, NPY_ARRAY_CARRAY) &&
+      PyArray_TYPE(arr) == NPY_FLOAT32;
+}
+
+// Whether a layer of net computes in place over memory, overwriting it.
+static bool ComputesInPlaceOver(const Net<Dtype>& net,
+    const shared_ptr<SyncedMemory>& memory) {
+  for (int i = 0; i < net.layers().size(); ++i) {
+    const vector<Blob<Dtype>*>& bottom = net.bottom_vecs()[i];
+    const vector<Blob<Dtype>*>& top = net.top_vecs()[i];
+    for (int j = 0; j < top.size(); ++j) {
+      if (top[j]->data() == memory &&
+          std::find(bottom.begin(), bottom.end(), top[j]) != bottom.end()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Gives blob back its own memory, set aside in own_data, holding the items
+// of arr.
+static void RestoreInput(Blob<Dtype>* blob, const Blob<Dtype>& own_data,
+    PyArrayObject* arr) {
+  blob->ShareData(own_data);
+  caffe_copy(blob->count(), static_cast<const Dtype*>(PyArray_DATA(arr)),
+      blob->mutable_cpu_data());
+}
+
+// Batched inference: packs the lists of arrays of inputs, keyed by input blob
+// name, into the input blobs, reshapes the net to their number of items and
+// runs it forward without the GIL. An input given as a single stack of items
+// is used in place, without a copy, unless a layer would overwrite it or it
+// is one of the outputs. Returns views of the outputs blobs.
+bp::object Net_Predict(Net<Dtype>* net, bp::dict inputs, bp::list outputs) {
+  const bp::list names = inputs.keys();
+  const int num_inputs = bp::len(names);
+  vector<Blob<Dtype>*> input_blobs;
+  vector<vector<PyArrayObject*> > input_arrays(num_inputs);
+  int num_items = -1;
+  for (int i = 0; i < num_inputs; ++i) {
+    const string name = bp::extract<string>(names[i]);
+    const vector<int>& input_indices = net->input_blob_indices();
+    Blob<Dtype>* blob = NULL;
+    for (int j = 0; j < input_indices.size(); ++j) {
+      if (net->blob_names()[input_indices[j]] == name) {
+        blob = net->input_blobs()[j];
+      }
+    }
+    if (!blob || blob->num_axes() == 0) {
+      throw std::runtime_error(name + " is not a batched input of the net");
+    }
+    const vector<int> item_shape(blob->shape().begin() + 1,
+        blob->shape().end());
+    const bp::object arrays = inputs[name];
+    int count = 0;
+    for (int j = 0; j < bp::len(arrays); ++j) {
+      const bp::object array = arrays[j];
+      if (!PyArray_Check(array.ptr())) {
+        throw std::runtime_error(name + " inputs must be numpy arrays");
+      }
+      input_arrays[i].push_back(
+          reinterpret_cast<PyArrayObject*>(array.ptr()));
+      count += CountItems(input_arrays[i].back(), name, item_shape);
+    }
+    if (count == 0) {
+      throw std::runtime_error(name + " has no items");
+    }
+    if (num_items >= 0 && count != num_items) {
+      throw std::runtime_error("all inputs must have the same number of "
+          "items");
+    }
+    num_items = count;
+    vector<int> shape(blob->shape());
+    shape[0] = num_items;
+    blob->Reshape(shape);
+    input_blobs.push_back(blob);
+  }
+  vector<string> output_names;
+  for (int i = 0; i < bp::len(outputs); ++i) {
+    output_names.push_back(bp::extract<string>(outputs[i]));
+    if (!net->has_blob(output_names.back())) {
+      throw std::runtime_error("the net has no blob " + output_names.back());
+    }
+  }
+  // The arrays stay referenced by inputs while the GIL is released.
+  const bool release_gil = !NetHasPythonLayer(*net);
+  {
+    shared_ptr<ScopedGILRelease> release(
+        release_gil ? new ScopedGILRelease() : NULL);
+    vector<shared_ptr<Blob<Dtype> > > own_data(num_inputs);
+    vector<shared_ptr<SyncedMemory> > views(num_inputs);
+    for (int i = 0; i < num_inputs; ++i) {
+      Blob<Dtype>* blob = input_blobs[i];
+      const string& name = net->blob_names()[net->input_blob_indices()[i]];
+      if (input_arrays[i].size() == 1 &&
+          CanViewArray(input_arrays[i][0], *blob) &&
+          std::find(output_names.begin(), output_names.end(), name) ==
+          output_names.end()) {
+        // Keep the blob's own memory aside while it views the array.
+        own_data[i].reset(new Blob<Dtype>(blob->shape()));
+        own_data[i]->ShareData(*blob);
+        Blob<Dtype> view(blob->shape());
+        view.set_cpu_data(static_cast<Dtype*>(
+            PyArray_DATA(input_arrays[i][0])));
+        blob->ShareData(view);
+        views[i] = view.data();
+        continue;
+      }
+      Dtype* data = blob->mutable_cpu_data();
+      for (int j = 0; j < input_arrays[i].size(); ++j) {
+        const int count = PyArray_SIZE(input_arrays[i][j]);
+        caffe_copy(count, static_cast<Dtype*>(
+            PyArray_DATA(input_arrays[i][j])), data);
+        data += count;
+      }
+    }
+    net->Reshape();
+    // Once reshaped, split, flatten and reshape tops share the input memory
+    // too; a layer computing in place over any of them would overwrite the
+    // caller's array.
+    bool restored = false;
+    for (int i = 0; i < num_inputs; ++i) {
+      if (views[i] && ComputesInPlaceOver(*net, views[i])) {
+        RestoreInput(input_blobs[i], *own_data[i], input_arrays[i][0]);
+        views[i].reset();
+        restored = true;
+      }
+    }
+    if (restored) {
+      net->Reshape();
+    }
+    net->Forward();
+    // The blobs sharing an array must not outlive the call viewing it: they
+    // share the input blob's own memory again, filled with the items.
+    const vector<shared_ptr<Blob<Dtype> > >& blobs = net->blobs();
+    for (int i = 0; i < num_inputs; ++i) {
+      if (!views[i]) {
+        continue;
+      }
+      input_blobs[i]->ShareData(*own_data[i]);
+      bool filled = false;
+      for (int j = 0; j < blobs.size(); ++j) {
+        if (blobs[j]->data() == views[i]) {
+          if (!filled) {
+            RestoreInput(input_blobs[i], *own_data[i], input_arrays[i][0]);
+            filled = true;
+          }
+          blobs[j]->ShareData(*input_blobs[i]);
+        }
+      }
+    }
+  }
+  bp::dict result;
+  for (int i = 0; i < output_names.size(); ++i) {
+    result[output_names[i]] = BlobDataView(net->blob_by_name(
+        output_names[i]));
+  }
+  return result;
+}
+
 Solver<Dtype>* GetSolverFromFile(const string& filename) {
   SolverParameter param;
   ReadSolverParamsFromTextFileOrDie(filename, &param);
@@ -238,6 +479,61 @@ bp::object Blob_Reshape(bp::tuple args, bp::dict kwargs) {
   return bp::object();
 }
 
+// Holds a reference to a numpy array for as long as a SyncedMemory uses its
+// buffer.
+struct ArrayReleaser {
+  explicit ArrayReleaser(PyObject* arr) : arr_(arr) { Py_INCREF(arr_); }
+  void operator()(SyncedMemory* mem) const {
+    delete mem;
+    // At interpreter shutdown, the array is gone or about to be, and the
+    // GIL can no longer be taken.
+    if (!Py_IsInitialized()) {
+      return;
+    }
+    // The memory may be released without the GIL, e.g. by a reshape in a pass.
+    PyGILState_STATE state = PyGILState_Ensure();
+    Py_DECREF(arr_);
+    PyGILState_Release(state);
+  }
+  PyObject* arr_;
+};
+
+// A blob whose data is the buffer of a numpy array.
+class ArrayBlob : public Blob<Dtype> {
+ public:
+  explicit ArrayBlob(PyArrayObject* arr)
+      : Blob<Dtype>(vector<int>(PyArray_DIMS(arr),
+                                PyArray_DIMS(arr) + PyArray_NDIM(arr))) {
+    this->data_.reset(new SyncedMemory(this->count_ * sizeof(Dtype)),
+        ArrayReleaser(reinterpret_cast<PyObject*>(arr)));
+    this->data_->set_cpu_data(PyArray_DATA(arr));
+  }
+};
+
+// Reshapes the blob like the array and makes its data the array's buffer,
+// without a copy. The array is kept alive while the blob uses it.
+void Blob_ShareData(Blob<Dtype>* self, bp::object arr_obj) {
+  if (!PyArray_Check(arr_obj.ptr())) {
+    throw std::runtime_error("Blob.share_data takes a numpy array");
+  }
+  PyArrayObject* arr = reinterpret_cast<PyArrayObject*>(arr_obj.ptr());
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_C_CONTIGUOUS)) {
+    throw std::runtime_error("array must be C contiguous");
+  }
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_WRITEABLE)) {
+    throw std::runtime_error("array must be writeable");
+  }
+  if (PyArray_TYPE(arr) != NPY_FLOAT32) {
+    throw std::runtime_error("array must be float32");
+  }
+  if (PyArray_SIZE(arr) == 0) {
+    throw std::runtime_error("array must not be empty");
+  }
+  ArrayBlob view(arr);
+  self->ReshapeLike(view);
+  self->ShareData(view);
+}
+
 bp::object BlobVec_add_blob(bp::tuple args, bp::dict kwargs) {
   if (bp::len(kwargs) > 0) {
     throw std::runtime_error("BlobVec.add_blob takes no kwargs");
@@ -299,8 +595,9 @@ BOOST_PYTHON_MODULE(_caffe) {
             bp::arg("weights")=bp::object())))
     // Legacy constructor
     .def("__init__", bp::make_constructor(&Net_Init_Load))
-    .def("_forward", &Net<Dtype>::ForwardFromTo)
-    .def("_backward", &Net<Dtype>::BackwardFromTo)
+    .def("_forward", &Net_ForwardFromTo)
+    .def("_backward", &Net_BackwardFromTo)
+    .def("_predict", &Net_Predict)
     .def("reshape", &Net<Dtype>::Reshape)
     .def("clear_param_diffs", &Net<Dtype>::ClearParamDiffs)
     // The cast is to select a particular overload.
@@ -347,6 +644,7 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("count",    static_cast<int (Blob<Dtype>::*)() const>(
         &Blob<Dtype>::count))
     .def("reshape",           bp::raw_function(&Blob_Reshape))
+    .def("share_data",        &Blob_ShareData)
     .add_property("data",     bp::make_function(&Blob<Dtype>::mutable_cpu_data,
           NdarrayCallPolicies()))
     .add_property("diff",     bp::make_function(&Blob<Dtype>::mutable_cpu_diff,
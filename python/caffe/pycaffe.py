@@ -248,6 +248,46 @@ def _Net_forward_backward_all(self, blobs=None, diffs=None, **kwargs):
     return all_outs, all_diffs
 
 
+def _Net_predict(self, inputs, blobs=None):
+    """
+    Batched inference: pack a list of inputs into the input blobs, reshape
+    the net to their number, and run it forward without holding the GIL, so
+    that other Python threads can run other nets meanwhile.
+
+    Parameters
+    ----------
+    inputs : list of ndarrays for a net with a single input, or a dict of
+             such lists keyed by input blob name. Each ndarray is one item,
+             shaped like the input blob without its first axis, or a stack of
+             items. A single writeable float32 C-contiguous stack is used
+             in place, without a copy, unless a layer computes in place over
+             it or its input blob is one of the returned blobs. The caller's
+             arrays are never modified.
+    blobs : list of blobs to return in addition to output blobs.
+
+    Returns
+    -------
+    outs : {blob name: blob ndarray} dict. The ndarrays are views of the
+           net's blobs, overwritten by the next pass: copy them to keep them.
+    """
+    if not isinstance(inputs, dict):
+        if len(self.inputs) != 1:
+            raise Exception('Pass a dict of inputs to a net with several '
+                            'inputs.')
+        inputs = {self.inputs[0]: inputs}
+    if set(inputs.keys()) != set(self.inputs):
+        raise Exception('Input blob arguments do not match net inputs.')
+    packed = {}
+    for in_, arrays in six.iteritems(inputs):
+        if isinstance(arrays, np.ndarray):
+            arrays = [arrays]
+        # Only converts the arrays that are not float32 and C-contiguous.
+        packed[in_] = [np.ascontiguousarray(arr, dtype=np.float32)
+                       for arr in arrays]
+    outputs = list(set(self.outputs + (blobs or [])))
+    return self._predict(packed, outputs)
+
+
 def _Net_set_input_arrays(self, data, labels):
     """
     Set input arrays of the in-memory MemoryDataLayer.
@@ -326,6 +366,7 @@ Net.forward = _Net_forward
 Net.backward = _Net_backward
 Net.forward_all = _Net_forward_all
 Net.forward_backward_all = _Net_forward_backward_all
+Net.predict = _Net_predict
 Net.set_input_arrays = _Net_set_input_arrays
 Net._batch = _Net_batch
 Net.inputs = _Net_inputs
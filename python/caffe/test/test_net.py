@@ -343,3 +343,188 @@ layer {
         net = caffe.Net(self.f.name, caffe.TEST, stages=['deploy'])
         self.check_net(net, ['pred'])
 
+
+
+class TestPredict(unittest.TestCase):
+
+    TEST_NET = """
+layer {
+  name: "data"
+  type: "Input"
+  top: "data"
+  input_param { shape { dim: 2 dim: 3 dim: 4 } }
+}
+layer {
+  name: "ip"
+  type: "InnerProduct"
+  bottom: "data"
+  top: "ip"
+  inner_product_param {
+    num_output: 5
+    weight_filler { type: "gaussian" std: 1 }
+    bias_filler { type: "constant" value: 1 }
+  }
+}
+"""
+
+    def setUp(self):
+        self.f = tempfile.NamedTemporaryFile(mode='w+')
+        self.f.write(self.TEST_NET)
+        self.f.flush()
+        self.net = caffe.Net(self.f.name, caffe.TEST)
+        self.items = [np.random.randn(3, 4).astype(np.float32)
+                      for _ in range(3)]
+
+    def tearDown(self):
+        self.f.close()
+
+    def expected(self, items):
+        weights = self.net.params['ip'][0].data
+        bias = self.net.params['ip'][1].data
+        return np.array([w.ravel().dot(weights.T) + bias for w in items])
+
+    def test_list(self):
+        outs = self.net.predict(self.items)
+        self.assertEqual(list(outs.keys()), ['ip'])
+        self.assertEqual(outs['ip'].shape, (3, 5))
+        self.assertEqual(list(self.net.blobs['data'].shape), [3, 3, 4])
+        np.testing.assert_allclose(outs['ip'], self.expected(self.items),
+                                   rtol=1e-4, atol=1e-4)
+
+    def test_stack(self):
+        stack = np.array(self.items)
+        outs = self.net.predict({'data': stack})
+        np.testing.assert_allclose(outs['ip'], self.expected(self.items),
+                                   rtol=1e-4, atol=1e-4)
+        # The stack was used in place, and the blob got its memory back.
+        self.assertEqual(list(self.net.blobs['data'].shape), [3, 3, 4])
+        self.assertFalse(np.shares_memory(self.net.blobs['data'].data, stack))
+
+    def test_mixed_and_converted(self):
+        items = [np.array(self.items[:2]), self.items[2].astype(np.float64)]
+        outs = self.net.predict(items)
+        np.testing.assert_allclose(outs['ip'], self.expected(self.items),
+                                   rtol=1e-4, atol=1e-4)
+
+    def test_wrong_shape(self):
+        with self.assertRaises(RuntimeError):
+            self.net.predict([np.zeros((4, 3), dtype=np.float32)])
+
+    def test_threads(self):
+        import threading
+        nets = [caffe.Net(self.f.name, caffe.TEST) for _ in range(4)]
+        for net in nets:
+            net.share_with(self.net)
+        expected = self.expected(self.items)
+        errors = []
+
+        def run(net):
+            for _ in range(20):
+                outs = net.predict(self.items)
+                if not np.allclose(outs['ip'], expected, rtol=1e-4,
+                                   atol=1e-4):
+                    errors.append(outs['ip'])
+        threads = [threading.Thread(target=run, args=(net,)) for net in nets]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(errors, [])
+
+    def test_read_only_stack(self):
+        stack = np.array(self.items)
+        stack.flags.writeable = False
+        outs = self.net.predict(stack)
+        np.testing.assert_allclose(outs['ip'], self.expected(self.items),
+                                   rtol=1e-4, atol=1e-4)
+
+    def test_input_blob_returned(self):
+        stack = np.array(self.items)
+        outs = self.net.predict(stack, blobs=['data'])
+        np.testing.assert_array_equal(outs['data'], stack)
+        self.assertFalse(np.shares_memory(outs['data'], stack))
+
+    def predict_with_layer(self, layer, blobs):
+        f = tempfile.NamedTemporaryFile(mode='w+')
+        # layer reads data and writes x, which feeds ip.
+        data, ip = self.TEST_NET.split('layer {\n  name: "ip"')
+        f.write(data + layer + 'layer {\n  name: "ip"' +
+                ip.replace('bottom: "data"', 'bottom: "x"'))
+        f.flush()
+        net = caffe.Net(f.name, caffe.TEST)
+        f.close()
+        net.share_with(self.net)
+        stack = np.array(self.items)
+        original = stack.copy()
+        outs = net.predict(stack, blobs=blobs)
+        # The caller's array is neither modified nor kept by the net.
+        np.testing.assert_array_equal(stack, original)
+        for blob in net.blobs.values():
+            self.assertFalse(np.shares_memory(blob.data, stack))
+        return outs
+
+    def test_in_place_first_layer(self):
+        outs = self.predict_with_layer("""
+layer { name: "relu" type: "ReLU" bottom: "data" top: "data" }
+layer { name: "x" type: "Flatten" bottom: "data" top: "x" }
+""", ['x'])
+        relu = [np.maximum(item, 0) for item in self.items]
+        np.testing.assert_allclose(outs['ip'], self.expected(relu),
+                                   rtol=1e-4, atol=1e-4)
+        np.testing.assert_array_equal(outs['x'],
+                                      np.array(relu).reshape(3, -1))
+
+    def test_aliasing_output(self):
+        outs = self.predict_with_layer("""
+layer { name: "x" type: "Flatten" bottom: "data" top: "x" }
+""", ['x'])
+        np.testing.assert_allclose(outs['ip'], self.expected(self.items),
+                                   rtol=1e-4, atol=1e-4)
+        np.testing.assert_array_equal(outs['x'],
+                                      np.array(self.items).reshape(3, -1))
+
+
+class TestBlobShareData(unittest.TestCase):
+
+    def setUp(self):
+        self.f = tempfile.NamedTemporaryFile(mode='w+')
+        self.f.write(TestPredict.TEST_NET)
+        self.f.flush()
+        self.net = caffe.Net(self.f.name, caffe.TEST)
+
+    def tearDown(self):
+        self.f.close()
+
+    def test_share_data(self):
+        blob = self.net.blobs['data']
+        arr = np.random.randn(4, 3, 4).astype(np.float32)
+        blob.share_data(arr)
+        self.assertEqual(list(blob.shape), [4, 3, 4])
+        self.assertTrue(np.shares_memory(blob.data, arr))
+        self.net.reshape()
+        weights = self.net.params['ip'][0].data
+        bias = self.net.params['ip'][1].data
+        expected = arr.reshape(4, -1).dot(weights.T) + bias
+        # The blob keeps the array alive.
+        del arr
+        out = self.net.forward()['ip']
+        np.testing.assert_allclose(out, expected, rtol=1e-4, atol=1e-4)
+
+    def test_grow_after_share_data(self):
+        blob = self.net.blobs['data']
+        arr = np.zeros((1, 3, 4), dtype=np.float32)
+        blob.share_data(arr)
+        blob.reshape(2, 3, 4)
+        self.assertFalse(np.shares_memory(blob.data, arr))
+
+    def test_share_data_checks(self):
+        blob = self.net.blobs['data']
+        with self.assertRaises(RuntimeError):
+            blob.share_data(np.zeros((2, 3, 4)))
+        with self.assertRaises(RuntimeError):
+            blob.share_data(np.zeros((2, 4, 3), dtype=np.float32).transpose(
+                0, 2, 1))
+        readonly = np.zeros((2, 3, 4), dtype=np.float32)
+        readonly.flags.writeable = False
+        with self.assertRaises(RuntimeError):
+            blob.share_data(readonly)
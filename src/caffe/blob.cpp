@@ -138,12 +138,16 @@ template <typename Dtype>
 void Blob<Dtype>::ShareData(const Blob& other) {
   CHECK_EQ(count_, other.count());
   data_ = other.data();
+  // The shared memory may only hold count_ elements: growing must reallocate.
+  capacity_ = count_;
 }
 
 template <typename Dtype>
 void Blob<Dtype>::ShareDiff(const Blob& other) {
   CHECK_EQ(count_, other.count());
   diff_ = other.diff();
+  // As in ShareData: the shared memory may only hold count_ elements.
+  capacity_ = count_;
 }
 
 // The "update" method is used for parameter blobs in a Net, which are stored
@@ -0,0 +1,114 @@
+#include <vector>
+
+#include "caffe/bucketed_inference.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void PadCopy(const Blob<Dtype>& src, Dtype pad_value, Blob<Dtype>* dst) {
+  const int num_axes = src.num_axes();
+  CHECK_EQ(num_axes, dst->num_axes()) << "Cannot pad " << src.shape_string()
+      << " to " << dst->shape_string();
+  CHECK_GT(num_axes, 0);
+  for (int i = 0; i < num_axes; ++i) {
+    CHECK_LE(src.shape(i), dst->shape(i)) << "Cannot pad "
+        << src.shape_string() << " to " << dst->shape_string();
+  }
+  Dtype* dst_data = dst->mutable_cpu_data();
+  if (src.count() != dst->count()) {
+    caffe_set(dst->count(), pad_value, dst_data);
+  }
+  if (src.count() == 0) {
+    return;
+  }
+  // Copy the rows along the last axis one by one, walking their index.
+  const int row = src.shape(num_axes - 1);
+  const int num_rows = src.count() / row;
+  const Dtype* src_data = src.cpu_data();
+  vector<int> index(num_axes, 0);
+  for (int i = 0; i < num_rows; ++i) {
+    caffe_copy(row, src_data + i * row, dst_data + dst->offset(index));
+    for (int axis = num_axes - 2; axis >= 0; --axis) {
+      if (++index[axis] < src.shape(axis)) {
+        break;
+      }
+      index[axis] = 0;
+    }
+  }
+}
+
+template <typename Dtype>
+BucketedInference<Dtype>::BucketedInference(
+    shared_ptr<InferenceSession<Dtype> > session,
+    const vector<vector<int> >& bucket_shapes, Dtype pad_value)
+    : session_(session), bucket_shapes_(bucket_shapes),
+      pad_value_(pad_value) {
+  CHECK_EQ(session_->weights().num_inputs(), 1)
+      << "Bucketed inference needs a net with a single input.";
+  const int num_axes = session_->weights().input_blobs()[0]->num_axes();
+  for (int i = 0; i < bucket_shapes_.size(); ++i) {
+    CHECK_EQ(bucket_shapes_[i].size(), num_axes)
+        << "Bucket " << i << " does not have the axes of the input.";
+    buckets_.push_back(session_->CreateContext());
+    Net<Dtype>* net = buckets_[i]->net();
+    net->input_blobs()[0]->Reshape(bucket_shapes_[i]);
+    net->Reshape();
+    // Allocate the activations and scratch buffers now.
+    caffe_set(net->input_blobs()[0]->count(), pad_value_,
+        net->input_blobs()[0]->mutable_cpu_data());
+    buckets_[i]->Forward();
+  }
+  spare_ = session_->CreateContext();
+}
+
+template <typename Dtype>
+int BucketedInference<Dtype>::FindBucket(const vector<int>& shape) const {
+  int best = -1;
+  int best_count = 0;
+  for (int i = 0; i < bucket_shapes_.size(); ++i) {
+    const vector<int>& bucket_shape = bucket_shapes_[i];
+    if (bucket_shape.size() != shape.size()) {
+      continue;
+    }
+    int count = 1;
+    bool holds = true;
+    for (int j = 0; j < shape.size(); ++j) {
+      holds = holds && shape[j] <= bucket_shape[j];
+      count *= bucket_shape[j];
+    }
+    if (holds && (best < 0 || count < best_count)) {
+      best = i;
+      best_count = count;
+    }
+  }
+  return best;
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& BucketedInference<Dtype>::Forward(
+    const Blob<Dtype>& input, int* bucket) {
+  const int index = FindBucket(input.shape());
+  if (bucket) {
+    *bucket = index;
+  }
+  if (index < 0) {
+    Net<Dtype>* net = spare_->net();
+    net->input_blobs()[0]->ReshapeLike(input);
+    net->Reshape();
+    caffe_copy(input.count(), input.cpu_data(),
+        net->input_blobs()[0]->mutable_cpu_data());
+    return spare_->Forward();
+  }
+  PadCopy(input, pad_value_, buckets_[index]->net()->input_blobs()[0]);
+  return buckets_[index]->Forward();
+}
+
+template void PadCopy(const Blob<float>& src, float pad_value,
+    Blob<float>* dst);
+template void PadCopy(const Blob<double>& src, double pad_value,
+    Blob<double>* dst);
+
+INSTANTIATE_CLASS(BucketedInference);
+
+}  // namespace caffe
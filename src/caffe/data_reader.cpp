@@ -1,4 +1,5 @@
 #include <boost/thread.hpp>
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -7,6 +8,7 @@
 #include "caffe/data_reader.hpp"
 #include "caffe/layers/data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/affinity.hpp"
 
 namespace caffe {
 
@@ -41,20 +43,15 @@ DataReader::~DataReader() {
 
 //
 
-DataReader::QueuePair::QueuePair(int size) {
+// A layer set up without a batch size asks for no datums; its queues still
+// need room for one.
+DataReader::QueuePair::QueuePair(int size)
+    : datums_(size),
+      free_(std::max(size, 1), RingQueue<Datum*>::SPSC),
+      full_(std::max(size, 1), RingQueue<Datum*>::SPSC) {
   // Initialize the free queue with requested number of datums
   for (int i = 0; i < size; ++i) {
-    free_.push(new Datum());
-  }
-}
-
-DataReader::QueuePair::~QueuePair() {
-  Datum* datum;
-  while (free_.try_pop(&datum)) {
-    delete datum;
-  }
-  while (full_.try_pop(&datum)) {
-    delete datum;
+    free_.push(&datums_[i]);
   }
 }
 
@@ -63,6 +60,10 @@ DataReader::QueuePair::~QueuePair() {
 DataReader::Body::Body(const LayerParameter& param)
     : param_(param),
       new_queue_pairs_() {
+  if (param.data_param().has_raw_shape()) {
+    CHECK_EQ(param.data_param().raw_shape().dim_size(), 3)
+        << "raw_shape must be (channels, height, width).";
+  }
   StartInternalThread();
 }
 
@@ -71,6 +72,7 @@ DataReader::Body::~Body() {
 }
 
 void DataReader::Body::InternalThreadEntry() {
+  ThreadAffinity::Apply(ThreadAffinity::READER);
   shared_ptr<db::DB> db(db::GetDB(param_.data_param().backend()));
   db->Open(param_.data_param().source(), db::READ);
   shared_ptr<db::Cursor> cursor(db->NewCursor());
@@ -100,12 +102,32 @@ void DataReader::Body::InternalThreadEntry() {
   } catch (boost::thread_interrupted&) {
     // Interrupted exception is expected on shutdown
   }
+  for (int i = 0; i < qps.size(); ++i) {
+    LOG(INFO) << "Reader queues of " << param_.name() << ": the prefetch "
+        << "thread waited " << qps[i]->full_.waits() << " times ("
+        << qps[i]->full_.wait_us() / 1000 << " ms) for a record, the reader "
+        << qps[i]->free_.waits() << " times (" << qps[i]->free_.wait_us() / 1000
+        << " ms) for a free one.";
+  }
 }
 
 void DataReader::Body::read_one(db::Cursor* cursor, QueuePair* qp) {
   Datum* datum = qp->free_.pop();
-  // TODO deserialize in-place instead of copy?
-  datum->ParseFromString(cursor->value());
+  const DataParameter& data_param = param_.data_param();
+  if (data_param.has_raw_shape()) {
+    // The pixels are copied into the datum's buffer as they are.
+    const BlobShape& shape = data_param.raw_shape();
+    cursor->ReadValue(datum->mutable_data());
+    CHECK_EQ(datum->data().size(), shape.dim(0) * shape.dim(1) * shape.dim(2))
+        << "The raw record " << cursor->key() << " is not one item of "
+        << "raw_shape.";
+    datum->set_channels(shape.dim(0));
+    datum->set_height(shape.dim(1));
+    datum->set_width(shape.dim(2));
+  } else {
+    CHECK(cursor->ParseValue(datum)) << "Cannot parse the record "
+        << cursor->key();
+  }
   qp->full_.push(datum);
 
   // go to the next iter
@@ -93,6 +93,27 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     }
   }
 
+  if (has_uint8 && !do_mirror) {
+    // Unmirrored uint8 images map rows onto rows: convert them with the
+    // vectorized kernel, a channel at a time when they are not cropped and a
+    // row at a time when they are.
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    const int rows = crop_size ? height : 1;
+    const int row_size = crop_size ? width : datum_height * datum_width;
+    for (int c = 0; c < datum_channels; ++c) {
+      const Dtype mean_value = has_mean_values ? mean_values_[c] : 0;
+      for (int r = 0; r < rows; ++r) {
+        const int data_index = crop_size ?
+            (c * datum_height + h_off + r) * datum_width + w_off :
+            c * row_size;
+        caffe_cpu_normalize_bytes(row_size, bytes + data_index,
+            has_mean_file ? mean + data_index : NULL, mean_value, scale,
+            transformed_data + (c * rows + r) * row_size);
+      }
+    }
+    return;
+  }
+
   Dtype datum_element;
   int top_index, data_index;
   for (int c = 0; c < datum_channels; ++c) {
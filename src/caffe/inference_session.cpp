@@ -0,0 +1,107 @@
+#include <string>
+#include <vector>
+
+#include "caffe/inference_session.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+InferenceSession<Dtype>::InferenceSession(const NetParameter& param,
+    const string& weights) {
+  Init(param, weights);
+}
+
+template <typename Dtype>
+InferenceSession<Dtype>::InferenceSession(const string& param_file,
+    const string& weights) {
+  NetParameter param;
+  if (IsCompiledNetFile(param_file)) {
+    ReadNetParamsFromBinaryFileOrDie(param_file, &param);
+  } else {
+    ReadNetParamsFromTextFileOrDie(param_file, &param);
+  }
+  Init(param, weights);
+}
+
+template <typename Dtype>
+void InferenceSession<Dtype>::Init(const NetParameter& param,
+    const string& weights) {
+  if (param.compiled()) {
+    CHECK_EQ(param.state().phase(), TEST)
+        << "Inference sessions run nets compiled for the TEST phase.";
+    param_ = param;
+  } else {
+    // Compile the net once here rather than in every context.
+    NetParameter test_param(param);
+    test_param.mutable_state()->set_phase(TEST);
+    Net<Dtype>::Compile(test_param, &param_);
+  }
+  weights_.reset(new Net<Dtype>(param_));
+  if (!weights.empty()) {
+    weights_->CopyTrainedLayersFrom(weights);
+  }
+  for (int i = 0; i < weights_->layers().size(); ++i) {
+    const LayerParameter& layer_param = weights_->layers()[i]->layer_param();
+    const BatchNormParameter& bn_param = layer_param.batch_norm_param();
+    CHECK(layer_param.type() != "BatchNorm" ||
+          !bn_param.has_use_global_stats() || bn_param.use_global_stats())
+        << "Layer " << layer_param.name() << " updates its statistics in the "
+        << "forward pass, so its weights cannot be shared by an inference "
+        << "session.";
+  }
+  mode_ = Caffe::mode();
+  device_ = -1;
+#ifndef CPU_ONLY
+  if (mode_ == Caffe::GPU) {
+    CUDA_CHECK(cudaGetDevice(&device_));
+  }
+#endif
+  // Synchronize the weights now: a lazy first copy from a forward pass would
+  // write the SyncedMemory of the weights from several threads at once.
+  const vector<shared_ptr<Blob<Dtype> > >& params = weights_->params();
+  for (int i = 0; i < params.size(); ++i) {
+    params[i]->cpu_data();
+    if (mode_ == Caffe::GPU) {
+      params[i]->gpu_data();
+    }
+  }
+}
+
+template <typename Dtype>
+shared_ptr<InferenceContext<Dtype> >
+InferenceSession<Dtype>::CreateContext() const {
+  return shared_ptr<InferenceContext<Dtype> >(
+      new InferenceContext<Dtype>(*this, mode_, device_));
+}
+
+template <typename Dtype>
+InferenceContext<Dtype>::InferenceContext(
+    const InferenceSession<Dtype>& session, Caffe::Brew mode, int device)
+    : mode_(mode), device_(device) {
+  net_.reset(new Net<Dtype>(session.param()));
+  net_->ShareTrainedLayersWith(&session.weights());
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& InferenceContext<Dtype>::Forward(Dtype* loss) {
+  // The Caffe state is per thread, and threads start in CPU mode.
+  if (Caffe::mode() != mode_) {
+    Caffe::set_mode(mode_);
+  }
+#ifndef CPU_ONLY
+  if (mode_ == Caffe::GPU) {
+    int current_device;
+    CUDA_CHECK(cudaGetDevice(&current_device));
+    if (current_device != device_) {
+      Caffe::SetDevice(device_);
+    }
+  }
+#endif
+  return net_->Forward(loss);
+}
+
+INSTANTIATE_CLASS(InferenceSession);
+INSTANTIATE_CLASS(InferenceContext);
+
+}  // namespace caffe
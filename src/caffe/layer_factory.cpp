@@ -31,8 +31,14 @@
 #include "caffe/layers/python_layer.hpp"
 #endif
 
+// Inference-only builds for a given net register only the layers it uses.
+#ifdef CAFFE_LAYER_WHITELIST
+#include "caffe_layer_whitelist.h"
+#endif
+
 namespace caffe {
 
+#if !defined(CAFFE_LAYER_WHITELIST) || defined(CAFFE_USE_LAYER_Convolution)
 // Get convolution layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetConvolutionLayer(
@@ -71,7 +77,9 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
 }
 
 REGISTER_LAYER_CREATOR(Convolution, GetConvolutionLayer);
+#endif
 
+#if !defined(CAFFE_LAYER_WHITELIST) || defined(CAFFE_USE_LAYER_Pooling)
 // Get pooling layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetPoolingLayer(const LayerParameter& param) {
@@ -108,7 +116,9 @@ shared_ptr<Layer<Dtype> > GetPoolingLayer(const LayerParameter& param) {
 }
 
 REGISTER_LAYER_CREATOR(Pooling, GetPoolingLayer);
+#endif
 
+#if !defined(CAFFE_LAYER_WHITELIST) || defined(CAFFE_USE_LAYER_LRN)
 // Get LRN layer according to engine
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetLRNLayer(const LayerParameter& param) {
@@ -145,7 +155,9 @@ shared_ptr<Layer<Dtype> > GetLRNLayer(const LayerParameter& param) {
 }
 
 REGISTER_LAYER_CREATOR(LRN, GetLRNLayer);
+#endif
 
+#if !defined(CAFFE_LAYER_WHITELIST) || defined(CAFFE_USE_LAYER_ReLU)
 // Get relu layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetReLULayer(const LayerParameter& param) {
@@ -168,7 +180,9 @@ shared_ptr<Layer<Dtype> > GetReLULayer(const LayerParameter& param) {
 }
 
 REGISTER_LAYER_CREATOR(ReLU, GetReLULayer);
+#endif
 
+#if !defined(CAFFE_LAYER_WHITELIST) || defined(CAFFE_USE_LAYER_Sigmoid)
 // Get sigmoid layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetSigmoidLayer(const LayerParameter& param) {
@@ -191,7 +205,9 @@ shared_ptr<Layer<Dtype> > GetSigmoidLayer(const LayerParameter& param) {
 }
 
 REGISTER_LAYER_CREATOR(Sigmoid, GetSigmoidLayer);
+#endif
 
+#if !defined(CAFFE_LAYER_WHITELIST) || defined(CAFFE_USE_LAYER_Softmax)
 // Get softmax layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetSoftmaxLayer(const LayerParameter& param) {
@@ -214,7 +230,9 @@ shared_ptr<Layer<Dtype> > GetSoftmaxLayer(const LayerParameter& param) {
 }
 
 REGISTER_LAYER_CREATOR(Softmax, GetSoftmaxLayer);
+#endif
 
+#if !defined(CAFFE_LAYER_WHITELIST) || defined(CAFFE_USE_LAYER_TanH)
 // Get tanh layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetTanHLayer(const LayerParameter& param) {
@@ -237,6 +255,7 @@ shared_ptr<Layer<Dtype> > GetTanHLayer(const LayerParameter& param) {
 }
 
 REGISTER_LAYER_CREATOR(TanH, GetTanHLayer);
+#endif
 
 #ifdef WITH_PYTHON_LAYER
 template <typename Dtype>
@@ -1,13 +1,18 @@
 #include <vector>
 
 #include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/profiler.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_gpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  Batch<Dtype>* batch;
+  {
+    ProfileScope profile(this->layer_param_.name().c_str(), "data_wait");
+    batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  }
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
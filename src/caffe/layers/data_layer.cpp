@@ -26,6 +26,9 @@ template <typename Dtype>
 void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.data_param().batch_size();
+  CHECK(!this->output_labels_ ||
+        !this->layer_param_.data_param().has_raw_shape())
+      << "Raw records have no label.";
   // Read a data point, and use it to initialize the top blob.
   Datum& datum = *(reader_.full().peek());
 
@@ -102,6 +105,7 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  this->ProfileLoadBatch(read_time, trans_time);
 }
 
 INSTANTIATE_CLASS(DataLayer);
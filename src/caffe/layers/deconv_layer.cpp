@@ -1,9 +1,52 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/deconv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+void DeconvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  BaseConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  const int* stride_data = this->stride_.cpu_data();
+  const int* pad_data = this->pad_.cpu_data();
+  const int* dilation_data = this->dilation_.cpu_data();
+  use_phases_ = !this->force_nd_im2col_ && this->num_spatial_axes_ == 2 &&
+      (stride_data[0] > 1 || stride_data[1] > 1);
+  for (int i = 0; i < this->num_spatial_axes_ && use_phases_; ++i) {
+    use_phases_ = dilation_data[i] == 1 &&
+        kernel_shape_data[i] % stride_data[i] == 0;
+  }
+  if (!use_phases_) {
+    return;
+  }
+  // Output row y is in phase (y + pad_h) % stride_h, at phase row
+  // q = (y + pad_h) / stride_h, and sums input rows q - taps_h + 1 to q.
+  taps_h_ = kernel_shape_data[0] / stride_data[0];
+  taps_w_ = kernel_shape_data[1] / stride_data[1];
+  phase_h_begin_ = pad_data[0] / stride_data[0];
+  phase_w_begin_ = pad_data[1] / stride_data[1];
+  phase_height_ = (this->output_shape_[0] - 1 + pad_data[0]) / stride_data[0]
+      + 1 - phase_h_begin_;
+  phase_width_ = (this->output_shape_[1] - 1 + pad_data[1]) / stride_data[1]
+      + 1 - phase_w_begin_;
+  const int num_phases = stride_data[0] * stride_data[1];
+  vector<int> shape(3);
+  shape[0] = this->group_;
+  shape[1] = num_phases * this->num_output_ / this->group_;
+  shape[2] = this->channels_ / this->group_ * taps_h_ * taps_w_;
+  phase_weight_.Reshape(shape);
+  shape.resize(2);
+  shape[0] = this->channels_ * taps_h_ * taps_w_;
+  shape[1] = phase_height_ * phase_width_;
+  phase_col_buffer_.Reshape(shape);
+  shape[0] = num_phases * this->num_output_;
+  phase_output_.Reshape(shape);
+}
+
 template <typename Dtype>
 void DeconvolutionLayer<Dtype>::compute_output_shape() {
   const int* kernel_shape_data = this->kernel_shape_.cpu_data();
@@ -21,16 +64,130 @@ void DeconvolutionLayer<Dtype>::compute_output_shape() {
   }
 }
 
+template <typename Dtype>
+void DeconvolutionLayer<Dtype>::phase_weights_cpu(const Dtype* weights) {
+  const int kernel_h = this->kernel_shape_.cpu_data()[0];
+  const int kernel_w = this->kernel_shape_.cpu_data()[1];
+  const int stride_h = this->stride_.cpu_data()[0];
+  const int stride_w = this->stride_.cpu_data()[1];
+  const int channels_per_group = this->channels_ / this->group_;
+  const int outputs_per_group = this->num_output_ / this->group_;
+  const int taps = channels_per_group * taps_h_ * taps_w_;
+  const int rows = phase_weight_.shape(1);
+  Dtype* phase_weight = phase_weight_.mutable_cpu_data();
+  // weights[c][o][th * stride_h + ph][tw * stride_w + pw] goes to row
+  // (ph * stride_w + pw) * outputs_per_group + o and column
+  // (c * taps_h + th) * taps_w + tw of the gemm of the group of c. The
+  // channels are the inner loop so that the rows are written in order.
+  for (int g = 0; g < this->group_; ++g) {
+    for (int o = 0; o < outputs_per_group; ++o) {
+      for (int c = 0; c < channels_per_group; ++c) {
+        const Dtype* kernel = weights + ((g * channels_per_group + c) *
+            outputs_per_group + o) * kernel_h * kernel_w;
+        Dtype* col = phase_weight + (g * rows + o) * taps +
+            c * taps_h_ * taps_w_;
+        for (int kh = 0; kh < kernel_h; ++kh) {
+          for (int kw = 0; kw < kernel_w; ++kw) {
+            const int phase = (kh % stride_h) * stride_w + kw % stride_w;
+            col[phase * outputs_per_group * taps +
+                (kh / stride_h) * taps_w_ + kw / stride_w] =
+                kernel[kh * kernel_w + kw];
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void DeconvolutionLayer<Dtype>::forward_cpu_phases(const Dtype* input,
+      Dtype* output) {
+  const int height = this->input_shape(1);
+  const int width = this->input_shape(2);
+  const int phase_dim = phase_height_ * phase_width_;
+  // Gather the input at the taps of each phase position.
+  Dtype* col = phase_col_buffer_.mutable_cpu_data();
+  for (int c = 0; c < this->channels_; ++c) {
+    for (int th = 0; th < taps_h_; ++th) {
+      for (int tw = 0; tw < taps_w_; ++tw) {
+        const int w_shift = phase_w_begin_ - tw;
+        // Small inputs with large pads may have no column in the phase row.
+        const int w_begin = std::min(phase_width_, std::max(0, -w_shift));
+        const int w_end = std::max(w_begin,
+            std::min(phase_width_, width - w_shift));
+        for (int qh = 0; qh < phase_height_; ++qh, col += phase_width_) {
+          const int h = qh + phase_h_begin_ - th;
+          if (h < 0 || h >= height) {
+            caffe_set(phase_width_, Dtype(0), col);
+            continue;
+          }
+          caffe_set(w_begin, Dtype(0), col);
+          caffe_copy(w_end - w_begin,
+              input + (c * height + h) * width + w_begin + w_shift,
+              col + w_begin);
+          caffe_set(phase_width_ - w_end, Dtype(0), col + w_end);
+        }
+      }
+    }
+  }
+  // One gemm per group computes all phases.
+  const int rows = phase_weight_.shape(1);
+  const int taps = phase_weight_.shape(2);
+  for (int g = 0; g < this->group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, rows, phase_dim, taps,
+        (Dtype)1., phase_weight_.cpu_data() + g * rows * taps,
+        phase_col_buffer_.cpu_data() + g * taps * phase_dim, (Dtype)0.,
+        phase_output_.mutable_cpu_data() + g * rows * phase_dim);
+  }
+  // Interleave the phases into the output.
+  const int stride_h = this->stride_.cpu_data()[0];
+  const int stride_w = this->stride_.cpu_data()[1];
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int outputs_per_group = this->num_output_ / this->group_;
+  const Dtype* phases = phase_output_.cpu_data();
+  for (int oc = 0; oc < this->num_output_; ++oc) {
+    const int g = oc / outputs_per_group;
+    const int o = oc % outputs_per_group;
+    for (int y = 0; y < output_h; ++y) {
+      const int ph = (y + pad_h) % stride_h;
+      const int qh = (y + pad_h) / stride_h - phase_h_begin_;
+      Dtype* output_row = output + (oc * output_h + y) * output_w;
+      for (int pw = 0; pw < stride_w; ++pw) {
+        const Dtype* phase_row = phases +
+            ((g * stride_h * stride_w + ph * stride_w + pw) *
+             outputs_per_group + o) * phase_dim + qh * phase_width_;
+        // The first column of phase pw.
+        const int x_begin = ((pw - pad_w) % stride_w + stride_w) % stride_w;
+        int qw = (x_begin + pad_w) / stride_w - phase_w_begin_;
+        for (int x = x_begin; x < output_w; x += stride_w, ++qw) {
+          output_row[x] = phase_row[qw];
+        }
+      }
+    }
+  }
+}
+
 template <typename Dtype>
 void DeconvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* weight = this->blobs_[0]->cpu_data();
+  if (use_phases_) {
+    phase_weights_cpu(weight);
+  }
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < this->num_; ++n) {
-      this->backward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
+      if (use_phases_) {
+        forward_cpu_phases(bottom_data + n * this->bottom_dim_,
+            top_data + n * this->top_dim_);
+      } else {
+        this->backward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+      }
       if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->cpu_data();
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
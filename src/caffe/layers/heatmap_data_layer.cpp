@@ -174,6 +174,9 @@ void HeatmapDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
     // Start a timer
     CPUTimer batch_timer;
     batch_timer.Start();
+    double read_time = 0;
+    double trans_time = 0;
+    CPUTimer timer;
     CHECK(batch->data_.count());
     
     // Get the heatmap data parameters for this layer
@@ -213,7 +216,9 @@ void HeatmapDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
         // Read in the current image
         std::string img_path = heatmap_data_param.root_img_dir() + img_name;
         DLOG(INFO) << "img: " << img_path;
+        timer.Start();
         img = cv::imread(img_path, CV_LOAD_IMAGE_COLOR);
+        read_time += timer.MicroSeconds();
 
         // Show visualization of original image, overlaying annotations joined appropriately by lines
         if (heatmap_data_param.visualize())
@@ -228,6 +233,7 @@ void HeatmapDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
             img_vis = img.clone();
         }
 
+        timer.Start();
         // Convert from BGR (OpenCV) to RGB (Caffe)
         cv::cvtColor(img, img, CV_BGR2RGB);
         // Convert image to float-32
@@ -306,6 +312,7 @@ void HeatmapDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
         	}
 
         }
+        trans_time += timer.MicroSeconds();
 
         DLOG(INFO) << "Next image";
 
@@ -323,6 +330,9 @@ void HeatmapDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
     // Time stats
     batch_timer.Stop();
     DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+    DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
+    DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+    this->ProfileLoadBatch(read_time, trans_time);
 }
 
 
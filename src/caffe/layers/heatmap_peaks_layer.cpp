@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "caffe/layers/heatmap_peaks_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Orders peaks by decreasing value, and then in row-major order.
+template <typename Dtype>
+static bool HigherPeak(const std::pair<Dtype, int>& a,
+    const std::pair<Dtype, int>& b) {
+  return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+template <typename Dtype>
+void HeatmapPeaksLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const HeatmapPeaksParameter& peaks_param =
+      this->layer_param_.heatmap_peaks_param();
+  CHECK_EQ(1, peaks_param.kernel_size() % 2) << "kernel_size must be odd.";
+  CHECK_GE(peaks_param.top_k(), 1) << "top_k must be at least 1.";
+  radius_ = peaks_param.kernel_size() / 2;
+  threshold_ = peaks_param.threshold();
+  top_k_ = peaks_param.top_k();
+}
+
+template <typename Dtype>
+void HeatmapPeaksLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  CHECK_EQ(4, bottom[0]->num_axes()) << "Input must have 4 axes, "
+      << "corresponding to (num, channels, height, width)";
+  height_ = bottom[0]->height();
+  width_ = bottom[0]->width();
+  top[0]->Reshape(bottom[0]->num(), bottom[0]->channels(), top_k_, 3);
+  if (top.size() > 1) {
+    vector<int> count_shape(2);
+    count_shape[0] = bottom[0]->num();
+    count_shape[1] = bottom[0]->channels();
+    top[1]->Reshape(count_shape);
+  }
+  row_max_.Reshape(1, 1, height_, width_);
+  window_max_.Reshape(1, 1, 1, width_);
+}
+
+template <typename Dtype>
+void HeatmapPeaksLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int num_planes = bottom[0]->num() * bottom[0]->channels();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  Dtype* row_max = row_max_.mutable_cpu_data();
+  Dtype* window_max = window_max_.mutable_cpu_data();
+  for (int p = 0; p < num_planes; ++p) {
+    // The maxima of the windows along the rows, and then along the columns;
+    // the loops run over whole rows, so that they vectorize.
+    for (int h = 0; h < height_; ++h) {
+      const Dtype* in = bottom_data + h * width_;
+      Dtype* out = row_max + h * width_;
+      caffe_copy(width_, in, out);
+      for (int d = 1; d <= radius_ && d < width_; ++d) {
+        for (int w = d; w < width_; ++w) {
+          out[w] = std::max(out[w], in[w - d]);
+        }
+        for (int w = 0; w < width_ - d; ++w) {
+          out[w] = std::max(out[w], in[w + d]);
+        }
+      }
+    }
+    peaks_.clear();
+    for (int h = 0; h < height_; ++h) {
+      const int h_start = std::max(h - radius_, 0);
+      const int h_end = std::min(h + radius_ + 1, height_);
+      caffe_copy(width_, row_max + h_start * width_, window_max);
+      for (int i = h_start + 1; i < h_end; ++i) {
+        const Dtype* row = row_max + i * width_;
+        for (int w = 0; w < width_; ++w) {
+          window_max[w] = std::max(window_max[w], row[w]);
+        }
+      }
+      const Dtype* in = bottom_data + h * width_;
+      for (int w = 0; w < width_; ++w) {
+        if (in[w] >= threshold_ && in[w] == window_max[w]) {
+          peaks_.push_back(std::make_pair(in[w], h * width_ + w));
+        }
+      }
+    }
+    const int num_peaks = std::min(static_cast<int>(peaks_.size()), top_k_);
+    std::partial_sort(peaks_.begin(), peaks_.begin() + num_peaks,
+        peaks_.end(), HigherPeak<Dtype>);
+    for (int k = 0; k < top_k_; ++k) {
+      Dtype* peak = top_data + k * 3;
+      if (k < num_peaks) {
+        peak[0] = peaks_[k].second % width_;
+        peak[1] = peaks_[k].second / width_;
+        peak[2] = peaks_[k].first;
+      } else {
+        peak[0] = -1;
+        peak[1] = -1;
+        peak[2] = 0;
+      }
+    }
+    if (top.size() > 1) {
+      top[1]->mutable_cpu_data()[p] = num_peaks;
+    }
+    bottom_data += height_ * width_;
+    top_data += top_k_ * 3;
+  }
+}
+
+INSTANTIATE_CLASS(HeatmapPeaksLayer);
+REGISTER_LAYER_CLASS(HeatmapPeaks);
+
+}  // namespace caffe
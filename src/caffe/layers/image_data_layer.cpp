@@ -1,8 +1,11 @@
 #ifdef USE_OPENCV
 #include <opencv2/core/core.hpp>
 
+#include <boost/thread.hpp>
+
 #include <fstream>  // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
+#include <map>
 #include <string>
 #include <utility>
 #include <vector>
@@ -10,6 +13,7 @@
 #include "caffe/data_transformer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/layers/image_data_layer.hpp"
+#include "caffe/util/affinity.hpp"
 #include "caffe/util/benchmark.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
@@ -17,9 +21,102 @@
 
 namespace caffe {
 
+/**
+ * @brief Decodes the images of an ImageDataLayer on a pool of threads into a
+ *        ring buffer, from which load_batch takes them in list order.
+ *
+ * Each reader claims the next sequence number and line under the lock, once
+ * the ring has room for it, then decodes the image outside the lock into the
+ * slot of that number. The order of the images thus does not depend on which
+ * reader finishes first.
+ */
+template <typename Dtype>
+class ImageDataLayer<Dtype>::Decoder {
+ public:
+  Decoder(ImageDataLayer<Dtype>* layer, int num_threads, int capacity)
+      : layer_(layer), slots_(capacity), capacity_(capacity), next_claim_(0),
+        next_take_(0) {
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.create_thread(boost::bind(&Decoder::Run, this));
+    }
+  }
+  ~Decoder() {
+    threads_.interrupt_all();
+    threads_.join_all();
+  }
+
+  // Waits for the next image in list order and returns it with its label.
+  cv::Mat Take(int* label) {
+    boost::mutex::scoped_lock lock(mutex_);
+    Slot& slot = slots_[next_take_ % capacity_];
+    while (!slot.ready) {
+      ready_.wait(lock);
+    }
+    cv::Mat image = slot.image;
+    *label = slot.label;
+    slot.image.release();
+    slot.ready = false;
+    ++next_take_;
+    room_.notify_all();
+    return image;
+  }
+
+ protected:
+  struct Slot {
+    Slot() : label(0), ready(false) {}
+    cv::Mat image;
+    int label;
+    bool ready;
+  };
+
+  void Run() {
+    ThreadAffinity::Apply(ThreadAffinity::READER);
+    const ImageDataParameter& param = layer_->layer_param_.image_data_param();
+    try {
+      while (true) {
+        boost::this_thread::interruption_point();
+        int64_t sequence;
+        std::pair<int, int> line;
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          while (next_claim_ >= next_take_ + capacity_) {
+            room_.wait(lock);
+          }
+          sequence = next_claim_++;
+          line = layer_->NextLine();
+        }
+        const char* path = &layer_->path_arena_[line.first];
+        cv::Mat image = ReadImageToCVMat(param.root_folder() + path,
+            param.new_height(), param.new_width(), param.is_color());
+        CHECK(image.data) << "Could not load " << path;
+        boost::mutex::scoped_lock lock(mutex_);
+        Slot& slot = slots_[sequence % capacity_];
+        slot.image = image;
+        slot.label = line.second;
+        slot.ready = true;
+        ready_.notify_all();
+      }
+    } catch (boost::thread_interrupted&) {
+      // Interrupted exception is expected on shutdown
+    }
+  }
+
+  ImageDataLayer<Dtype>* layer_;
+  vector<Slot> slots_;
+  const int capacity_;
+  // The sequence numbers of the next image to claim and to take.
+  int64_t next_claim_;
+  int64_t next_take_;
+  boost::mutex mutex_;
+  boost::condition_variable room_;
+  boost::condition_variable ready_;
+  boost::thread_group threads_;
+};
+
 template <typename Dtype>
 ImageDataLayer<Dtype>::~ImageDataLayer<Dtype>() {
   this->StopInternalThread();
+  decoder_.reset();
 }
 
 template <typename Dtype>
@@ -40,10 +137,20 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   string line;
   size_t pos;
   int label;
+  // Store each distinct path once in the arena.
+  std::map<string, int> path_offsets;
   while (std::getline(infile, line)) {
     pos = line.find_last_of(' ');
     label = atoi(line.substr(pos + 1).c_str());
-    lines_.push_back(std::make_pair(line.substr(0, pos), label));
+    const string path = line.substr(0, pos);
+    std::map<string, int>::iterator it = path_offsets.find(path);
+    if (it == path_offsets.end()) {
+      it = path_offsets.insert(
+          std::make_pair(path, static_cast<int>(path_arena_.size()))).first;
+      path_arena_.insert(path_arena_.end(), path.begin(), path.end());
+      path_arena_.push_back('\0');
+    }
+    lines_.push_back(std::make_pair(it->second, label));
   }
 
   CHECK(!lines_.empty()) << "File is empty";
@@ -67,9 +174,9 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     lines_id_ = skip;
   }
   // Read an image, and use it to initialize the top blob.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
+  cv::Mat cv_img = ReadImageToCVMat(root_folder + path(lines_id_),
                                     new_height, new_width, is_color);
-  CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
+  CHECK(cv_img.data) << "Could not load " << path(lines_id_);
   // Use data_transformer to infer the expected blob shape from a cv_image.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
   this->transformed_data_.Reshape(top_shape);
@@ -91,6 +198,14 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
     this->prefetch_[i].label_.Reshape(label_shape);
   }
+  const int decode_threads =
+      this->layer_param_.image_data_param().decode_threads();
+  CHECK_GT(decode_threads, 0) << "Need at least one decode thread.";
+  int decode_ahead = this->layer_param_.image_data_param().decode_ahead();
+  if (decode_ahead == 0) {
+    decode_ahead = 2 * batch_size;
+  }
+  decoder_.reset(new Decoder(this, decode_threads, decode_ahead));
 }
 
 template <typename Dtype>
@@ -100,6 +215,22 @@ void ImageDataLayer<Dtype>::ShuffleImages() {
   shuffle(lines_.begin(), lines_.end(), prefetch_rng);
 }
 
+// This function is called on the decoder threads, one at a time
+template <typename Dtype>
+std::pair<int, int> ImageDataLayer<Dtype>::NextLine() {
+  const std::pair<int, int> line = lines_[lines_id_];
+  lines_id_++;
+  if (lines_id_ >= lines_.size()) {
+    // We have reached the end. Restart from the first.
+    DLOG(INFO) << "Restarting data prefetching from start.";
+    lines_id_ = 0;
+    if (this->layer_param_.image_data_param().shuffle()) {
+      ShuffleImages();
+    }
+  }
+  return line;
+}
+
 // This function is called on prefetch thread
 template <typename Dtype>
 void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
@@ -112,16 +243,13 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CHECK(this->transformed_data_.count());
   ImageDataParameter image_data_param = this->layer_param_.image_data_param();
   const int batch_size = image_data_param.batch_size();
-  const int new_height = image_data_param.new_height();
-  const int new_width = image_data_param.new_width();
-  const bool is_color = image_data_param.is_color();
-  string root_folder = image_data_param.root_folder();
 
   // Reshape according to the first image of each batch
   // on single input batches allows for inputs of varying dimension.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-      new_height, new_width, is_color);
-  CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
+  timer.Start();
+  int label;
+  cv::Mat cv_img = decoder_->Take(&label);
+  read_time += timer.MicroSeconds();
   // Use data_transformer to infer the expected blob shape from a cv_img.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
   this->transformed_data_.Reshape(top_shape);
@@ -133,15 +261,13 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   Dtype* prefetch_label = batch->label_.mutable_cpu_data();
 
   // datum scales
-  const int lines_size = lines_.size();
   for (int item_id = 0; item_id < batch_size; ++item_id) {
     // get a blob
-    timer.Start();
-    CHECK_GT(lines_size, lines_id_);
-    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-        new_height, new_width, is_color);
-    CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
-    read_time += timer.MicroSeconds();
+    if (item_id > 0) {
+      timer.Start();
+      cv_img = decoder_->Take(&label);
+      read_time += timer.MicroSeconds();
+    }
     timer.Start();
     // Apply transformations (mirror, crop...) to the image
     int offset = batch->data_.offset(item_id);
@@ -149,22 +275,13 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
     this->data_transformer_->Transform(cv_img, &(this->transformed_data_));
     trans_time += timer.MicroSeconds();
 
-    prefetch_label[item_id] = lines_[lines_id_].second;
-    // go to the next iter
-    lines_id_++;
-    if (lines_id_ >= lines_size) {
-      // We have reached the end. Restart from the first.
-      DLOG(INFO) << "Restarting data prefetching from start.";
-      lines_id_ = 0;
-      if (this->layer_param_.image_data_param().shuffle()) {
-        ShuffleImages();
-      }
-    }
+    prefetch_label[item_id] = label;
   }
   batch_timer.Stop();
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  this->ProfileLoadBatch(read_time, trans_time);
 }
 
 INSTANTIATE_CLASS(ImageDataLayer);
@@ -0,0 +1,161 @@
+#include <cmath>
+#include <vector>
+
+#include "caffe/data_transformer.hpp"
+#include "caffe/layers/keypoint_data_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void RenderKeypointHeatmaps(const Datum& datum, int height, int width,
+    int label_height, int label_width, float sigma, Dtype* heatmaps) {
+  CHECK_EQ(datum.keypoint_size() % 2, 0) << "Keypoints are (x, y) pairs.";
+  const int num_keypoints = datum.keypoint_size() / 2;
+  CHECK(datum.keypoint_visible_size() == 0 ||
+        datum.keypoint_visible_size() == num_keypoints)
+      << "Need the visibility of all keypoints or of none.";
+  const int label_size = label_height * label_width;
+  caffe_set(num_keypoints * label_size, Dtype(0), heatmaps);
+  // The keypoints scaled to the label, as by HeatmapDataLayer.
+  const float scale_x = static_cast<float>(label_width) / width;
+  const float scale_y = static_cast<float>(label_height) / height;
+  const float norm = 4 / (sigma * std::sqrt(2 * M_PI));
+  const float inv_sigma_sq = 1 / (sigma * sigma);
+  for (int k = 0; k < num_keypoints; ++k) {
+    if (datum.keypoint_visible_size() > 0 && !datum.keypoint_visible(k)) {
+      continue;
+    }
+    const float x = scale_x * datum.keypoint(2 * k);
+    const float y = scale_y * datum.keypoint(2 * k + 1);
+    Dtype* heatmap = heatmaps + k * label_size;
+    for (int i = 0; i < label_height; ++i) {
+      const float dy = i - y;
+      for (int j = 0; j < label_width; ++j) {
+        const float dx = j - x;
+        heatmap[i * label_width + j] =
+            norm * std::exp(-0.5 * (dx * dx + dy * dy) * inv_sigma_sq);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+KeypointDataLayer<Dtype>::KeypointDataLayer(const LayerParameter& param)
+  : BasePrefetchingDataLayer<Dtype>(param),
+    reader_(param) {
+}
+
+template <typename Dtype>
+KeypointDataLayer<Dtype>::~KeypointDataLayer() {
+  this->StopInternalThread();
+}
+
+template <typename Dtype>
+void KeypointDataLayer<Dtype>::DataLayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CHECK(!this->transform_param_.mirror() &&
+        this->transform_param_.crop_size() == 0)
+      << "KeypointData cannot crop or mirror, which would move the keypoints.";
+  const HeatmapDataParameter& heatmap_param =
+      this->layer_param_.heatmap_data_param();
+  CHECK_GT(heatmap_param.label_sigma(), 0) << "label_sigma must be positive.";
+  const int batch_size = this->layer_param_.data_param().batch_size();
+  // Read a data point, and use it to initialize the top blobs.
+  Datum& datum = *(reader_.full().peek());
+  CHECK_GT(datum.keypoint_size(), 0) << "The records have no keypoints.";
+
+  // Use data_transformer to infer the expected blob shape from datum.
+  vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
+  this->transformed_data_.Reshape(top_shape);
+  // Reshape top[0] and prefetch_data according to the batch_size.
+  top_shape[0] = batch_size;
+  top[0]->Reshape(top_shape);
+  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
+    this->prefetch_[i].data_.Reshape(top_shape);
+  }
+  LOG(INFO) << "output data size: " << top[0]->num() << ","
+      << top[0]->channels() << "," << top[0]->height() << ","
+      << top[0]->width();
+  // heatmaps
+  vector<int> label_shape(4);
+  label_shape[0] = batch_size;
+  label_shape[1] = datum.keypoint_size() / 2;
+  label_shape[2] = heatmap_param.label_height();
+  label_shape[3] = heatmap_param.label_width();
+  top[1]->Reshape(label_shape);
+  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
+    this->prefetch_[i].label_.Reshape(label_shape);
+  }
+  LOG(INFO) << "output heatmap size: " << top[1]->shape_string();
+}
+
+// This function is called on prefetch thread
+template<typename Dtype>
+void KeypointDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
+  CPUTimer batch_timer;
+  batch_timer.Start();
+  double read_time = 0;
+  double trans_time = 0;
+  CPUTimer timer;
+  CHECK(batch->data_.count());
+  CHECK(this->transformed_data_.count());
+  const HeatmapDataParameter& heatmap_param =
+      this->layer_param_.heatmap_data_param();
+
+  // Reshape according to the first datum of each batch
+  // on single input batches allows for inputs of varying dimension.
+  const int batch_size = this->layer_param_.data_param().batch_size();
+  Datum& datum = *(reader_.full().peek());
+  // Use data_transformer to infer the expected blob shape from datum.
+  vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
+  this->transformed_data_.Reshape(top_shape);
+  // Reshape batch according to the batch_size.
+  top_shape[0] = batch_size;
+  batch->data_.Reshape(top_shape);
+  // Without cropping, the images keep the size of the records.
+  const int height = top_shape[2];
+  const int width = top_shape[3];
+
+  Dtype* top_data = batch->data_.mutable_cpu_data();
+  Dtype* top_label = batch->label_.mutable_cpu_data();
+  const int label_dim = batch->label_.count(1);
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    timer.Start();
+    // get a datum
+    Datum& datum = *(reader_.full().pop("Waiting for data"));
+    read_time += timer.MicroSeconds();
+    timer.Start();
+    // Apply data transformations (scale, mean...)
+    int offset = batch->data_.offset(item_id);
+    this->transformed_data_.set_cpu_data(top_data + offset);
+    this->data_transformer_->Transform(datum, &(this->transformed_data_));
+    CHECK_EQ(datum.keypoint_size() / 2, batch->label_.channels())
+        << "The records have different numbers of keypoints.";
+    RenderKeypointHeatmaps(datum, height, width, heatmap_param.label_height(),
+        heatmap_param.label_width(), heatmap_param.label_sigma(),
+        top_label + item_id * label_dim);
+    trans_time += timer.MicroSeconds();
+
+    reader_.free().push(const_cast<Datum*>(&datum));
+  }
+  timer.Stop();
+  batch_timer.Stop();
+  DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
+  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  this->ProfileLoadBatch(read_time, trans_time);
+}
+
+template void RenderKeypointHeatmaps(const Datum& datum, int height,
+    int width, int label_height, int label_width, float sigma,
+    float* heatmaps);
+template void RenderKeypointHeatmaps(const Datum& datum, int height,
+    int width, int label_height, int label_width, float sigma,
+    double* heatmaps);
+
+INSTANTIATE_CLASS(KeypointDataLayer);
+REGISTER_LAYER_CLASS(KeypointData);
+
+}  // namespace caffe
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/layers/resize_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void ResizeLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const ResizeParameter& resize_param = this->layer_param_.resize_param();
+  CHECK_EQ(4, bottom[0]->num_axes()) << "Input must have 4 axes, "
+      << "corresponding to (num, channels, height, width)";
+  nearest_ =
+      resize_param.interpolation() == ResizeParameter_Interpolation_NEAREST;
+  num_planes_ = bottom[0]->num() * bottom[0]->channels();
+  height_ = bottom[0]->height();
+  width_ = bottom[0]->width();
+  if (bottom.size() > 1) {
+    CHECK_EQ(4, bottom[1]->num_axes());
+    resized_height_ = bottom[1]->height();
+    resized_width_ = bottom[1]->width();
+  } else {
+    CHECK_EQ(resize_param.has_height(), resize_param.has_width())
+        << "Set both height and width, or neither to scale.";
+    if (resize_param.has_height()) {
+      resized_height_ = resize_param.height();
+      resized_width_ = resize_param.width();
+    } else {
+      CHECK_GT(resize_param.scale(), 0) << "The scale must be positive.";
+      resized_height_ = static_cast<int>(height_ * resize_param.scale());
+      resized_width_ = static_cast<int>(width_ * resize_param.scale());
+    }
+  }
+  CHECK_GT(resized_height_, 0) << "The resized height must be positive.";
+  CHECK_GT(resized_width_, 0) << "The resized width must be positive.";
+  top[0]->Reshape(bottom[0]->num(), bottom[0]->channels(), resized_height_,
+      resized_width_);
+  ComputeTaps(height_, resized_height_, &h_low_, &h_high_, &h_low_weight_,
+      &h_high_weight_);
+  ComputeTaps(width_, resized_width_, &w_low_, &w_high_, &w_low_weight_,
+      &w_high_weight_);
+  row_used_.assign(height_, false);
+  for (int h = 0; h < resized_height_; ++h) {
+    row_used_[h_low_[h]] = true;
+    row_used_[h_high_[h]] = true;
+  }
+  rows_.Reshape(1, 1, height_, resized_width_);
+}
+
+template <typename Dtype>
+void ResizeLayer<Dtype>::ComputeTaps(int size_in, int size_out,
+      vector<int>* low, vector<int>* high, vector<Dtype>* low_weight,
+      vector<Dtype>* high_weight) {
+  const bool align_corners =
+      this->layer_param_.resize_param().align_corners();
+  const double aligned_scale =
+      size_out > 1 ? static_cast<double>(size_in - 1) / (size_out - 1) : 0;
+  low->resize(size_out);
+  high->resize(size_out);
+  low_weight->resize(size_out);
+  high_weight->resize(size_out);
+  for (int i = 0; i < size_out; ++i) {
+    if (nearest_) {
+      (*low)[i] = align_corners ?
+          static_cast<int>(std::floor(i * aligned_scale + 0.5)) :
+          std::min(static_cast<int>(
+              static_cast<int64_t>(i) * size_in / size_out), size_in - 1);
+      (*high)[i] = (*low)[i];
+      (*low_weight)[i] = 1;
+      (*high_weight)[i] = 0;
+      continue;
+    }
+    const double source = align_corners ? i * aligned_scale :
+        std::max(0., (i + 0.5) * size_in / size_out - 0.5);
+    const int source_low = static_cast<int>(source);
+    if (source_low >= size_in - 1) {
+      (*low)[i] = (*high)[i] = size_in - 1;
+      (*low_weight)[i] = 1;
+      (*high_weight)[i] = 0;
+    } else {
+      (*low)[i] = source_low;
+      (*high)[i] = source_low + 1;
+      (*high_weight)[i] = source - source_low;
+      (*low_weight)[i] = 1 - (*high_weight)[i];
+    }
+  }
+}
+
+template <typename Dtype>
+void ResizeLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  Dtype* rows = rows_.mutable_cpu_data();
+  for (int p = 0; p < num_planes_; ++p) {
+    // Resample the rows that are used to the output width.
+    for (int h = 0; h < height_; ++h) {
+      if (!row_used_[h]) {
+        continue;
+      }
+      const Dtype* in = bottom_data + h * width_;
+      Dtype* row = rows + h * resized_width_;
+      if (nearest_) {
+        for (int w = 0; w < resized_width_; ++w) {
+          row[w] = in[w_low_[w]];
+        }
+      } else {
+        for (int w = 0; w < resized_width_; ++w) {
+          row[w] = w_low_weight_[w] * in[w_low_[w]] +
+              w_high_weight_[w] * in[w_high_[w]];
+        }
+      }
+    }
+    // Blend them into the output rows; a weight of 0 for the high row means
+    // one of 1 for the low one.
+    for (int h = 0; h < resized_height_; ++h) {
+      const Dtype* low = rows + h_low_[h] * resized_width_;
+      Dtype* out = top_data + h * resized_width_;
+      if (h_high_weight_[h] == 0) {
+        caffe_copy(resized_width_, low, out);
+      } else {
+        caffe_cpu_scale(resized_width_, h_low_weight_[h], low, out);
+        caffe_axpy(resized_width_, h_high_weight_[h],
+            rows + h_high_[h] * resized_width_, out);
+      }
+    }
+    bottom_data += height_ * width_;
+    top_data += resized_height_ * resized_width_;
+  }
+}
+
+template <typename Dtype>
+void ResizeLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  // The second bottom only gives the shape.
+  if (!propagate_down[0]) {
+    return;
+  }
+  const Dtype* top_diff = top[0]->cpu_diff();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  Dtype* rows_diff = rows_.mutable_cpu_diff();
+  caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+  for (int p = 0; p < num_planes_; ++p) {
+    caffe_set(rows_.count(), Dtype(0), rows_diff);
+    for (int h = 0; h < resized_height_; ++h) {
+      const Dtype* out = top_diff + h * resized_width_;
+      caffe_axpy(resized_width_, h_low_weight_[h], out,
+          rows_diff + h_low_[h] * resized_width_);
+      if (h_high_weight_[h] != 0) {
+        caffe_axpy(resized_width_, h_high_weight_[h], out,
+            rows_diff + h_high_[h] * resized_width_);
+      }
+    }
+    for (int h = 0; h < height_; ++h) {
+      if (!row_used_[h]) {
+        continue;
+      }
+      const Dtype* row = rows_diff + h * resized_width_;
+      Dtype* in = bottom_diff + h * width_;
+      for (int w = 0; w < resized_width_; ++w) {
+        in[w_low_[w]] += w_low_weight_[w] * row[w];
+        in[w_high_[w]] += w_high_weight_[w] * row[w];
+      }
+    }
+    top_diff += resized_height_ * resized_width_;
+    bottom_diff += height_ * width_;
+  }
+}
+
+INSTANTIATE_CLASS(ResizeLayer);
+REGISTER_LAYER_CLASS(Resize);
+
+}  // namespace caffe
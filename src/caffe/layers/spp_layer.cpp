@@ -1,12 +1,9 @@
 #include <algorithm>
+#include <cfloat>
 #include <vector>
 
-#include "caffe/layer.hpp"
-#include "caffe/layers/concat_layer.hpp"
-#include "caffe/layers/flatten_layer.hpp"
-#include "caffe/layers/pooling_layer.hpp"
-#include "caffe/layers/split_layer.hpp"
 #include "caffe/layers/spp_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
@@ -14,132 +11,57 @@ using std::min;
 using std::max;
 
 template <typename Dtype>
-LayerParameter SPPLayer<Dtype>::GetPoolingParam(const int pyramid_level,
-      const int bottom_h, const int bottom_w, const SPPParameter spp_param) {
-  LayerParameter pooling_param;
-  int num_bins = pow(2, pyramid_level);
-
+void SPPLayer<Dtype>::ComputeBins(const int pyramid_level, const int size,
+      vector<int>* start, vector<int>* end, vector<int>* padded_size) {
+  const int num_bins = 1 << pyramid_level;
   // find padding and kernel size so that the pooling is
   // performed across the entire image
-  int kernel_h = ceil(bottom_h / static_cast<double>(num_bins));
-  // remainder_h is the min number of pixels that need to be padded before
-  // entire image height is pooled over with the chosen kernel dimension
-  int remainder_h = kernel_h * num_bins - bottom_h;
-  // pooling layer pads (2 * pad_h) pixels on the top and bottom of the
-  // image.
-  int pad_h = (remainder_h + 1) / 2;
-
-  // similar logic for width
-  int kernel_w = ceil(bottom_w / static_cast<double>(num_bins));
-  int remainder_w = kernel_w * num_bins - bottom_w;
-  int pad_w = (remainder_w + 1) / 2;
-
-  pooling_param.mutable_pooling_param()->set_pad_h(pad_h);
-  pooling_param.mutable_pooling_param()->set_pad_w(pad_w);
-  pooling_param.mutable_pooling_param()->set_kernel_h(kernel_h);
-  pooling_param.mutable_pooling_param()->set_kernel_w(kernel_w);
-  pooling_param.mutable_pooling_param()->set_stride_h(kernel_h);
-  pooling_param.mutable_pooling_param()->set_stride_w(kernel_w);
-
-  switch (spp_param.pool()) {
-  case SPPParameter_PoolMethod_MAX:
-    pooling_param.mutable_pooling_param()->set_pool(
-        PoolingParameter_PoolMethod_MAX);
-    break;
-  case SPPParameter_PoolMethod_AVE:
-    pooling_param.mutable_pooling_param()->set_pool(
-        PoolingParameter_PoolMethod_AVE);
-    break;
-  case SPPParameter_PoolMethod_STOCHASTIC:
-    pooling_param.mutable_pooling_param()->set_pool(
-        PoolingParameter_PoolMethod_STOCHASTIC);
-    break;
-  default:
-    LOG(FATAL) << "Unknown pooling method.";
+  const int kernel = (size + num_bins - 1) / num_bins;
+  // remainder is the min number of pixels that need to be padded before
+  // the entire image is pooled over with the chosen kernel dimension;
+  // (remainder + 1) / 2 pixels go before the image, as in PoolingLayer
+  const int remainder = kernel * num_bins - size;
+  const int pad = (remainder + 1) / 2;
+  start->resize(num_bins);
+  end->resize(num_bins);
+  padded_size->resize(num_bins);
+  for (int i = 0; i < num_bins; ++i) {
+    const int bin_start = i * kernel - pad;
+    const int bin_end = bin_start + kernel;
+    (*padded_size)[i] = max(min(bin_end, size + pad) - bin_start, 1);
+    (*start)[i] = min(max(bin_start, 0), size);
+    (*end)[i] = max(min(bin_end, size), (*start)[i]);
   }
+}
 
-  return pooling_param;
+// Whether each bin of a level is the union of two adjacent bins of the next.
+static bool BinsNest(const vector<int>& start, const vector<int>& end,
+    const vector<int>& finer_start, const vector<int>& finer_end) {
+  for (int i = 0; i < start.size(); ++i) {
+    if (finer_start[2 * i] != start[i] || finer_end[2 * i + 1] != end[i] ||
+        finer_end[2 * i] != finer_start[2 * i + 1]) {
+      return false;
+    }
+  }
+  return true;
 }
 
 template <typename Dtype>
 void SPPLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   SPPParameter spp_param = this->layer_param_.spp_param();
-
-  num_ = bottom[0]->num();
-  channels_ = bottom[0]->channels();
-  bottom_h_ = bottom[0]->height();
-  bottom_w_ = bottom[0]->width();
-  reshaped_first_time_ = false;
-  CHECK_GT(bottom_h_, 0) << "Input dimensions cannot be zero.";
-  CHECK_GT(bottom_w_, 0) << "Input dimensions cannot be zero.";
-
   pyramid_height_ = spp_param.pyramid_height();
-  split_top_vec_.clear();
-  pooling_bottom_vecs_.clear();
-  pooling_layers_.clear();
-  pooling_top_vecs_.clear();
-  pooling_outputs_.clear();
-  flatten_layers_.clear();
-  flatten_top_vecs_.clear();
-  flatten_outputs_.clear();
-  concat_bottom_vec_.clear();
-
-  if (pyramid_height_ == 1) {
-    // pooling layer setup
-    LayerParameter pooling_param = GetPoolingParam(0, bottom_h_, bottom_w_,
-        spp_param);
-    pooling_layers_.push_back(shared_ptr<PoolingLayer<Dtype> > (
-        new PoolingLayer<Dtype>(pooling_param)));
-    pooling_layers_[0]->SetUp(bottom, top);
-    return;
-  }
-  // split layer output holders setup
-  for (int i = 0; i < pyramid_height_; i++) {
-    split_top_vec_.push_back(new Blob<Dtype>());
+  CHECK_GT(pyramid_height_, 0) << "pyramid_height must be positive.";
+  CHECK_LT(pyramid_height_, 16) << "pyramid_height is too large.";
+  CHECK(spp_param.pool() == SPPParameter_PoolMethod_MAX ||
+        spp_param.pool() == SPPParameter_PoolMethod_AVE)
+      << "SPP supports MAX and AVE pooling only.";
+  level_offset_.resize(pyramid_height_);
+  pyramid_bins_ = 0;
+  for (int i = 0; i < pyramid_height_; ++i) {
+    level_offset_[i] = pyramid_bins_;
+    pyramid_bins_ += (1 << i) * (1 << i);
   }
-
-  // split layer setup
-  LayerParameter split_param;
-  split_layer_.reset(new SplitLayer<Dtype>(split_param));
-  split_layer_->SetUp(bottom, split_top_vec_);
-
-  for (int i = 0; i < pyramid_height_; i++) {
-    // pooling layer input holders setup
-    pooling_bottom_vecs_.push_back(new vector<Blob<Dtype>*>);
-    pooling_bottom_vecs_[i]->push_back(split_top_vec_[i]);
-
-    // pooling layer output holders setup
-    pooling_outputs_.push_back(new Blob<Dtype>());
-    pooling_top_vecs_.push_back(new vector<Blob<Dtype>*>);
-    pooling_top_vecs_[i]->push_back(pooling_outputs_[i]);
-
-    // pooling layer setup
-    LayerParameter pooling_param = GetPoolingParam(
-        i, bottom_h_, bottom_w_, spp_param);
-
-    pooling_layers_.push_back(shared_ptr<PoolingLayer<Dtype> > (
-        new PoolingLayer<Dtype>(pooling_param)));
-    pooling_layers_[i]->SetUp(*pooling_bottom_vecs_[i], *pooling_top_vecs_[i]);
-
-    // flatten layer output holders setup
-    flatten_outputs_.push_back(new Blob<Dtype>());
-    flatten_top_vecs_.push_back(new vector<Blob<Dtype>*>);
-    flatten_top_vecs_[i]->push_back(flatten_outputs_[i]);
-
-    // flatten layer setup
-    LayerParameter flatten_param;
-    flatten_layers_.push_back(new FlattenLayer<Dtype>(flatten_param));
-    flatten_layers_[i]->SetUp(*pooling_top_vecs_[i], *flatten_top_vecs_[i]);
-
-    // concat layer input holders setup
-    concat_bottom_vec_.push_back(flatten_outputs_[i]);
-  }
-
-  // concat layer setup
-  LayerParameter concat_param;
-  concat_layer_.reset(new ConcatLayer<Dtype>(concat_param));
-  concat_layer_->SetUp(concat_bottom_vec_, top);
 }
 
 template <typename Dtype>
@@ -147,58 +69,163 @@ void SPPLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   CHECK_EQ(4, bottom[0]->num_axes()) << "Input must have 4 axes, "
       << "corresponding to (num, channels, height, width)";
-  // Do nothing if bottom shape is unchanged since last Reshape
-  if (num_ == bottom[0]->num() && channels_ == bottom[0]->channels() &&
-      bottom_h_ == bottom[0]->height() && bottom_w_ == bottom[0]->width() &&
-      reshaped_first_time_) {
-    return;
-  }
   num_ = bottom[0]->num();
   channels_ = bottom[0]->channels();
   bottom_h_ = bottom[0]->height();
   bottom_w_ = bottom[0]->width();
-  reshaped_first_time_ = true;
-  SPPParameter spp_param = this->layer_param_.spp_param();
+  CHECK_GT(bottom_h_, 0) << "Input dimensions cannot be zero.";
+  CHECK_GT(bottom_w_, 0) << "Input dimensions cannot be zero.";
+  h_start_.resize(pyramid_height_);
+  h_end_.resize(pyramid_height_);
+  h_size_.resize(pyramid_height_);
+  w_start_.resize(pyramid_height_);
+  w_end_.resize(pyramid_height_);
+  w_size_.resize(pyramid_height_);
+  for (int i = 0; i < pyramid_height_; ++i) {
+    ComputeBins(i, bottom_h_, &h_start_[i], &h_end_[i], &h_size_[i]);
+    ComputeBins(i, bottom_w_, &w_start_[i], &w_end_[i], &w_size_[i]);
+  }
+  nested_.assign(pyramid_height_, false);
+  for (int i = 0; i + 1 < pyramid_height_; ++i) {
+    nested_[i] =
+        BinsNest(h_start_[i], h_end_[i], h_start_[i + 1], h_end_[i + 1]) &&
+        BinsNest(w_start_[i], w_end_[i], w_start_[i + 1], w_end_[i + 1]);
+  }
+  // A single level keeps the shape of its pooling output; several are
+  // flattened and concatenated.
   if (pyramid_height_ == 1) {
-    LayerParameter pooling_param = GetPoolingParam(0, bottom_h_, bottom_w_,
-        spp_param);
-    pooling_layers_[0].reset(new PoolingLayer<Dtype>(pooling_param));
-    pooling_layers_[0]->SetUp(bottom, top);
-    pooling_layers_[0]->Reshape(bottom, top);
-    return;
+    top[0]->Reshape(num_, channels_, 1, 1);
+  } else {
+    vector<int> top_shape(2);
+    top_shape[0] = num_;
+    top_shape[1] = channels_ * pyramid_bins_;
+    top[0]->Reshape(top_shape);
+  }
+  if (this->layer_param_.spp_param().pool() ==
+      SPPParameter_PoolMethod_MAX) {
+    max_idx_.Reshape(top[0]->shape());
+  } else {
+    bin_diff_.Reshape(1, 1, 1, pyramid_bins_);
   }
-  split_layer_->Reshape(bottom, split_top_vec_);
-  for (int i = 0; i < pyramid_height_; i++) {
-    LayerParameter pooling_param = GetPoolingParam(
-        i, bottom_h_, bottom_w_, spp_param);
+}
 
-    pooling_layers_[i].reset(
-        new PoolingLayer<Dtype>(pooling_param));
-    pooling_layers_[i]->SetUp(
-        *pooling_bottom_vecs_[i], *pooling_top_vecs_[i]);
-    pooling_layers_[i]->Reshape(
-        *pooling_bottom_vecs_[i], *pooling_top_vecs_[i]);
-    flatten_layers_[i]->Reshape(
-        *pooling_top_vecs_[i], *flatten_top_vecs_[i]);
+template <typename Dtype>
+void SPPLayer<Dtype>::PoolLevel(const int pyramid_level, const int c,
+      const Dtype* bottom_data, Dtype* top_data, int* mask) {
+  const bool max_pool =
+      this->layer_param_.spp_param().pool() == SPPParameter_PoolMethod_MAX;
+  const int num_bins = 1 << pyramid_level;
+  const vector<int>& h_start = h_start_[pyramid_level];
+  const vector<int>& h_end = h_end_[pyramid_level];
+  const vector<int>& w_start = w_start_[pyramid_level];
+  const vector<int>& w_end = w_end_[pyramid_level];
+  const int offset =
+      channels_ * level_offset_[pyramid_level] + c * num_bins * num_bins;
+  Dtype* level_data = top_data + offset;
+  int* level_mask = max_pool ? mask + offset : NULL;
+  if (nested_[pyramid_level]) {
+    const int finer_bins = 2 * num_bins;
+    const int finer_offset = channels_ * level_offset_[pyramid_level + 1] +
+        c * finer_bins * finer_bins;
+    const Dtype* finer_data = top_data + finer_offset;
+    const int* finer_mask = max_pool ? mask + finer_offset : NULL;
+    for (int ph = 0; ph < num_bins; ++ph) {
+      for (int pw = 0; pw < num_bins; ++pw) {
+        const int pool_index = ph * num_bins + pw;
+        Dtype value = max_pool ? Dtype(-FLT_MAX) : Dtype(0);
+        int index = -1;
+        for (int dh = 0; dh < 2; ++dh) {
+          for (int dw = 0; dw < 2; ++dw) {
+            const int finer_index =
+                (2 * ph + dh) * finer_bins + 2 * pw + dw;
+            if (!max_pool) {
+              value += finer_data[finer_index];
+              continue;
+            }
+            // Ties go to the first in row-major order, as when pooling the
+            // input directly.
+            const int finer_max = finer_mask[finer_index];
+            if (finer_max >= 0 && (finer_data[finer_index] > value ||
+                (finer_data[finer_index] == value && finer_max < index))) {
+              value = finer_data[finer_index];
+              index = finer_max;
+            }
+          }
+        }
+        if (max_pool) {
+          level_mask[pool_index] = index;
+          value = index >= 0 ? value : Dtype(0);
+        }
+        level_data[pool_index] = value;
+      }
+    }
+    return;
+  }
+  for (int ph = 0; ph < num_bins; ++ph) {
+    for (int pw = 0; pw < num_bins; ++pw) {
+      const int pool_index = ph * num_bins + pw;
+      Dtype value = max_pool ? Dtype(-FLT_MAX) : Dtype(0);
+      int index = -1;
+      for (int h = h_start[ph]; h < h_end[ph]; ++h) {
+        const Dtype* row = bottom_data + h * bottom_w_;
+        if (max_pool) {
+          for (int w = w_start[pw]; w < w_end[pw]; ++w) {
+            if (row[w] > value) {
+              value = row[w];
+              index = h * bottom_w_ + w;
+            }
+          }
+        } else {
+          for (int w = w_start[pw]; w < w_end[pw]; ++w) {
+            value += row[w];
+          }
+        }
+      }
+      if (max_pool) {
+        // Bins entirely in the padding pool nothing.
+        level_mask[pool_index] = index;
+        value = index >= 0 ? value : Dtype(0);
+      }
+      level_data[pool_index] = value;
+    }
   }
-  concat_layer_->Reshape(concat_bottom_vec_, top);
 }
 
 template <typename Dtype>
 void SPPLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  if (pyramid_height_ == 1) {
-    pooling_layers_[0]->Forward(bottom, top);
-    return;
+  const bool max_pool =
+      this->layer_param_.spp_param().pool() == SPPParameter_PoolMethod_MAX;
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  int* mask = max_pool ? max_idx_.mutable_cpu_data() : NULL;
+  const int image_bins = channels_ * pyramid_bins_;
+  for (int n = 0; n < num_; ++n) {
+    for (int c = 0; c < channels_; ++c) {
+      // Finest level first, so that coarser ones can reuse it.
+      for (int i = pyramid_height_ - 1; i >= 0; --i) {
+        PoolLevel(i, c, bottom_data, top_data, mask);
+      }
+      bottom_data += bottom_h_ * bottom_w_;
+    }
+    if (!max_pool) {
+      for (int i = 0; i < pyramid_height_; ++i) {
+        const int num_bins = 1 << i;
+        Dtype* level_data = top_data + channels_ * level_offset_[i];
+        for (int c = 0; c < channels_; ++c) {
+          for (int ph = 0; ph < num_bins; ++ph) {
+            for (int pw = 0; pw < num_bins; ++pw) {
+              *level_data++ /= h_size_[i][ph] * w_size_[i][pw];
+            }
+          }
+        }
+      }
+    }
+    top_data += image_bins;
+    if (max_pool) {
+      mask += image_bins;
+    }
   }
-  split_layer_->Forward(bottom, split_top_vec_);
-  for (int i = 0; i < pyramid_height_; i++) {
-    pooling_layers_[i]->Forward(
-        *pooling_bottom_vecs_[i], *pooling_top_vecs_[i]);
-    flatten_layers_[i]->Forward(
-        *pooling_top_vecs_[i], *flatten_top_vecs_[i]);
-  }
-  concat_layer_->Forward(concat_bottom_vec_, top);
 }
 
 template <typename Dtype>
@@ -207,19 +234,88 @@ void SPPLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (!propagate_down[0]) {
     return;
   }
-  if (pyramid_height_ == 1) {
-    pooling_layers_[0]->Backward(top, propagate_down, bottom);
+  const Dtype* top_diff = top[0]->cpu_diff();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+  const int plane_size = bottom_h_ * bottom_w_;
+  if (this->layer_param_.spp_param().pool() == SPPParameter_PoolMethod_MAX) {
+    const int* mask = max_idx_.cpu_data();
+    for (int n = 0; n < num_; ++n) {
+      for (int i = 0; i < pyramid_height_; ++i) {
+        const int level_bins = (1 << i) * (1 << i);
+        for (int c = 0; c < channels_; ++c) {
+          Dtype* plane_diff = bottom_diff + (n * channels_ + c) * plane_size;
+          for (int j = 0; j < level_bins; ++j) {
+            if (*mask >= 0) {
+              plane_diff[*mask] += *top_diff;
+            }
+            ++mask;
+            ++top_diff;
+          }
+        }
+      }
+    }
     return;
   }
-  vector<bool> concat_propagate_down(pyramid_height_, true);
-  concat_layer_->Backward(top, concat_propagate_down, concat_bottom_vec_);
-  for (int i = 0; i < pyramid_height_; i++) {
-    flatten_layers_[i]->Backward(
-        *flatten_top_vecs_[i], propagate_down, *pooling_top_vecs_[i]);
-    pooling_layers_[i]->Backward(
-        *pooling_top_vecs_[i], propagate_down, *pooling_bottom_vecs_[i]);
+  // Average pooling: the gradient of each input pixel sums the per-pixel
+  // gradients of its bins. Those of nested levels are handed down to the
+  // finer bins, so that the input is traversed about once.
+  Dtype* bin_diff = bin_diff_.mutable_cpu_data();
+  const int image_bins = channels_ * pyramid_bins_;
+  for (int n = 0; n < num_; ++n) {
+    for (int c = 0; c < channels_; ++c) {
+      for (int i = 0; i < pyramid_height_; ++i) {
+        const int num_bins = 1 << i;
+        const Dtype* level_diff = top_diff + n * image_bins +
+            channels_ * level_offset_[i] + c * num_bins * num_bins;
+        Dtype* level_bin_diff = bin_diff + level_offset_[i];
+        for (int ph = 0; ph < num_bins; ++ph) {
+          for (int pw = 0; pw < num_bins; ++pw) {
+            level_bin_diff[ph * num_bins + pw] = level_diff[ph * num_bins + pw]
+                / (h_size_[i][ph] * w_size_[i][pw]);
+          }
+        }
+      }
+      for (int i = 0; i + 1 < pyramid_height_; ++i) {
+        if (!nested_[i]) {
+          continue;
+        }
+        const int num_bins = 1 << i;
+        const Dtype* level_bin_diff = bin_diff + level_offset_[i];
+        Dtype* finer_bin_diff = bin_diff + level_offset_[i + 1];
+        for (int ph = 0; ph < num_bins; ++ph) {
+          for (int pw = 0; pw < num_bins; ++pw) {
+            const Dtype diff = level_bin_diff[ph * num_bins + pw];
+            for (int dh = 0; dh < 2; ++dh) {
+              Dtype* finer_row =
+                  finer_bin_diff + (2 * ph + dh) * 2 * num_bins + 2 * pw;
+              finer_row[0] += diff;
+              finer_row[1] += diff;
+            }
+          }
+        }
+      }
+      Dtype* plane_diff = bottom_diff + (n * channels_ + c) * plane_size;
+      for (int i = 0; i < pyramid_height_; ++i) {
+        if (nested_[i]) {
+          continue;
+        }
+        const int num_bins = 1 << i;
+        const Dtype* level_bin_diff = bin_diff + level_offset_[i];
+        for (int ph = 0; ph < num_bins; ++ph) {
+          for (int h = h_start_[i][ph]; h < h_end_[i][ph]; ++h) {
+            Dtype* row = plane_diff + h * bottom_w_;
+            for (int pw = 0; pw < num_bins; ++pw) {
+              const Dtype diff = level_bin_diff[ph * num_bins + pw];
+              for (int w = w_start_[i][pw]; w < w_end_[i][pw]; ++w) {
+                row[w] += diff;
+              }
+            }
+          }
+        }
+      }
+    }
   }
-  split_layer_->Backward(split_top_vec_, propagate_down, bottom);
 }
 
 INSTANTIATE_CLASS(SPPLayer);
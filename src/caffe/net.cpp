@@ -5,22 +5,34 @@
 #include <utility>
 #include <vector>
 
+#ifndef INFERENCE_ONLY
 #include "hdf5.h"
+#endif  // INFERENCE_ONLY
 
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#ifndef INFERENCE_ONLY
 #include "caffe/util/hdf5.hpp"
+#endif  // INFERENCE_ONLY
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/profiler.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
 namespace caffe {
 
+// Whether Init describes the net it builds: the root net does, unless INFO
+// messages are not shown, in which case building them would only slow down
+// the construction of large nets.
+static bool LogInit() {
+  return Caffe::root_solver() && FLAGS_minloglevel <= google::GLOG_INFO;
+}
+
 template <typename Dtype>
 Net<Dtype>::Net(const NetParameter& param, const Net* root_net)
     : root_net_(root_net) {
@@ -33,6 +45,31 @@ Net<Dtype>::Net(const string& param_file, Phase phase,
     const Net* root_net)
     : root_net_(root_net) {
   NetParameter param;
+  if (IsCompiledNetFile(param_file)) {
+    // The state was fixed when the net was compiled; it has to be the one
+    // asked for.
+    ReadNetParamsFromBinaryFileOrDie(param_file, &param);
+    CHECK(param.compiled()) << param_file << " is not a compiled net.";
+    // Stages are compared as sets, and empty ones, which no rule can name,
+    // are left out.
+    const NetState& state = param.state();
+    vector<string> wanted_stages, compiled_stages;
+    for (int i = 0; stages != NULL && i < stages->size(); i++) {
+      if (!(*stages)[i].empty()) { wanted_stages.push_back((*stages)[i]); }
+    }
+    for (int i = 0; i < state.stage_size(); i++) {
+      if (!state.stage(i).empty()) {
+        compiled_stages.push_back(state.stage(i));
+      }
+    }
+    std::sort(wanted_stages.begin(), wanted_stages.end());
+    std::sort(compiled_stages.begin(), compiled_stages.end());
+    CHECK(state.phase() == phase && state.level() == level &&
+          wanted_stages == compiled_stages)
+        << param_file << " was compiled for another phase, level or stages.";
+    Init(param);
+    return;
+  }
   ReadNetParamsFromTextFileOrDie(param_file, &param);
   // Set phase, stages and level
   param.mutable_state()->set_phase(phase);
@@ -51,20 +88,24 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       << "root_net_ needs to be set for all non-root solvers";
   // Set phase from the state.
   phase_ = in_param.state().phase();
-  // Filter layers based on their include/exclude rules and
-  // the current NetState.
-  NetParameter filtered_param;
-  FilterNet(in_param, &filtered_param);
-  LOG_IF(INFO, Caffe::root_solver())
-      << "Initializing net from parameters: " << std::endl
-      << filtered_param.DebugString();
-  // Create a copy of filtered_param with splits added where necessary.
-  NetParameter param;
-  InsertSplits(filtered_param, &param);
+  // Filter the layers and insert splits, unless that was done when the net
+  // was compiled.
+  NetParameter compiled_param;
+  if (!in_param.compiled()) {
+    Compile(in_param, &compiled_param);
+  } else {
+    LOG_IF(INFO, LogInit())
+        << "Initializing net from compiled parameters: " << std::endl
+        << in_param.DebugString();
+  }
+  const NetParameter& param =
+      in_param.compiled() ? in_param : compiled_param;
+  const bool check_shapes = param.top_shape_size() > 0;
+  int num_top_shapes = 0;
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
-  map<string, int> blob_name_to_idx;
-  set<string> available_blobs;
+  boost::unordered_map<string, int> blob_name_to_idx;
+  boost::unordered_set<string> available_blobs;
   memory_used_ = 0;
   // For each layer, set up its input and output
   bottom_vecs_.resize(param.layer_size());
@@ -77,10 +118,6 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     // For non-root solvers, whether this layer is shared from root_net_.
     bool share_from_root = !Caffe::root_solver()
         && root_net_->layers_[layer_id]->ShareInParallel();
-    // Inherit phase from net if unset.
-    if (!param.layer(layer_id).has_phase()) {
-      param.mutable_layer(layer_id)->set_phase(phase_);
-    }
     // Setup layer.
     const LayerParameter& layer_param = param.layer(layer_id);
     if (layer_param.propagate_down_size() > 0) {
@@ -97,8 +134,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
     }
     layer_names_.push_back(layer_param.name());
-    LOG_IF(INFO, Caffe::root_solver())
-        << "Creating Layer " << layer_param.name();
+    LOG_IF(INFO, LogInit()) << "Creating Layer " << layer_param.name();
     bool need_backward = false;
 
     // Figure out this layer's input and output
@@ -147,22 +183,33 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     } else {
       layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
     }
-    LOG_IF(INFO, Caffe::root_solver())
-        << "Setting up " << layer_names_[layer_id];
+    if (check_shapes) {
+      for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+        CHECK_LT(num_top_shapes, param.top_shape_size())
+            << "Compiled net has fewer top shapes than its layers have tops.";
+        const BlobShape& shape = param.top_shape(num_top_shapes++);
+        CHECK(top_vecs_[layer_id][top_id]->shape() ==
+              vector<int>(shape.dim().begin(), shape.dim().end()))
+            << "Top " << top_id << " of layer " << layer_param.name()
+            << " set up as " << top_vecs_[layer_id][top_id]->shape_string()
+            << ", not as compiled; the net needs to be compiled again.";
+      }
+    }
+    LOG_IF(INFO, LogInit()) << "Setting up " << layer_names_[layer_id];
     for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
       if (blob_loss_weights_.size() <= top_id_vecs_[layer_id][top_id]) {
         blob_loss_weights_.resize(top_id_vecs_[layer_id][top_id] + 1, Dtype(0));
       }
       blob_loss_weights_[top_id_vecs_[layer_id][top_id]] = layer->loss(top_id);
-      LOG_IF(INFO, Caffe::root_solver())
+      LOG_IF(INFO, LogInit())
           << "Top shape: " << top_vecs_[layer_id][top_id]->shape_string();
       if (layer->loss(top_id)) {
-        LOG_IF(INFO, Caffe::root_solver())
+        LOG_IF(INFO, LogInit())
             << "    with loss weight " << layer->loss(top_id);
       }
       memory_used_ += top_vecs_[layer_id][top_id]->count();
     }
-    LOG_IF(INFO, Caffe::root_solver())
+    LOG_IF(INFO, LogInit())
         << "Memory required for data: " << memory_used_ * sizeof(Dtype);
     const int param_size = layer_param.param_size();
     const int num_param_blobs = layers_[layer_id]->blobs().size();
@@ -194,18 +241,19 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // Also checks if all bottom blobs don't need backward computation (possible
   // because the skip_propagate_down param) and so we can skip bacward
   // computation for the entire layer
-  set<string> blobs_under_loss;
-  set<string> blobs_skip_backp;
+  // Both are indexed by blob id: a name only ever stands for one blob that
+  // can be a bottom.
+  vector<bool> blobs_under_loss(blobs_.size(), false);
+  vector<bool> blobs_skip_backp(blobs_.size(), false);
   for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
     bool layer_contributes_loss = false;
     bool layer_skip_propagate_down = true;
     for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
-      const string& blob_name = blob_names_[top_id_vecs_[layer_id][top_id]];
-      if (layers_[layer_id]->loss(top_id) ||
-          (blobs_under_loss.find(blob_name) != blobs_under_loss.end())) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      if (layers_[layer_id]->loss(top_id) || blobs_under_loss[blob_id]) {
         layer_contributes_loss = true;
       }
-      if (blobs_skip_backp.find(blob_name) == blobs_skip_backp.end()) {
+      if (!blobs_skip_backp[blob_id]) {
         layer_skip_propagate_down = false;
       }
       if (layer_contributes_loss && !layer_skip_propagate_down)
@@ -221,7 +269,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       }
     }
     if (!layer_contributes_loss) { layer_need_backward_[layer_id] = false; }
-    if (Caffe::root_solver()) {
+    if (LogInit()) {
       if (layer_need_backward_[layer_id]) {
         LOG(INFO) << layer_names_[layer_id] << " needs backward computation.";
       } else {
@@ -231,17 +279,14 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     }
     for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
          ++bottom_id) {
+      const int blob_id = bottom_id_vecs_[layer_id][bottom_id];
       if (layer_contributes_loss) {
-        const string& blob_name =
-            blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
-        blobs_under_loss.insert(blob_name);
+        blobs_under_loss[blob_id] = true;
       } else {
         bottom_need_backward_[layer_id][bottom_id] = false;
       }
       if (!bottom_need_backward_[layer_id][bottom_id]) {
-        const string& blob_name =
-                   blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
-        blobs_skip_backp.insert(blob_name);
+        blobs_skip_backp[blob_id] = true;
       }
     }
   }
@@ -264,31 +309,169 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       }
     }
   }
-  // In the end, all remaining blobs are considered output blobs.
-  for (set<string>::iterator it = available_blobs.begin();
-      it != available_blobs.end(); ++it) {
-    LOG_IF(INFO, Caffe::root_solver())
-        << "This network produces output " << *it;
-    net_output_blobs_.push_back(blobs_[blob_name_to_idx[*it]].get());
-    net_output_blob_indices_.push_back(blob_name_to_idx[*it]);
+  // In the end, all remaining blobs are considered output blobs, in the
+  // order of their names.
+  vector<string> output_names(available_blobs.begin(), available_blobs.end());
+  std::sort(output_names.begin(), output_names.end());
+  for (int i = 0; i < output_names.size(); ++i) {
+    LOG_IF(INFO, LogInit())
+        << "This network produces output " << output_names[i];
+    const int blob_id = blob_name_to_idx[output_names[i]];
+    net_output_blobs_.push_back(blobs_[blob_id].get());
+    net_output_blob_indices_.push_back(blob_id);
   }
   for (size_t blob_id = 0; blob_id < blob_names_.size(); ++blob_id) {
     blob_names_index_[blob_names_[blob_id]] = blob_id;
   }
+  // Of layers sharing a name, the first is the one found by name.
   for (size_t layer_id = 0; layer_id < layer_names_.size(); ++layer_id) {
-    layer_names_index_[layer_names_[layer_id]] = layer_id;
+    layer_names_index_.insert(std::make_pair(layer_names_[layer_id],
+                                             static_cast<int>(layer_id)));
   }
+  CHECK(!check_shapes || num_top_shapes == param.top_shape_size())
+      << "Compiled net has more top shapes than its layers have tops.";
   ShareWeights();
   debug_info_ = param.debug_info();
-  LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
+  InitEarlyExits(param);
+  LOG_IF(INFO, LogInit()) << "Network initialization done.";
+}
+
+// The last layer with blob_id among its tops, or -1.
+static int LastLayerWriting(const vector<vector<int> >& top_id_vecs,
+    const int blob_id) {
+  int layer_id = -1;
+  for (int i = 0; i < top_id_vecs.size(); ++i) {
+    if (std::find(top_id_vecs[i].begin(), top_id_vecs[i].end(), blob_id) !=
+        top_id_vecs[i].end()) {
+      layer_id = i;
+    }
+  }
+  return layer_id;
+}
+
+template <typename Dtype>
+void Net<Dtype>::InitEarlyExits(const NetParameter& param) {
+  early_exit_ = phase_ == TEST;
+  exit_params_.clear();
+  exit_layer_ids_.clear();
+  exit_blob_ids_.clear();
+  exit_live_blob_ids_.clear();
+  exit_source_ids_.clear();
+  exit_output_id_ = -1;
+  exit_output_layer_id_ = -1;
+  if (param.early_exit_size() == 0) {
+    return;
+  }
+  // Only the output the exits stand in for is put back in the order of the
+  // batch; any other would be left with the items that did not exit.
+  CHECK_EQ(1, net_output_blob_indices_.size())
+      << "Early exits need a net with a single output.";
+  exit_output_id_ = net_output_blob_indices_[0];
+  // Sort the exits by the layer after which they are checked.
+  vector<pair<int, int> > exits;
+  for (int i = 0; i < param.early_exit_size(); ++i) {
+    const EarlyExitParameter& exit_param = param.early_exit(i);
+    CHECK(has_blob(exit_param.blob()))
+        << "Unknown early exit blob " << exit_param.blob();
+    CHECK(!exit_param.has_output() ||
+          exit_param.output() == blob_names_[exit_output_id_])
+        << "Early exit " << exit_param.blob() << " must stand in for the "
+        << "output of the net, " << blob_names_[exit_output_id_] << ".";
+    exits.push_back(std::make_pair(LastLayerWriting(top_id_vecs_,
+        blob_names_index_[exit_param.blob()]), i));
+  }
+  std::sort(exits.begin(), exits.end());
+  exit_output_layer_id_ = LastLayerWriting(top_id_vecs_, exit_output_id_);
+  for (int i = 0; i < exits.size(); ++i) {
+    const int layer_id = exits[i].first;
+    const EarlyExitParameter& exit_param = param.early_exit(exits[i].second);
+    CHECK_LT(layer_id, exit_output_layer_id_) << "Early exit "
+        << exit_param.blob() << " must be computed before the output.";
+    exit_params_.push_back(exit_param);
+    exit_layer_ids_.push_back(layer_id);
+    exit_blob_ids_.push_back(blob_names_index_[exit_param.blob()]);
+    vector<bool> computed(blobs_.size(), false);
+    for (int j = 0; j <= layer_id; ++j) {
+      for (int k = 0; k < top_id_vecs_[j].size(); ++k) {
+        computed[top_id_vecs_[j][k]] = true;
+      }
+    }
+    vector<int> live_blob_ids;
+    for (int j = layer_id + 1; j < layers_.size(); ++j) {
+      for (int k = 0; k < bottom_id_vecs_[j].size(); ++k) {
+        const int blob_id = bottom_id_vecs_[j][k];
+        if (computed[blob_id]) {
+          live_blob_ids.push_back(blob_id);
+          computed[blob_id] = false;
+        }
+      }
+    }
+    exit_live_blob_ids_.push_back(live_blob_ids);
+    LOG_IF(INFO, LogInit()) << "Early exit after " << layer_names_[layer_id]
+        << " at " << exit_param.blob() << " for "
+        << blob_names_[exit_output_id_];
+  }
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (bottom_id_vecs_[i].empty()) {
+      exit_source_ids_.insert(exit_source_ids_.end(), top_id_vecs_[i].begin(),
+          top_id_vecs_[i].end());
+    }
+  }
+  exit_source_copies_.resize(exit_source_ids_.size());
+  for (int i = 0; i < exit_source_ids_.size(); ++i) {
+    exit_source_copies_[i].reset(new Blob<Dtype>());
+  }
+  exit_source_saved_.assign(exit_source_ids_.size(), false);
+}
+
+template <typename Dtype>
+void Net<Dtype>::Compile(const NetParameter& param,
+    NetParameter* param_compiled) {
+  // Filter layers based on their include/exclude rules and
+  // the current NetState.
+  NetParameter filtered_param;
+  FilterNet(param, &filtered_param);
+  LOG_IF(INFO, LogInit())
+      << "Initializing net from parameters: " << std::endl
+      << filtered_param.DebugString();
+  // Create a copy of filtered_param with splits added where necessary.
+  InsertSplits(filtered_param, param_compiled);
+  // Layers inherit the phase of the net if unset.
+  const Phase phase = param_compiled->state().phase();
+  for (int i = 0; i < param_compiled->layer_size(); ++i) {
+    if (!param_compiled->layer(i).has_phase()) {
+      param_compiled->mutable_layer(i)->set_phase(phase);
+    }
+  }
+  param_compiled->set_compiled(true);
+  param_compiled->clear_top_shape();
+}
+
+template <typename Dtype>
+void Net<Dtype>::RecordTopShapes(NetParameter* param_compiled) const {
+  CHECK(param_compiled->compiled()) << "Only compiled nets record top shapes.";
+  CHECK_EQ(layers_.size(), param_compiled->layer_size())
+      << "The net was not built from " << param_compiled->name() << ".";
+  param_compiled->clear_top_shape();
+  for (int i = 0; i < top_vecs_.size(); ++i) {
+    for (int j = 0; j < top_vecs_[i].size(); ++j) {
+      BlobShape* shape = param_compiled->add_top_shape();
+      for (int k = 0; k < top_vecs_[i][j]->num_axes(); ++k) {
+        shape->add_dim(top_vecs_[i][j]->shape(k));
+      }
+    }
+  }
 }
 
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
   NetState net_state(param.state());
+  // Copy the layers only once, moving the included ones to the front.
   param_filtered->CopyFrom(param);
-  param_filtered->clear_layer();
+  google::protobuf::RepeatedPtrField<LayerParameter>* layers =
+      param_filtered->mutable_layer();
+  int num_included = 0;
   for (int i = 0; i < param.layer_size(); ++i) {
     const LayerParameter& layer_param = param.layer(i);
     const string& layer_name = layer_param.name();
@@ -308,9 +491,10 @@ void Net<Dtype>::FilterNet(const NetParameter& param,
       }
     }
     if (layer_included) {
-      param_filtered->add_layer()->CopyFrom(layer_param);
+      layers->SwapElements(num_included++, i);
     }
   }
+  layers->DeleteSubrange(num_included, layers->size() - num_included);
 }
 
 template <typename Dtype>
@@ -319,7 +503,7 @@ bool Net<Dtype>::StateMeetsRule(const NetState& state,
   // Check whether the rule is broken due to phase.
   if (rule.has_phase()) {
       if (rule.phase() != state.phase()) {
-        LOG_IF(INFO, Caffe::root_solver())
+        LOG_IF(INFO, LogInit())
             << "The NetState phase (" << state.phase()
             << ") differed from the phase (" << rule.phase()
             << ") specified by a rule in layer " << layer_name;
@@ -329,7 +513,7 @@ bool Net<Dtype>::StateMeetsRule(const NetState& state,
   // Check whether the rule is broken due to min level.
   if (rule.has_min_level()) {
     if (state.level() < rule.min_level()) {
-      LOG_IF(INFO, Caffe::root_solver())
+      LOG_IF(INFO, LogInit())
           << "The NetState level (" << state.level()
           << ") is above the min_level (" << rule.min_level()
           << ") specified by a rule in layer " << layer_name;
@@ -339,7 +523,7 @@ bool Net<Dtype>::StateMeetsRule(const NetState& state,
   // Check whether the rule is broken due to max level.
   if (rule.has_max_level()) {
     if (state.level() > rule.max_level()) {
-      LOG_IF(INFO, Caffe::root_solver())
+      LOG_IF(INFO, LogInit())
           << "The NetState level (" << state.level()
           << ") is above the max_level (" << rule.max_level()
           << ") specified by a rule in layer " << layer_name;
@@ -355,7 +539,7 @@ bool Net<Dtype>::StateMeetsRule(const NetState& state,
       if (rule.stage(i) == state.stage(j)) { has_stage = true; }
     }
     if (!has_stage) {
-      LOG_IF(INFO, Caffe::root_solver())
+      LOG_IF(INFO, LogInit())
           << "The NetState did not contain stage '" << rule.stage(i)
           << "' specified by a rule in layer " << layer_name;
       return false;
@@ -370,7 +554,7 @@ bool Net<Dtype>::StateMeetsRule(const NetState& state,
       if (rule.not_stage(i) == state.stage(j)) { has_stage = true; }
     }
     if (has_stage) {
-      LOG_IF(INFO, Caffe::root_solver())
+      LOG_IF(INFO, LogInit())
           << "The NetState contained a not_stage '" << rule.not_stage(i)
           << "' specified by a rule in layer " << layer_name;
       return false;
@@ -382,18 +566,17 @@ bool Net<Dtype>::StateMeetsRule(const NetState& state,
 // Helper for Net::Init: add a new top blob to the net.
 template <typename Dtype>
 void Net<Dtype>::AppendTop(const NetParameter& param, const int layer_id,
-                           const int top_id, set<string>* available_blobs,
-                           map<string, int>* blob_name_to_idx) {
-  shared_ptr<LayerParameter> layer_param(
-      new LayerParameter(param.layer(layer_id)));
-  const string& blob_name = (layer_param->top_size() > top_id) ?
-      layer_param->top(top_id) : "(automatic)";
+    const int top_id, boost::unordered_set<string>* available_blobs,
+    boost::unordered_map<string, int>* blob_name_to_idx) {
+  const LayerParameter& layer_param = param.layer(layer_id);
+  const string& blob_name = (layer_param.top_size() > top_id) ?
+      layer_param.top(top_id) : "(automatic)";
   // Check if we are doing in-place computation
-  if (blob_name_to_idx && layer_param->bottom_size() > top_id &&
-      blob_name == layer_param->bottom(top_id)) {
+  if (blob_name_to_idx && layer_param.bottom_size() > top_id &&
+      blob_name == layer_param.bottom(top_id)) {
     // In-place computation
-    LOG_IF(INFO, Caffe::root_solver())
-        << layer_param->name() << " -> " << blob_name << " (in-place)";
+    LOG_IF(INFO, LogInit())
+        << layer_param.name() << " -> " << blob_name << " (in-place)";
     top_vecs_[layer_id].push_back(blobs_[(*blob_name_to_idx)[blob_name]].get());
     top_id_vecs_[layer_id].push_back((*blob_name_to_idx)[blob_name]);
   } else if (blob_name_to_idx &&
@@ -404,9 +587,7 @@ void Net<Dtype>::AppendTop(const NetParameter& param, const int layer_id,
                << "' produced by multiple sources.";
   } else {
     // Normal output.
-    if (Caffe::root_solver()) {
-      LOG(INFO) << layer_param->name() << " -> " << blob_name;
-    }
+    LOG_IF(INFO, LogInit()) << layer_param.name() << " -> " << blob_name;
     shared_ptr<Blob<Dtype> > blob_pointer(new Blob<Dtype>());
     const int blob_id = blobs_.size();
     blobs_.push_back(blob_pointer);
@@ -422,8 +603,8 @@ void Net<Dtype>::AppendTop(const NetParameter& param, const int layer_id,
 // Helper for Net::Init: add a new bottom blob to the net.
 template <typename Dtype>
 int Net<Dtype>::AppendBottom(const NetParameter& param, const int layer_id,
-    const int bottom_id, set<string>* available_blobs,
-    map<string, int>* blob_name_to_idx) {
+    const int bottom_id, boost::unordered_set<string>* available_blobs,
+    boost::unordered_map<string, int>* blob_name_to_idx) {
   const LayerParameter& layer_param = param.layer(layer_id);
   const string& blob_name = layer_param.bottom(bottom_id);
   if (available_blobs->find(blob_name) == available_blobs->end()) {
@@ -431,7 +612,7 @@ int Net<Dtype>::AppendBottom(const NetParameter& param, const int layer_id,
                << layer_param.name() << "', bottom index " << bottom_id << ")";
   }
   const int blob_id = (*blob_name_to_idx)[blob_name];
-  LOG_IF(INFO, Caffe::root_solver())
+  LOG_IF(INFO, LogInit())
       << layer_names_[layer_id] << " <- " << blob_name;
   bottom_vecs_[layer_id].push_back(blobs_[blob_id].get());
   bottom_id_vecs_[layer_id].push_back(blob_id);
@@ -490,7 +671,7 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
         param_layer_indices_[owner_net_param_id];
     const int owner_layer_id = owner_index.first;
     const int owner_param_id = owner_index.second;
-    LOG_IF(INFO, Caffe::root_solver()) << "Sharing parameters '" << param_name
+    LOG_IF(INFO, LogInit()) << "Sharing parameters '" << param_name
         << "' owned by "
         << "layer '" << layer_names_[owner_layer_id] << "', param "
         << "index " << owner_param_id;
@@ -544,16 +725,158 @@ template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
+  // Early exits follow the items of the batch from the first layer on.
+  const bool early_exit =
+      early_exit_ && start == 0 && !exit_layer_ids_.empty();
+  int next_exit = 0;
+  if (early_exit) {
+    item_exits_.clear();
+    exit_items_.clear();
+  }
   Dtype loss = 0;
   for (int i = start; i <= end; ++i) {
     // LOG(ERROR) << "Forwarding " << layer_names_[i];
+    ProfileScope profile(layer_names_[i].c_str(), "forward");
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
+    bool items_left = true;
+    while (early_exit && items_left && next_exit < exit_layer_ids_.size() &&
+           exit_layer_ids_[next_exit] == i) {
+      items_left = EarlyExit(next_exit++);
+    }
+    if (!items_left) {
+      break;
+    }
+  }
+  if (early_exit) {
+    FinishEarlyExits(end);
   }
   return loss;
 }
 
+template <typename Dtype>
+bool Net<Dtype>::EarlyExit(const int exit_id) {
+  const EarlyExitParameter& exit_param = exit_params_[exit_id];
+  const Blob<Dtype>& blob = *blobs_[exit_blob_ids_[exit_id]];
+  const int num = blob.shape(0);
+  if (item_exits_.empty()) {
+    // The first exit of a Forward sees the whole batch.
+    item_exits_.assign(num, -1);
+    exit_items_.resize(num);
+    for (int n = 0; n < num; ++n) {
+      exit_items_[n] = n;
+    }
+    exit_outputs_.ReshapeLike(blob);
+  }
+  CHECK_EQ(exit_items_.size(), num) << "Early exit " << exit_param.blob()
+      << " must have the items of the batch along its first axis.";
+  const int dim = blob.count(1);
+  CHECK_EQ(exit_outputs_.count(1), dim)
+      << "All early exits must have the same shape.";
+  const int channels = blob.num_axes() > 1 ? blob.shape(1) : 1;
+  const int spatial_dim = blob.num_axes() > 1 ? blob.count(2) : 1;
+  const Dtype* data = blob.cpu_data();
+  Dtype* outputs = exit_outputs_.mutable_cpu_data();
+  vector<int> kept;
+  for (int n = 0; n < num; ++n) {
+    const Dtype* item = data + n * dim;
+    Dtype confidence = 0;
+    for (int c = 0; c < channels; ++c) {
+      const Dtype peak = *std::max_element(item + c * spatial_dim,
+          item + (c + 1) * spatial_dim);
+      if (exit_param.reduction() == EarlyExitParameter_Reduction_MEAN) {
+        confidence += peak / channels;
+      } else {
+        confidence = c == 0 ? peak : std::min(confidence, peak);
+      }
+    }
+    if (confidence >= exit_param.threshold()) {
+      caffe_copy(dim, item, outputs + exit_items_[n] * dim);
+      item_exits_[exit_items_[n]] = exit_id;
+    } else {
+      kept.push_back(n);
+    }
+  }
+  if (kept.size() == num) {
+    return true;
+  }
+  vector<int> items(kept.size());
+  for (int k = 0; k < kept.size(); ++k) {
+    items[k] = exit_items_[kept[k]];
+  }
+  exit_items_.swap(items);
+  if (kept.empty()) {
+    return false;
+  }
+  // Move the items left to the front of the blobs that later layers read,
+  // once for blobs sharing their data, and shorten the batch.
+  for (int i = 0; i < exit_source_ids_.size(); ++i) {
+    if (!exit_source_saved_[i]) {
+      exit_source_copies_[i]->CopyFrom(*blobs_[exit_source_ids_[i]], false,
+                                       true);
+      exit_source_saved_[i] = true;
+    }
+  }
+  std::set<const Dtype*> moved;
+  const vector<int>& live_blob_ids = exit_live_blob_ids_[exit_id];
+  for (int i = 0; i < live_blob_ids.size(); ++i) {
+    Blob<Dtype>* live = blobs_[live_blob_ids[i]].get();
+    CHECK_EQ(num, live->shape(0)) << blob_names_[live_blob_ids[i]]
+        << " must have the items of the batch along its first axis to drop "
+        << "items at early exit " << exit_param.blob() << ".";
+    const int live_dim = live->count(1);
+    Dtype* live_data = Caffe::mode() == Caffe::CPU ?
+        live->mutable_cpu_data() : live->mutable_gpu_data();
+    if (moved.insert(live_data).second) {
+      for (int k = 0; k < kept.size(); ++k) {
+        if (kept[k] != k) {
+          caffe_copy(live_dim, live_data + kept[k] * live_dim,
+                     live_data + k * live_dim);
+        }
+      }
+    }
+    vector<int> shape = live->shape();
+    shape[0] = kept.size();
+    live->Reshape(shape);
+  }
+  return true;
+}
+
+template <typename Dtype>
+void Net<Dtype>::FinishEarlyExits(const int end) {
+  if (exit_items_.size() == item_exits_.size()) {
+    // No item exited.
+    return;
+  }
+  Blob<Dtype>* output = blobs_[exit_output_id_].get();
+  // Unless Forward stopped short of the output, the items left computed it.
+  if (exit_items_.empty() || end >= exit_output_layer_id_) {
+    const int dim = exit_outputs_.count(1);
+    if (!exit_items_.empty()) {
+      CHECK_EQ(exit_items_.size(), output->shape(0));
+      CHECK_EQ(dim, output->count(1)) << "Early exits must have the shape "
+          << "of " << blob_names_[exit_output_id_] << ".";
+      const Dtype* output_data = output->cpu_data();
+      Dtype* outputs = exit_outputs_.mutable_cpu_data();
+      for (int k = 0; k < exit_items_.size(); ++k) {
+        caffe_copy(dim, output_data + k * dim,
+                   outputs + exit_items_[k] * dim);
+      }
+    }
+    output->ReshapeLike(exit_outputs_);
+    caffe_copy(exit_outputs_.count(), exit_outputs_.cpu_data(),
+               output->mutable_cpu_data());
+  }
+  for (int i = 0; i < exit_source_ids_.size(); ++i) {
+    if (exit_source_saved_[i]) {
+      blobs_[exit_source_ids_[i]]->CopyFrom(*exit_source_copies_[i], false,
+                                            true);
+      exit_source_saved_[i] = false;
+    }
+  }
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardFrom(int start) {
   return ForwardFromTo(start, layers_.size() - 1);
@@ -592,6 +915,7 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_LT(start, layers_.size());
   for (int i = start; i >= end; --i) {
     if (layer_need_backward_[i]) {
+      ProfileScope profile(layer_names_[i].c_str(), "backward");
       layers_[i]->Backward(
           top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
       if (debug_info_) { BackwardDebugInfo(i); }
@@ -684,15 +1008,13 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
   for (int i = 0; i < num_source_layers; ++i) {
     Layer<Dtype>* source_layer = other->layers()[i].get();
     const string& source_layer_name = other->layer_names()[i];
-    int target_layer_id = 0;
-    while (target_layer_id != layer_names_.size() &&
-        layer_names_[target_layer_id] != source_layer_name) {
-      ++target_layer_id;
-    }
-    if (target_layer_id == layer_names_.size()) {
+    boost::unordered_map<string, int>::const_iterator target =
+        layer_names_index_.find(source_layer_name);
+    if (target == layer_names_index_.end()) {
       LOG(INFO) << "Ignoring source layer " << source_layer_name;
       continue;
     }
+    const int target_layer_id = target->second;
     DLOG(INFO) << "Copying source layer " << source_layer_name;
     vector<shared_ptr<Blob<Dtype> > >& target_blobs =
         layers_[target_layer_id]->blobs();
@@ -752,15 +1074,13 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
   for (int i = 0; i < num_source_layers; ++i) {
     const LayerParameter& source_layer = param.layer(i);
     const string& source_layer_name = source_layer.name();
-    int target_layer_id = 0;
-    while (target_layer_id != layer_names_.size() &&
-        layer_names_[target_layer_id] != source_layer_name) {
-      ++target_layer_id;
-    }
-    if (target_layer_id == layer_names_.size()) {
+    boost::unordered_map<string, int>::const_iterator target =
+        layer_names_index_.find(source_layer_name);
+    if (target == layer_names_index_.end()) {
       LOG(INFO) << "Ignoring source layer " << source_layer_name;
       continue;
     }
+    const int target_layer_id = target->second;
     DLOG(INFO) << "Copying source layer " << source_layer_name;
     vector<shared_ptr<Blob<Dtype> > >& target_blobs =
         layers_[target_layer_id]->blobs();
@@ -804,6 +1124,10 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
+#ifdef INFERENCE_ONLY
+  LOG(FATAL) << "Cannot read " << trained_filename << ": inference-only "
+      << "builds have no HDF5 support; use a binary proto.";
+#else
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
@@ -850,6 +1174,7 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
+#endif  // INFERENCE_ONLY
 }
 
 template <typename Dtype>
@@ -866,6 +1191,10 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
 
 template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
+#ifdef INFERENCE_ONLY
+  LOG(FATAL) << "Cannot write " << filename << ": inference-only builds "
+      << "have no HDF5 support.";
+#else
   hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
       H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -919,6 +1248,7 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
     H5Gclose(diff_hid);
   }
   H5Fclose(file_hid);
+#endif  // INFERENCE_ONLY
 }
 
 template <typename Dtype>
@@ -7,6 +7,7 @@
 #include "caffe/util/format.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/profiler.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -28,19 +29,26 @@ SolverAction::Enum Solver<Dtype>::GetRequestedAction() {
 template <typename Dtype>
 Solver<Dtype>::Solver(const SolverParameter& param, const Solver* root_solver)
     : net_(), callbacks_(), root_solver_(root_solver),
-      requested_early_exit_(false) {
+      requested_early_exit_(false), profiling_(false) {
   Init(param);
 }
 
 template <typename Dtype>
 Solver<Dtype>::Solver(const string& param_file, const Solver* root_solver)
     : net_(), callbacks_(), root_solver_(root_solver),
-      requested_early_exit_(false) {
+      requested_early_exit_(false), profiling_(false) {
   SolverParameter param;
   ReadSolverParamsFromTextFileOrDie(param_file, &param);
   Init(param);
 }
 
+template <typename Dtype>
+Solver<Dtype>::~Solver() {
+  if (profiling_) {
+    Profiler::Get().Disable();
+  }
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Init(const SolverParameter& param) {
   CHECK(Caffe::root_solver() || root_solver_)
@@ -53,6 +61,10 @@ void Solver<Dtype>::Init(const SolverParameter& param) {
   if (Caffe::root_solver() && param_.random_seed() >= 0) {
     Caffe::set_random_seed(param_.random_seed());
   }
+  if (Caffe::root_solver() && param_.profile_interval() > 0) {
+    Profiler::Get().Enable(param_.profile_buffer_size());
+    profiling_ = true;
+  }
   // Scaffolding code
   InitTrainNet();
   if (Caffe::root_solver()) {
@@ -199,6 +211,9 @@ void Solver<Dtype>::Step(int iters) {
   smoothed_loss_ = 0;
 
   while (iter_ < stop_iter) {
+    if (Caffe::root_solver()) {
+      Profiler::Get().set_iter(iter_);
+    }
     // zero-init the params
     net_->ClearParamDiffs();
     if (param_.test_interval() && iter_ % param_.test_interval() == 0
@@ -250,7 +265,10 @@ void Solver<Dtype>::Step(int iters) {
     for (int i = 0; i < callbacks_.size(); ++i) {
       callbacks_[i]->on_gradients_ready();
     }
-    ApplyUpdate();
+    {
+      ProfileScope profile("update", "solver");
+      ApplyUpdate();
+    }
 
     // Increment the internal iter_ counter -- its value should always indicate
     // the number of times the weights have been updated.
@@ -265,6 +283,9 @@ void Solver<Dtype>::Step(int iters) {
          (request == SolverAction::SNAPSHOT)) {
       Snapshot();
     }
+    if (profiling_ && iter_ % param_.profile_interval() == 0) {
+      Profiler::Get().ExportChromeTrace(ProfileFilename(""));
+    }
     if (SolverAction::STOP == request) {
       requested_early_exit_ = true;
       // Break out of training loop.
@@ -299,6 +320,7 @@ void Solver<Dtype>::Solve(const char* resume_file) {
   }
   if (requested_early_exit_) {
     LOG(INFO) << "Optimization stopped early.";
+    ExportFinalProfile();
     return;
   }
   // After the optimization is done, run an additional train and test pass to
@@ -319,6 +341,7 @@ void Solver<Dtype>::Solve(const char* resume_file) {
   if (param_.test_interval() && iter_ % param_.test_interval() == 0) {
     TestAll();
   }
+  ExportFinalProfile();
   LOG(INFO) << "Optimization Done.";
 }
 
@@ -334,6 +357,7 @@ void Solver<Dtype>::TestAll() {
 template <typename Dtype>
 void Solver<Dtype>::Test(const int test_net_id) {
   CHECK(Caffe::root_solver());
+  ProfileScope profile("test", "solver");
   LOG(INFO) << "Iteration " << iter_
             << ", Testing net (#" << test_net_id << ")";
   CHECK_NOTNULL(test_nets_[test_net_id].get())->
@@ -409,6 +433,7 @@ void Solver<Dtype>::Test(const int test_net_id) {
 template <typename Dtype>
 void Solver<Dtype>::Snapshot() {
   CHECK(Caffe::root_solver());
+  ProfileScope profile("snapshot", "solver");
   string model_filename;
   switch (param_.snapshot_format()) {
   case caffe::SolverParameter_SnapshotFormat_BINARYPROTO:
@@ -448,6 +473,25 @@ string Solver<Dtype>::SnapshotFilename(const string extension) {
     + extension;
 }
 
+template <typename Dtype>
+string Solver<Dtype>::ProfileFilename(const string& suffix) {
+  const string& prefix = param_.has_profile_prefix() ?
+      param_.profile_prefix() : param_.snapshot_prefix();
+  return prefix + "_iter_" + caffe::format_int(iter_) + suffix + ".trace.json";
+}
+
+template <typename Dtype>
+void Solver<Dtype>::ExportFinalProfile() {
+  // The iterations since the last profile_interval, the final snapshot and
+  // the final test pass go to a file of their own, so that a trace exported
+  // at this same iteration is not overwritten.
+  if (profiling_) {
+    Profiler::Get().ExportChromeTrace(ProfileFilename("_final"));
+    Profiler::Get().Disable();
+    profiling_ = false;
+  }
+}
+
 template <typename Dtype>
 string Solver<Dtype>::SnapshotToBinaryProto() {
   string model_filename = SnapshotFilename(".caffemodel");
@@ -0,0 +1,85 @@
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/affinity.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class AffinityTest : public ::testing::Test {};
+
+TEST_F(AffinityTest, TestParseCpuList) {
+  EXPECT_EQ(0, ParseCpuList("").size());
+  EXPECT_EQ(0, ParseCpuList(" \n").size());
+  const vector<int> cpus = ParseCpuList("8,0-3, 10-11,2\n");
+  const int expected[] = {0, 1, 2, 3, 8, 10, 11};
+  ASSERT_EQ(7, cpus.size());
+  for (int i = 0; i < cpus.size(); ++i) {
+    EXPECT_EQ(expected[i], cpus[i]);
+  }
+}
+
+TEST_F(AffinityTest, TestFormatCpuList) {
+  EXPECT_EQ("", FormatCpuList(vector<int>()));
+  EXPECT_EQ("0-3,8,10-11", FormatCpuList(ParseCpuList("0-3,8,10-11")));
+  EXPECT_EQ("5", FormatCpuList(ParseCpuList("5")));
+}
+
+TEST_F(AffinityTest, TestNumaNodeCpus) {
+  const vector<vector<int> > nodes = NumaNodeCpus();
+  ASSERT_GE(nodes.size(), 1);
+  for (int i = 0; i < nodes.size(); ++i) {
+    for (int j = 0; j < nodes[i].size(); ++j) {
+      EXPECT_GE(nodes[i][j], 0);
+    }
+  }
+}
+
+#ifdef __linux__
+TEST_F(AffinityTest, TestApply) {
+  cpu_set_t original;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(original), &original));
+  int allowed = -1;
+  for (int cpu = 0; cpu < CPU_SETSIZE && allowed < 0; ++cpu) {
+    if (CPU_ISSET(cpu, &original)) {
+      allowed = cpu;
+    }
+  }
+  ASSERT_GE(allowed, 0);
+  ThreadAffinity::set_cpus(ThreadAffinity::PREFETCH,
+      vector<int>(1, allowed));
+  ThreadAffinity::Apply(ThreadAffinity::PREFETCH);
+  cpu_set_t pinned;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(pinned), &pinned));
+  EXPECT_EQ(1, CPU_COUNT(&pinned));
+  EXPECT_TRUE(CPU_ISSET(allowed, &pinned));
+  ThreadAffinity::set_cpus(ThreadAffinity::PREFETCH, vector<int>());
+  ASSERT_EQ(0, sched_setaffinity(0, sizeof(original), &original));
+}
+
+TEST_F(AffinityTest, TestApplyUnrestricted) {
+  cpu_set_t original;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(original), &original));
+  const vector<int> allowed = GetCurrentThreadAffinity();
+  ASSERT_EQ(CPU_COUNT(&original), allowed.size());
+  // A thread started from the pinned compute thread inherits its CPUs;
+  // applying a role without CPUs gives it all of them back.
+  ThreadAffinity::set_cpus(ThreadAffinity::COMPUTE,
+      vector<int>(1, allowed[0]));
+  ThreadAffinity::Apply(ThreadAffinity::COMPUTE);
+  EXPECT_EQ(vector<int>(1, allowed[0]), GetCurrentThreadAffinity());
+  ThreadAffinity::Apply(ThreadAffinity::PREFETCH);
+  EXPECT_EQ(allowed, GetCurrentThreadAffinity());
+  ThreadAffinity::set_cpus(ThreadAffinity::COMPUTE, vector<int>());
+  ASSERT_EQ(0, sched_setaffinity(0, sizeof(original), &original));
+}
+#endif
+
+}  // namespace caffe
@@ -1,4 +1,5 @@
 #include <boost/thread.hpp>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -87,4 +88,17 @@ TYPED_TEST(BenchmarkTest, TestTimerSeconds) {
   EXPECT_TRUE(timer.has_run_at_least_once());
 }
 
+TEST(PercentileTest, TestNearestRank) {
+  EXPECT_EQ(0, Percentile(vector<double>(), 50));
+  const double values[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  const vector<double> sorted(values, values + 10);
+  EXPECT_EQ(5, Percentile(sorted, 50));
+  EXPECT_EQ(6, Percentile(sorted, 51));
+  EXPECT_EQ(9, Percentile(sorted, 90));
+  EXPECT_EQ(10, Percentile(sorted, 99));
+  EXPECT_EQ(10, Percentile(sorted, 100));
+  EXPECT_EQ(1, Percentile(sorted, 1));
+  EXPECT_EQ(7, Percentile(vector<double>(1, 7), 99));
+}
+
 }  // namespace caffe
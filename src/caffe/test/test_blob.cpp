@@ -59,6 +59,25 @@ TYPED_TEST(BlobSimpleTest, TestReshapeZero) {
   EXPECT_EQ(this->blob_->count(), 0);
 }
 
+TYPED_TEST(BlobSimpleTest, TestReshapeAfterShareData) {
+  Blob<TypeParam> small(1, 3, 4, 5);
+  this->blob_preshaped_->Reshape(1, 3, 4, 5);
+  this->blob_preshaped_->ShareData(small);
+  EXPECT_EQ(this->blob_preshaped_->cpu_data(), small.cpu_data());
+  // Growing back must not run past the 60 elements of the shared memory.
+  this->blob_preshaped_->Reshape(2, 3, 4, 5);
+  EXPECT_NE(this->blob_preshaped_->cpu_data(), small.cpu_data());
+}
+
+TYPED_TEST(BlobSimpleTest, TestReshapeAfterShareDiff) {
+  Blob<TypeParam> small(1, 3, 4, 5);
+  this->blob_preshaped_->Reshape(1, 3, 4, 5);
+  this->blob_preshaped_->ShareDiff(small);
+  EXPECT_EQ(this->blob_preshaped_->cpu_diff(), small.cpu_diff());
+  this->blob_preshaped_->Reshape(2, 3, 4, 5);
+  EXPECT_NE(this->blob_preshaped_->cpu_diff(), small.cpu_diff());
+}
+
 TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   BlobProto blob_proto;
 
@@ -0,0 +1,164 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/bucketed_inference.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class BucketedInferenceTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void SetUp() {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        "layer { "
+        "  name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 1 dim: 2 dim: 4 dim: 4 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 3 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' } "
+        "    bias_filler { type: 'constant' value: 0.5 } "
+        "  } "
+        "} "
+        "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } ",
+        &param));
+    session_.reset(new InferenceSession<Dtype>(param));
+    vector<int> shape(4);
+    shape[0] = 1;
+    shape[1] = 2;
+    shape[2] = 8;
+    shape[3] = 8;
+    bucket_shapes_.push_back(shape);
+    shape[2] = 16;
+    shape[3] = 16;
+    bucket_shapes_.push_back(shape);
+    shape[3] = 8;
+    bucket_shapes_.push_back(shape);
+  }
+
+  // Fills a blob of the given spatial size with gaussian noise.
+  void MakeInput(int height, int width, Blob<Dtype>* input) {
+    input->Reshape(1, 2, height, width);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(input);
+  }
+
+  shared_ptr<InferenceSession<Dtype> > session_;
+  vector<vector<int> > bucket_shapes_;
+};
+
+TYPED_TEST_CASE(BucketedInferenceTest, TestDtypesAndDevices);
+
+TYPED_TEST(BucketedInferenceTest, TestPadCopy) {
+  typedef typename TypeParam::Dtype Dtype;
+  Blob<Dtype> src(1, 2, 2, 3);
+  for (int i = 0; i < src.count(); ++i) {
+    src.mutable_cpu_data()[i] = i + 1;
+  }
+  Blob<Dtype> dst(2, 2, 3, 4);
+  PadCopy(src, Dtype(-1), &dst);
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 2; ++c) {
+      for (int h = 0; h < 3; ++h) {
+        for (int w = 0; w < 4; ++w) {
+          const Dtype expected = (n < 1 && h < 2 && w < 3) ?
+              src.data_at(n, c, h, w) : Dtype(-1);
+          EXPECT_EQ(expected, dst.data_at(n, c, h, w));
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(BucketedInferenceTest, TestFindBucket) {
+  typedef typename TypeParam::Dtype Dtype;
+  BucketedInference<Dtype> buckets(this->session_, this->bucket_shapes_);
+  vector<int> shape(this->bucket_shapes_[0]);
+  shape[2] = 5;
+  shape[3] = 7;
+  EXPECT_EQ(0, buckets.FindBucket(shape));
+  shape[2] = 12;
+  shape[3] = 8;
+  EXPECT_EQ(2, buckets.FindBucket(shape));
+  shape[3] = 9;
+  EXPECT_EQ(1, buckets.FindBucket(shape));
+  shape[2] = 17;
+  EXPECT_EQ(-1, buckets.FindBucket(shape));
+}
+
+TYPED_TEST(BucketedInferenceTest, TestMatchesPaddedInput) {
+  typedef typename TypeParam::Dtype Dtype;
+  BucketedInference<Dtype> buckets(this->session_, this->bucket_shapes_);
+  Blob<Dtype> input;
+  this->MakeInput(6, 5, &input);
+  int bucket;
+  const vector<Blob<Dtype>*>& outputs = buckets.Forward(input, &bucket);
+  EXPECT_EQ(0, bucket);
+  ASSERT_EQ(1, outputs.size());
+  EXPECT_EQ(8, outputs[0]->height());
+  EXPECT_EQ(8, outputs[0]->width());
+  // The reference: a net of the session run on the zero-padded input.
+  Net<Dtype> net(this->session_->param());
+  net.ShareTrainedLayersWith(&this->session_->weights());
+  net.input_blobs()[0]->Reshape(this->bucket_shapes_[0]);
+  net.Reshape();
+  PadCopy(input, Dtype(0), net.input_blobs()[0]);
+  const Blob<Dtype>* expected = net.Forward()[0];
+  ASSERT_EQ(expected->count(), outputs[0]->count());
+  for (int i = 0; i < expected->count(); ++i) {
+    EXPECT_NEAR(expected->cpu_data()[i], outputs[0]->cpu_data()[i], 1e-5);
+  }
+}
+
+TYPED_TEST(BucketedInferenceTest, TestSwitchingDoesNotReallocate) {
+  typedef typename TypeParam::Dtype Dtype;
+  BucketedInference<Dtype> buckets(this->session_, this->bucket_shapes_);
+  vector<const Dtype*> data(buckets.num_buckets());
+  for (int i = 0; i < buckets.num_buckets(); ++i) {
+    data[i] = buckets.bucket_net(i)->blob_by_name("conv")->cpu_data();
+  }
+  Blob<Dtype> small, large;
+  this->MakeInput(3, 7, &small);
+  this->MakeInput(15, 16, &large);
+  int bucket;
+  for (int iter = 0; iter < 3; ++iter) {
+    buckets.Forward(small, &bucket);
+    EXPECT_EQ(0, bucket);
+    buckets.Forward(large, &bucket);
+    EXPECT_EQ(1, bucket);
+  }
+  for (int i = 0; i < buckets.num_buckets(); ++i) {
+    EXPECT_EQ(data[i], buckets.bucket_net(i)->blob_by_name("conv")->cpu_data());
+    EXPECT_TRUE(buckets.bucket_net(i)->input_blobs()[0]->shape() ==
+        buckets.bucket_shape(i));
+  }
+}
+
+TYPED_TEST(BucketedInferenceTest, TestSpareContext) {
+  typedef typename TypeParam::Dtype Dtype;
+  BucketedInference<Dtype> buckets(this->session_, this->bucket_shapes_);
+  Blob<Dtype> input;
+  this->MakeInput(20, 4, &input);
+  int bucket;
+  const vector<Blob<Dtype>*>& outputs = buckets.Forward(input, &bucket);
+  EXPECT_EQ(-1, bucket);
+  EXPECT_EQ(20, outputs[0]->height());
+  EXPECT_EQ(4, outputs[0]->width());
+}
+
+}  // namespace caffe
@@ -0,0 +1,193 @@
+#include <stdint.h>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/cpu_isa.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class CpuIsaTest : public ::testing::Test {
+ protected:
+  // Odd, so that the kernels run their padded tails at every width.
+  static const int kCount = 1000 + 13;
+
+  CpuIsaTest()
+      : a_(kCount), b_(kCount), positive_(kCount), bytes_(kCount),
+        float_mean_(kCount), double_a_(kCount), double_b_(kCount),
+        double_positive_(kCount) {}
+
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    caffe_rng_gaussian<float>(kCount, 0, 20, &a_[0]);
+    caffe_rng_gaussian<float>(kCount, 0, 20, &b_[0]);
+    caffe_rng_uniform<float>(kCount, 0, 100, &positive_[0]);
+    caffe_rng_uniform<float>(kCount, 0, 255, &float_mean_[0]);
+    for (int i = 0; i < kCount; ++i) {
+      bytes_[i] = static_cast<uint8_t>(i * 7919);
+      double_a_[i] = a_[i];
+      double_b_[i] = b_[i];
+      double_positive_[i] = positive_[i];
+    }
+    // The special values of exp and log.
+    const float special[] = {0, -0.f, 1, -1, 88.7f, 89, -103, -110,
+        1e-40f, -1e-40f, std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::quiet_NaN()};
+    for (int i = 0; i < sizeof(special) / sizeof(special[0]); ++i) {
+      a_[i] = special[i];
+    }
+    original_level_ = CpuIsa::level();
+  }
+
+  virtual void TearDown() {
+    CpuIsa::set_level(original_level_);
+  }
+
+  // Whether y matches the result of the generic kernels to the bit, for
+  // arrays split into several chunks.
+  template <typename Dtype>
+  static void ExpectSame(const vector<Dtype>& expected,
+      const vector<Dtype>& y, CpuIsa::Level level, const char* kernel) {
+    ASSERT_EQ(expected.size(), y.size());
+    for (int i = 0; i < y.size(); ++i) {
+      EXPECT_EQ(0, memcmp(&expected[i], &y[i], sizeof(Dtype)))
+          << kernel << " at " << CpuIsa::Name(level) << ", element " << i
+          << ": " << y[i] << " instead of " << expected[i];
+    }
+  }
+
+  vector<float> a_, b_, positive_;
+  vector<uint8_t> bytes_;
+  vector<float> float_mean_;
+  vector<double> double_a_, double_b_, double_positive_;
+  CpuIsa::Level original_level_;
+};
+
+// Runs kernel on [0, kCount) in three uneven chunks.
+#define RUN_CHUNKS(call) \
+  do { \
+    int begin = 0, end = 0; \
+    end = 17; call; begin = end; \
+    end = 531; call; begin = end; \
+    end = kCount; call; \
+  } while (0)
+
+TEST_F(CpuIsaTest, TestNames) {
+  for (int i = 0; i < CpuIsa::NUM_LEVELS; ++i) {
+    const CpuIsa::Level level = static_cast<CpuIsa::Level>(i);
+    EXPECT_EQ(level, CpuIsa::FromName(CpuIsa::Name(level)));
+  }
+  EXPECT_EQ(CpuIsa::Detected(), CpuIsa::FromName("auto"));
+  EXPECT_TRUE(CpuIsa::Supported(CpuIsa::GENERIC));
+}
+
+TEST_F(CpuIsaTest, TestSetLevel) {
+  CpuIsa::set_level(CpuIsa::GENERIC);
+  EXPECT_EQ(CpuIsa::GENERIC, CpuIsa::level());
+  EXPECT_EQ(&CpuIsa::kernels(CpuIsa::GENERIC), &CpuIsa::kernels());
+  CpuIsa::set_level(CpuIsa::Detected());
+  EXPECT_EQ(&CpuIsa::kernels(CpuIsa::Detected()), &CpuIsa::kernels());
+}
+
+TEST_F(CpuIsaTest, TestFloatKernelsAgree) {
+  const CpuKernels& generic = CpuIsa::kernels(CpuIsa::GENERIC);
+  for (int i = 0; i < CpuIsa::NUM_LEVELS; ++i) {
+    const CpuIsa::Level level = static_cast<CpuIsa::Level>(i);
+    if (!CpuIsa::Supported(level)) {
+      continue;
+    }
+    const CpuKernels& kernels = CpuIsa::kernels(level);
+    vector<float> expected(kCount), y(kCount);
+#define EXPECT_BINARY(name) \
+    generic.name(&a_[0], &b_[0], &expected[0], 0, kCount); \
+    RUN_CHUNKS(kernels.name(&a_[0], &b_[0], &y[0], begin, end)); \
+    ExpectSame(expected, y, level, #name)
+    EXPECT_BINARY(vsAdd);
+    EXPECT_BINARY(vsSub);
+    EXPECT_BINARY(vsMul);
+    EXPECT_BINARY(vsDiv);
+#undef EXPECT_BINARY
+#define EXPECT_UNARY(name, x) \
+    generic.name(&x[0], &expected[0], 0, kCount); \
+    RUN_CHUNKS(kernels.name(&x[0], &y[0], begin, end)); \
+    ExpectSame(expected, y, level, #name)
+    EXPECT_UNARY(vsSqr, a_);
+    EXPECT_UNARY(vsAbs, a_);
+    EXPECT_UNARY(vsExp, a_);
+    EXPECT_UNARY(vsLn, a_);
+    EXPECT_UNARY(vsLn, positive_);
+#undef EXPECT_UNARY
+    const float exponents[] = {1, 2, 0.5, -0.5, -1, 0.75, -0.75};
+    for (int j = 0; j < sizeof(exponents) / sizeof(exponents[0]); ++j) {
+      ASSERT_TRUE(CpuKernels::PowxVectorized(exponents[j]));
+      generic.vsPowx(&positive_[0], exponents[j], &expected[0], 0, kCount);
+      RUN_CHUNKS(kernels.vsPowx(&positive_[0], exponents[j], &y[0], begin,
+                                end));
+      ExpectSame(expected, y, level, "vsPowx");
+    }
+    generic.NormalizeBytes(&bytes_[0], &float_mean_[0], 0, 0.25f,
+                           &expected[0], 0, kCount);
+    RUN_CHUNKS(kernels.NormalizeBytes(&bytes_[0], &float_mean_[0], 0, 0.25f,
+                                      &y[0], begin, end));
+    ExpectSame(expected, y, level, "NormalizeBytes");
+    generic.NormalizeBytes(&bytes_[0], NULL, 104, 0.5f, &expected[0], 0,
+                           kCount);
+    RUN_CHUNKS(kernels.NormalizeBytes(&bytes_[0], NULL, 104, 0.5f, &y[0],
+                                      begin, end));
+    ExpectSame(expected, y, level, "NormalizeBytes");
+  }
+}
+
+TEST_F(CpuIsaTest, TestDoubleKernelsAgree) {
+  const CpuKernels& generic = CpuIsa::kernels(CpuIsa::GENERIC);
+  for (int i = 0; i < CpuIsa::NUM_LEVELS; ++i) {
+    const CpuIsa::Level level = static_cast<CpuIsa::Level>(i);
+    if (!CpuIsa::Supported(level)) {
+      continue;
+    }
+    const CpuKernels& kernels = CpuIsa::kernels(level);
+    vector<double> expected(kCount), y(kCount);
+#define EXPECT_BINARY(name) \
+    generic.name(&double_a_[0], &double_b_[0], &expected[0], 0, kCount); \
+    RUN_CHUNKS(kernels.name(&double_a_[0], &double_b_[0], &y[0], begin, \
+                            end)); \
+    ExpectSame(expected, y, level, #name)
+    EXPECT_BINARY(vdAdd);
+    EXPECT_BINARY(vdSub);
+    EXPECT_BINARY(vdMul);
+    EXPECT_BINARY(vdDiv);
+#undef EXPECT_BINARY
+    generic.vdSqr(&double_a_[0], &expected[0], 0, kCount);
+    RUN_CHUNKS(kernels.vdSqr(&double_a_[0], &y[0], begin, end));
+    ExpectSame(expected, y, level, "vdSqr");
+    generic.vdAbs(&double_a_[0], &expected[0], 0, kCount);
+    RUN_CHUNKS(kernels.vdAbs(&double_a_[0], &y[0], begin, end));
+    ExpectSame(expected, y, level, "vdAbs");
+    generic.vdPowx(&double_positive_[0], 0.75, &expected[0], 0, kCount);
+    RUN_CHUNKS(kernels.vdPowx(&double_positive_[0], 0.75, &y[0], begin,
+                              end));
+    ExpectSame(expected, y, level, "vdPowx");
+  }
+}
+
+TEST_F(CpuIsaTest, TestNormalizeBytes) {
+  vector<float> y(kCount);
+  caffe_cpu_normalize_bytes<float>(kCount, &bytes_[0], &float_mean_[0], 0,
+                                   0.5f, &y[0]);
+  for (int i = 0; i < kCount; ++i) {
+    EXPECT_EQ((static_cast<float>(bytes_[i]) - float_mean_[i]) * 0.5f, y[i]);
+  }
+  caffe_cpu_normalize_bytes<float>(kCount, &bytes_[0], NULL, 128, 2, &y[0]);
+  for (int i = 0; i < kCount; ++i) {
+    EXPECT_EQ((static_cast<float>(bytes_[i]) - 128) * 2, y[i]);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,103 @@
+#include <string>
+
+#include "boost/scoped_ptr.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/data_benchmark.hpp"
+#include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/profiler.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+using boost::scoped_ptr;
+
+class DataBenchmarkTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    Caffe::set_mode(Caffe::CPU);
+    Profiler::Get().Enable(4096);
+  }
+  virtual void TearDown() { Profiler::Get().Disable(); }
+
+  // Fills a DB of the backend with 5 datums of 2x3x4 and returns a Data
+  // layer of batch size 2 reading it.
+  LayerParameter FillDataLayer(DataParameter_DB backend, Phase phase) {
+    string source;
+    MakeTempDir(&source);
+    source += "/db";
+    scoped_ptr<db::DB> db(db::GetDB(backend));
+    db->Open(source, db::NEW);
+    scoped_ptr<db::Transaction> txn(db->NewTransaction());
+    for (int i = 0; i < 5; ++i) {
+      Datum datum;
+      datum.set_label(i);
+      datum.set_channels(2);
+      datum.set_height(3);
+      datum.set_width(4);
+      datum.mutable_data()->assign(24, static_cast<char>(i));
+      string out;
+      CHECK(datum.SerializeToString(&out));
+      txn->Put(format_int(i), out);
+    }
+    txn->Commit();
+    db->Close();
+    LayerParameter param;
+    param.set_name("data");
+    param.set_type("Data");
+    param.set_phase(phase);
+    param.add_top("data");
+    param.add_top("label");
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(2);
+    data_param->set_source(source);
+    data_param->set_backend(backend);
+    return param;
+  }
+
+  void TestInstances(const LayerParameter& param, int num_instances) {
+    DataBenchmarkResult result =
+        BenchmarkDataLayer(param, num_instances, 2, 3);
+    EXPECT_EQ(3 * num_instances, result.batches);
+    EXPECT_EQ(3 * num_instances * 2, result.images);
+    EXPECT_GT(result.seconds, 0);
+  }
+};
+
+TEST_F(DataBenchmarkTest, TestDummyData) {
+  LayerParameter param;
+  param.set_name("data");
+  param.set_type("DummyData");
+  param.add_top("data");
+  DummyDataParameter* dummy_param = param.mutable_dummy_data_param();
+  BlobShape* shape = dummy_param->add_shape();
+  shape->add_dim(2);
+  shape->add_dim(3);
+  TestInstances(param, 1);
+  TestInstances(param, 2);
+}
+
+#ifdef USE_LEVELDB
+TEST_F(DataBenchmarkTest, TestDataLayerThreadsLevelDB) {
+  // Instances of the same Data layer would share a single reader, which only
+  // serves one layer in the TEST phase.
+  const LayerParameter param = FillDataLayer(DataParameter_DB_LEVELDB, TEST);
+  TestInstances(param, 2);
+  TestInstances(param, 3);
+}
+#endif  // USE_LEVELDB
+
+#ifdef USE_LMDB
+TEST_F(DataBenchmarkTest, TestDataLayerThreadsLMDB) {
+  const LayerParameter param = FillDataLayer(DataParameter_DB_LMDB, TEST);
+  TestInstances(param, 2);
+  TestInstances(param, 3);
+}
+#endif  // USE_LMDB
+
+}  // namespace caffe
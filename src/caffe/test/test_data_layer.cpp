@@ -105,6 +105,48 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  // Reads records holding only the pixels of an item, not Datums.
+  void TestReadRaw(DataParameter_DB backend) {
+    scoped_ptr<db::DB> db(db::GetDB(backend));
+    db->Open(*filename_, db::NEW);
+    scoped_ptr<db::Transaction> txn(db->NewTransaction());
+    for (int i = 0; i < 5; ++i) {
+      string pixels;
+      for (int j = 0; j < 24; ++j) {
+        pixels.push_back(static_cast<uint8_t>(i * 24 + j));
+      }
+      stringstream ss;
+      ss << i;
+      txn->Put(ss.str(), pixels);
+    }
+    txn->Commit();
+    db->Close();
+
+    LayerParameter param;
+    param.set_phase(TEST);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend);
+    BlobShape* raw_shape = data_param->mutable_raw_shape();
+    raw_shape->add_dim(2);
+    raw_shape->add_dim(3);
+    raw_shape->add_dim(4);
+    vector<Blob<Dtype>*> top(1, blob_top_data_);
+    DataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, top);
+    EXPECT_EQ(blob_top_data_->num(), 5);
+    EXPECT_EQ(blob_top_data_->channels(), 2);
+    EXPECT_EQ(blob_top_data_->height(), 3);
+    EXPECT_EQ(blob_top_data_->width(), 4);
+    for (int iter = 0; iter < 3; ++iter) {
+      layer.Forward(blob_bottom_vec_, top);
+      for (int i = 0; i < 5 * 24; ++i) {
+        EXPECT_EQ(i, blob_top_data_->cpu_data()[i]);
+      }
+    }
+  }
+
   void TestReshape(DataParameter_DB backend) {
     const int num_inputs = 5;
     // Save data of varying shapes.
@@ -360,6 +402,10 @@ TYPED_TEST(DataLayerTest, TestReshapeLevelDB) {
   this->TestReshape(DataParameter_DB_LEVELDB);
 }
 
+TYPED_TEST(DataLayerTest, TestReadRawLevelDB) {
+  this->TestReadRaw(DataParameter_DB_LEVELDB);
+}
+
 TYPED_TEST(DataLayerTest, TestReadCropTrainLevelDB) {
   const bool unique_pixels = true;  // all images the same; pixels different
   this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
@@ -400,6 +446,10 @@ TYPED_TEST(DataLayerTest, TestReshapeLMDB) {
   this->TestReshape(DataParameter_DB_LMDB);
 }
 
+TYPED_TEST(DataLayerTest, TestReadRawLMDB) {
+  this->TestReadRaw(DataParameter_DB_LMDB);
+}
+
 TYPED_TEST(DataLayerTest, TestReadCropTrainLMDB) {
   const bool unique_pixels = true;  // all images the same; pixels different
   this->Fill(unique_pixels, DataParameter_DB_LMDB);
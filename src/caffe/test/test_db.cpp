@@ -93,6 +93,34 @@ TYPED_TEST(DBTest, TestSeekToFirst) {
   EXPECT_EQ(datum.width(), 480);
 }
 
+TYPED_TEST(DBTest, TestParseValue) {
+  scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
+  db->Open(this->source_, db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  for (int i = 0; i < 2; ++i) {
+    Datum expected, datum;
+    expected.ParseFromString(cursor->value());
+    // Parsing into a used datum must leave nothing of the previous record.
+    datum.set_label(-1);
+    datum.set_data(string(1000000, 'x'));
+    EXPECT_TRUE(cursor->ParseValue(&datum));
+    EXPECT_EQ(expected.SerializeAsString(), datum.SerializeAsString());
+    cursor->Next();
+  }
+}
+
+TYPED_TEST(DBTest, TestReadValue) {
+  scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
+  db->Open(this->source_, db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  string value(1000000, 'x');
+  for (int i = 0; i < 2; ++i) {
+    cursor->ReadValue(&value);
+    EXPECT_EQ(cursor->value(), value);
+    cursor->Next();
+  }
+}
+
 TYPED_TEST(DBTest, TestKeyValue) {
   scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
   db->Open(this->source_, db::READ);
@@ -154,6 +154,83 @@ TYPED_TEST(DeconvolutionLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(DeconvolutionLayerTest, TestSubPixelAgainstCol2im) {
+  typedef typename TypeParam::Dtype Dtype;
+  // input height, width, kernel h, w, stride h, w, pad h, w, group,
+  // num_output, and whether the weights are bilinear.
+  const int configs[][11] = {
+    {6, 5, 4, 4, 2, 2, 1, 1, 1, 6, 0},
+    {6, 5, 2, 2, 2, 2, 0, 0, 1, 6, 0},
+    {6, 5, 6, 6, 3, 3, 1, 1, 2, 6, 0},
+    {6, 5, 4, 4, 2, 2, 1, 1, 4, 4, 1},
+    {6, 5, 4, 3, 2, 3, 0, 2, 1, 3, 0},
+    // pads larger than the input: some taps see no input column at all
+    {3, 1, 16, 16, 2, 2, 7, 7, 1, 2, 0},
+  };
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < sizeof(configs) / sizeof(configs[0]); ++i) {
+    vector<int> bottom_shape(4);
+    bottom_shape[0] = 2;
+    bottom_shape[1] = 4;
+    bottom_shape[2] = configs[i][0];
+    bottom_shape[3] = configs[i][1];
+    this->blob_bottom_->Reshape(bottom_shape);
+    filler.Fill(this->blob_bottom_);
+    const int* config = configs[i] + 2;
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->set_kernel_h(config[0]);
+    convolution_param->set_kernel_w(config[1]);
+    convolution_param->set_stride_h(config[2]);
+    convolution_param->set_stride_w(config[3]);
+    convolution_param->set_pad_h(config[4]);
+    convolution_param->set_pad_w(config[5]);
+    convolution_param->set_group(config[6]);
+    convolution_param->set_num_output(config[7]);
+    convolution_param->set_bias_term(!config[8]);
+    convolution_param->mutable_weight_filler()->set_type(
+        config[8] ? "bilinear" : "gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    DeconvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> sub_pixel;
+    sub_pixel.CopyFrom(*this->blob_top_, false, true);
+    // The same weights through backward gemm and col2im.
+    convolution_param->set_force_nd_im2col(true);
+    DeconvolutionLayer<Dtype> layer_col2im(layer_param);
+    layer_col2im.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int j = 0; j < layer.blobs().size(); ++j) {
+      layer_col2im.blobs()[j]->CopyFrom(*layer.blobs()[j]);
+    }
+    layer_col2im.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_EQ(this->blob_top_->shape(), sub_pixel.shape());
+    for (int j = 0; j < sub_pixel.count(); ++j) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[j], sub_pixel.cpu_data()[j],
+                  1e-4) << "config " << i << ", element " << j;
+    }
+  }
+}
+
+TYPED_TEST(DeconvolutionLayerTest, TestGradientSubPixel) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(4);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(1);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  DeconvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 TYPED_TEST(DeconvolutionLayerTest, TestNDAgainst2D) {
   typedef typename TypeParam::Dtype Dtype;
   const int kernel_h = 11;
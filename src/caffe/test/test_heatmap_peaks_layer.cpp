@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/heatmap_peaks_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class HeatmapPeaksLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  HeatmapPeaksLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 7, 9)),
+        blob_top_(new Blob<Dtype>()),
+        blob_top_count_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    UniformFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    blob_top_vec_.push_back(blob_top_count_);
+  }
+  virtual ~HeatmapPeaksLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+    delete blob_top_count_;
+  }
+
+  // Checks the layer against finding the peaks pixel by pixel.
+  void TestAgainstBruteForce(int kernel_size, Dtype threshold, int top_k) {
+    LayerParameter layer_param;
+    HeatmapPeaksParameter* peaks_param =
+        layer_param.mutable_heatmap_peaks_param();
+    peaks_param->set_kernel_size(kernel_size);
+    peaks_param->set_threshold(threshold);
+    peaks_param->set_top_k(top_k);
+    HeatmapPeaksLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    const int height = blob_bottom_->height();
+    const int width = blob_bottom_->width();
+    const int radius = kernel_size / 2;
+    for (int n = 0; n < blob_bottom_->num(); ++n) {
+      for (int c = 0; c < blob_bottom_->channels(); ++c) {
+        vector<std::pair<Dtype, int> > peaks;
+        for (int h = 0; h < height; ++h) {
+          for (int w = 0; w < width; ++w) {
+            const Dtype value = blob_bottom_->data_at(n, c, h, w);
+            bool peak = value >= threshold;
+            for (int i = std::max(h - radius, 0);
+                 i < std::min(h + radius + 1, height); ++i) {
+              for (int j = std::max(w - radius, 0);
+                   j < std::min(w + radius + 1, width); ++j) {
+                peak = peak && value >= blob_bottom_->data_at(n, c, i, j);
+              }
+            }
+            if (peak) {
+              // Sorting by (-value, index) orders as the layer does.
+              peaks.push_back(std::make_pair(-value, h * width + w));
+            }
+          }
+        }
+        std::sort(peaks.begin(), peaks.end());
+        const int num_peaks = std::min(static_cast<int>(peaks.size()), top_k);
+        EXPECT_EQ(num_peaks, blob_top_count_->cpu_data()[
+            n * blob_bottom_->channels() + c]);
+        for (int k = 0; k < top_k; ++k) {
+          if (k < num_peaks) {
+            EXPECT_EQ(peaks[k].second % width, blob_top_->data_at(n, c, k, 0));
+            EXPECT_EQ(peaks[k].second / width, blob_top_->data_at(n, c, k, 1));
+            EXPECT_EQ(-peaks[k].first, blob_top_->data_at(n, c, k, 2));
+          } else {
+            EXPECT_EQ(-1, blob_top_->data_at(n, c, k, 0));
+            EXPECT_EQ(-1, blob_top_->data_at(n, c, k, 1));
+            EXPECT_EQ(0, blob_top_->data_at(n, c, k, 2));
+          }
+        }
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const blob_top_count_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(HeatmapPeaksLayerTest, TestDtypes);
+
+TYPED_TEST(HeatmapPeaksLayerTest, TestSetup) {
+  LayerParameter layer_param;
+  layer_param.mutable_heatmap_peaks_param()->set_top_k(5);
+  HeatmapPeaksLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(2, this->blob_top_->num());
+  EXPECT_EQ(3, this->blob_top_->channels());
+  EXPECT_EQ(5, this->blob_top_->height());
+  EXPECT_EQ(3, this->blob_top_->width());
+  EXPECT_EQ(2, this->blob_top_count_->num_axes());
+  EXPECT_EQ(2, this->blob_top_count_->shape(0));
+  EXPECT_EQ(3, this->blob_top_count_->shape(1));
+}
+
+TYPED_TEST(HeatmapPeaksLayerTest, TestForward) {
+  // Two people on a 4 x 5 heatmap, one near a corner.
+  const TypeParam heatmap[] = {
+    0.9, 0.2, 0.0, 0.0, 0.0,
+    0.3, 0.1, 0.0, 0.4, 0.0,
+    0.0, 0.0, 0.0, 0.3, 0.0,
+    0.0, 0.05, 0.0, 0.0, 0.0,
+  };
+  this->blob_bottom_->Reshape(1, 1, 4, 5);
+  std::copy(heatmap, heatmap + 20, this->blob_bottom_->mutable_cpu_data());
+  LayerParameter layer_param;
+  layer_param.mutable_heatmap_peaks_param()->set_top_k(3);
+  HeatmapPeaksLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The 0.05 peak is below the threshold.
+  const TypeParam expected[] = {
+    0, 0, 0.9,
+    3, 1, 0.4,
+    -1, -1, 0,
+  };
+  for (int i = 0; i < 9; ++i) {
+    EXPECT_EQ(expected[i], this->blob_top_->cpu_data()[i]) << i;
+  }
+  EXPECT_EQ(2, this->blob_top_count_->cpu_data()[0]);
+}
+
+TYPED_TEST(HeatmapPeaksLayerTest, TestForwardBruteForce) {
+  this->TestAgainstBruteForce(3, 0.1, 20);
+}
+
+TYPED_TEST(HeatmapPeaksLayerTest, TestForwardTopK) {
+  this->TestAgainstBruteForce(3, 0, 2);
+}
+
+TYPED_TEST(HeatmapPeaksLayerTest, TestForwardKernelSize) {
+  this->TestAgainstBruteForce(1, 0.5, 100);
+  this->TestAgainstBruteForce(5, 0.1, 4);
+  this->TestAgainstBruteForce(11, 0.1, 4);
+}
+
+TYPED_TEST(HeatmapPeaksLayerTest, TestForwardPlateau) {
+  // Every pixel of a plateau is the maximum of its window.
+  this->blob_bottom_->Reshape(1, 1, 2, 3);
+  caffe_set(6, TypeParam(0.5), this->blob_bottom_->mutable_cpu_data());
+  this->TestAgainstBruteForce(3, 0.1, 20);
+  EXPECT_EQ(6, this->blob_top_count_->cpu_data()[0]);
+}
+
+}  // namespace caffe
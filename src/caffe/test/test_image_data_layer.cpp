@@ -97,6 +97,26 @@ TYPED_TEST(ImageDataLayerTest, TestRead) {
   }
 }
 
+TYPED_TEST(ImageDataLayerTest, TestReadInOrderWithDecodeThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  ImageDataParameter* image_data_param = param.mutable_image_data_param();
+  image_data_param->set_batch_size(3);
+  image_data_param->set_source(this->filename_.c_str());
+  image_data_param->set_shuffle(false);
+  image_data_param->set_decode_threads(4);
+  image_data_param->set_decode_ahead(2);
+  ImageDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Batches straddle the end of the list; the labels keep the list order.
+  for (int iter = 0; iter < 5; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_EQ((iter * 3 + i) % 5, this->blob_top_label_->cpu_data()[i]);
+    }
+  }
+}
+
 TYPED_TEST(ImageDataLayerTest, TestResize) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter param;
@@ -0,0 +1,156 @@
+#include <boost/thread.hpp>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/inference_session.hpp"
+#include "caffe/net.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class InferenceSessionTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  InferenceSessionTest() : num_inputs_(4) {}
+
+  virtual void SetUp() {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(NetProto(), &param));
+    session_.reset(new InferenceSession<Dtype>(param));
+  }
+
+  // A net exercising layers with scratch buffers (im2col, pooling masks)
+  // and with non-learnable parameters (the BatchNorm statistics).
+  string NetProto() {
+    return
+        "name: 'InferenceNet' "
+        "layer { "
+        "  name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 8 dim: 8 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'constant' value: 0.1 } "
+        "  } "
+        "} "
+        "layer { name: 'bn' type: 'BatchNorm' bottom: 'conv' top: 'conv' } "
+        "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } "
+        "layer { "
+        "  name: 'pool' type: 'Pooling' bottom: 'conv' top: 'pool' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "} "
+        "layer { "
+        "  name: 'ip' type: 'InnerProduct' bottom: 'pool' top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { name: 'prob' type: 'Softmax' bottom: 'ip' top: 'prob' } ";
+  }
+
+  // Fills the input of net with the pattern of the given index.
+  void FillInput(int index, Net<Dtype>* net) {
+    Blob<Dtype>* input = net->input_blobs()[0];
+    Dtype* data = input->mutable_cpu_data();
+    for (int i = 0; i < input->count(); ++i) {
+      data[i] = static_cast<Dtype>((i * (index + 3)) % 17) / 17 - 0.5;
+    }
+  }
+
+  // Computes the output for each input pattern with a single context.
+  void ComputeExpected() {
+    shared_ptr<InferenceContext<Dtype> > context = session_->CreateContext();
+    expected_.resize(num_inputs_);
+    for (int i = 0; i < num_inputs_; ++i) {
+      FillInput(i, context->net());
+      const Blob<Dtype>* output = context->Forward()[0];
+      expected_[i].assign(output->cpu_data(),
+          output->cpu_data() + output->count());
+    }
+  }
+
+ public:
+  // Runs a context of its own on rotating inputs, counting wrong outputs.
+  void RunContext(int thread, int iterations, int* mismatches) {
+    shared_ptr<InferenceContext<Dtype> > context = session_->CreateContext();
+    for (int iter = 0; iter < iterations; ++iter) {
+      const int index = (thread + iter) % num_inputs_;
+      FillInput(index, context->net());
+      const Blob<Dtype>* output = context->Forward()[0];
+      for (int i = 0; i < output->count(); ++i) {
+        if (std::abs(output->cpu_data()[i] - expected_[index][i]) > 1e-5) {
+          ++*mismatches;
+          break;
+        }
+      }
+    }
+  }
+
+ protected:
+  const int num_inputs_;
+  shared_ptr<InferenceSession<Dtype> > session_;
+  vector<vector<Dtype> > expected_;
+};
+
+TYPED_TEST_CASE(InferenceSessionTest, TestDtypesAndDevices);
+
+TYPED_TEST(InferenceSessionTest, TestSharesWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  shared_ptr<InferenceContext<Dtype> > first = this->session_->CreateContext();
+  shared_ptr<InferenceContext<Dtype> > second =
+      this->session_->CreateContext();
+  const vector<shared_ptr<Blob<Dtype> > >& params =
+      this->session_->weights().params();
+  ASSERT_EQ(params.size(), first->net()->params().size());
+  for (int i = 0; i < params.size(); ++i) {
+    EXPECT_EQ(params[i]->cpu_data(), first->net()->params()[i]->cpu_data());
+    EXPECT_EQ(params[i]->cpu_data(), second->net()->params()[i]->cpu_data());
+  }
+  // The activations are per context.
+  EXPECT_NE(first->net()->blob_by_name("conv")->mutable_cpu_data(),
+      second->net()->blob_by_name("conv")->mutable_cpu_data());
+}
+
+TYPED_TEST(InferenceSessionTest, TestContextMatchesNet) {
+  typedef typename TypeParam::Dtype Dtype;
+  Net<Dtype> net(this->session_->param());
+  net.ShareTrainedLayersWith(&this->session_->weights());
+  this->FillInput(1, &net);
+  const Blob<Dtype>* net_output = net.Forward()[0];
+  this->ComputeExpected();
+  ASSERT_EQ(net_output->count(), this->expected_[1].size());
+  for (int i = 0; i < net_output->count(); ++i) {
+    EXPECT_EQ(net_output->cpu_data()[i], this->expected_[1][i]);
+  }
+}
+
+TYPED_TEST(InferenceSessionTest, TestConcurrentForward) {
+  this->ComputeExpected();
+  const int num_threads = 8;
+  const int iterations = 50;
+  vector<int> mismatches(num_threads, 0);
+  vector<shared_ptr<boost::thread> > threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.push_back(shared_ptr<boost::thread>(new boost::thread(
+        &InferenceSessionTest<TypeParam>::RunContext, this, i, iterations,
+        &mismatches[i])));
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    threads[i]->join();
+    EXPECT_EQ(0, mismatches[i]) << "thread " << i;
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,143 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/keypoint_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+using boost::scoped_ptr;
+
+template <typename TypeParam>
+class KeypointDataLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  KeypointDataLayerTest()
+      : blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+  }
+  virtual ~KeypointDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  // A 1 x 8 x 6 image of value i with keypoints (i, 2) and (5, 7), the
+  // latter not visible if i is odd.
+  void MakeDatum(int i, Datum* datum) {
+    datum->set_channels(1);
+    datum->set_height(8);
+    datum->set_width(6);
+    datum->set_data(std::string(48, static_cast<char>(i)));
+    datum->add_keypoint(i);
+    datum->add_keypoint(2);
+    datum->add_keypoint(5);
+    datum->add_keypoint(7);
+    datum->add_keypoint_visible(true);
+    datum->add_keypoint_visible(i % 2 == 0);
+  }
+
+  // The heatmap value at (h, w) of a keypoint at (x, y), as
+  // HeatmapDataLayer renders it.
+  Dtype Gaussian(float x, float y, int h, int w, float sigma) {
+    return 4 / (sigma * std::sqrt(2 * M_PI)) *
+        std::exp(-0.5 * ((h - y) * (h - y) + (w - x) * (w - x)) /
+                 (sigma * sigma));
+  }
+
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(KeypointDataLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(KeypointDataLayerTest, TestRenderHeatmaps) {
+  typedef typename TypeParam::Dtype Dtype;
+  Datum datum;
+  this->MakeDatum(1, &datum);
+  // Heatmaps at half the size of the image.
+  Blob<Dtype> heatmaps(1, 2, 4, 3);
+  caffe_set(heatmaps.count(), Dtype(-1), heatmaps.mutable_cpu_data());
+  RenderKeypointHeatmaps(datum, 8, 6, 4, 3, 1.5, heatmaps.mutable_cpu_data());
+  for (int h = 0; h < 4; ++h) {
+    for (int w = 0; w < 3; ++w) {
+      EXPECT_NEAR(this->Gaussian(0.5, 1, h, w, 1.5),
+          heatmaps.data_at(0, 0, h, w), 1e-5);
+      // Not visible.
+      EXPECT_EQ(0, heatmaps.data_at(0, 1, h, w));
+    }
+  }
+  // Without visibility flags, all keypoints are visible.
+  datum.clear_keypoint_visible();
+  RenderKeypointHeatmaps(datum, 8, 6, 4, 3, 1.5, heatmaps.mutable_cpu_data());
+  EXPECT_NEAR(this->Gaussian(2.5, 3.5, 3, 2, 1.5),
+      heatmaps.data_at(0, 1, 3, 2), 1e-5);
+}
+
+#ifdef USE_LMDB
+TYPED_TEST(KeypointDataLayerTest, TestRead) {
+  typedef typename TypeParam::Dtype Dtype;
+  string filename;
+  MakeTempDir(&filename);
+  filename += "/db";
+  scoped_ptr<db::DB> db(db::GetDB(DataParameter_DB_LMDB));
+  db->Open(filename, db::NEW);
+  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+  for (int i = 0; i < 4; ++i) {
+    Datum datum;
+    this->MakeDatum(i, &datum);
+    string out;
+    CHECK(datum.SerializeToString(&out));
+    txn->Put(format_int(i), out);
+  }
+  txn->Commit();
+  db->Close();
+
+  LayerParameter param;
+  param.set_phase(TRAIN);
+  DataParameter* data_param = param.mutable_data_param();
+  data_param->set_batch_size(4);
+  data_param->set_source(filename);
+  data_param->set_backend(DataParameter_DB_LMDB);
+  HeatmapDataParameter* heatmap_param = param.mutable_heatmap_data_param();
+  heatmap_param->set_label_height(8);
+  heatmap_param->set_label_width(6);
+  KeypointDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(4, this->blob_top_data_->num());
+  EXPECT_EQ(1, this->blob_top_data_->channels());
+  EXPECT_EQ(8, this->blob_top_data_->height());
+  EXPECT_EQ(6, this->blob_top_data_->width());
+  EXPECT_EQ(4, this->blob_top_label_->num());
+  EXPECT_EQ(2, this->blob_top_label_->channels());
+  EXPECT_EQ(8, this->blob_top_label_->height());
+  EXPECT_EQ(6, this->blob_top_label_->width());
+  for (int iter = 0; iter < 3; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(i, this->blob_top_data_->data_at(i, 0, 5, 3));
+      EXPECT_NEAR(this->Gaussian(i, 2, 2, i, 1.5),
+          this->blob_top_label_->data_at(i, 0, 2, i), 1e-5);
+      EXPECT_NEAR(i % 2 == 0 ? this->Gaussian(5, 7, 7, 5, 1.5) : 0,
+          this->blob_top_label_->data_at(i, 1, 7, 5), 1e-5);
+    }
+  }
+}
+#endif  // USE_LMDB
+
+}  // namespace caffe
@@ -1,6 +1,7 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
 #include <cmath>  // for std::fabs
+#include <limits>
 
 #include "gtest/gtest.h"
 
@@ -119,6 +120,96 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestExp) {
+  const int n = this->blob_bottom_->count();
+  TypeParam* x = this->blob_bottom_->mutable_cpu_data();
+  // Spread the inputs over the range where exp is a normal float.
+  for (int i = 0; i < n; ++i) {
+    x[i] *= 15;
+  }
+  caffe_exp<TypeParam>(n, x, this->blob_bottom_->mutable_cpu_diff());
+  const TypeParam* y = this->blob_bottom_->cpu_diff();
+  for (int i = 0; i < n; ++i) {
+    const TypeParam expected = std::exp(x[i]);
+    EXPECT_NEAR(y[i], expected, 2e-7 * expected);
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestExpSpecialValues) {
+  const TypeParam inf = std::numeric_limits<TypeParam>::infinity();
+  const TypeParam x[5] = {-inf, inf, 0, -1000, 1000};
+  TypeParam y[5];
+  caffe_exp<TypeParam>(5, x, y);
+  EXPECT_EQ(0, y[0]);
+  EXPECT_EQ(inf, y[1]);
+  EXPECT_EQ(1, y[2]);
+  EXPECT_EQ(0, y[3]);
+  EXPECT_EQ(inf, y[4]);
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestLog) {
+  const int n = this->blob_bottom_->count();
+  TypeParam* x = this->blob_bottom_->mutable_cpu_data();
+  // Spread the inputs over many orders of magnitude, denormals included.
+  for (int i = 0; i < n; ++i) {
+    x[i] = std::exp(std::fabs(x[i]) * 30 - 100);
+  }
+  caffe_log<TypeParam>(n, x, this->blob_bottom_->mutable_cpu_diff());
+  const TypeParam* y = this->blob_bottom_->cpu_diff();
+  for (int i = 0; i < n; ++i) {
+    const TypeParam expected = std::log(x[i]);
+    EXPECT_NEAR(y[i], expected, 2e-7 * std::fabs(expected) + 1e-7);
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestLogSpecialValues) {
+  const TypeParam inf = std::numeric_limits<TypeParam>::infinity();
+  const TypeParam x[4] = {0, inf, 1, -1};
+  TypeParam y[4];
+  caffe_log<TypeParam>(4, x, y);
+  EXPECT_EQ(-inf, y[0]);
+  EXPECT_EQ(inf, y[1]);
+  EXPECT_EQ(0, y[2]);
+  EXPECT_TRUE(std::isnan(y[3]));
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestPowx) {
+  const int n = this->blob_bottom_->count();
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  TypeParam* a = this->blob_top_->mutable_cpu_data();
+  for (int i = 0; i < n; ++i) {
+    a[i] = std::fabs(x[i]) + 0.5;
+  }
+  // The exponents with a vectorized path, and one without.
+  const float exponents[] = {1, 2, 0.5, -0.5, -1, 0.75, -0.75, 1.5};
+  TypeParam* y = this->blob_top_->mutable_cpu_diff();
+  for (int j = 0; j < sizeof(exponents) / sizeof(exponents[0]); ++j) {
+    caffe_powx<TypeParam>(n, a, exponents[j], y);
+    for (int i = 0; i < n; ++i) {
+      const TypeParam expected = std::pow(a[i], TypeParam(exponents[j]));
+      EXPECT_NEAR(y[i], expected, 4e-7 * expected);
+    }
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestThreadsAgree) {
+  const int n = this->blob_bottom_->count();
+  const TypeParam* a = this->blob_bottom_->cpu_data();
+  const TypeParam* b = this->blob_top_->cpu_data();
+  Blob<TypeParam> expected(this->blob_bottom_->shape());
+  Blob<TypeParam> threaded(this->blob_bottom_->shape());
+  caffe_add<TypeParam>(n, a, b, expected.mutable_cpu_data());
+  caffe_exp<TypeParam>(n, a, expected.mutable_cpu_diff());
+  caffe_set_cpu_math_threads(3);
+  caffe_add<TypeParam>(n, a, b, threaded.mutable_cpu_data());
+  caffe_exp<TypeParam>(n, a, threaded.mutable_cpu_diff());
+  caffe_set_cpu_math_threads(1);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], threaded.cpu_data()[i]);
+    EXPECT_EQ(expected.cpu_diff()[i], threaded.cpu_diff()[i]);
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
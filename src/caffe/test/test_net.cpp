@@ -839,6 +839,70 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoFileWithState(proto, phase, level, stages);
   }
 
+  // A two-stage net whose first stage can exit early: stage1 copies the
+  // input, and stage2 doubles it.
+  virtual void InitEarlyExitNet(const string& early_exit) {
+    const string& proto =
+        "name: 'EarlyExitNet' " + early_exit +
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { "
+        "    shape { dim: 4 dim: 2 dim: 3 dim: 3 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'stage1' "
+        "  type: 'Power' "
+        "  bottom: 'data' "
+        "  top: 'stage1' "
+        "} "
+        "layer { "
+        "  name: 'stage2' "
+        "  type: 'Eltwise' "
+        "  bottom: 'data' "
+        "  bottom: 'stage1' "
+        "  top: 'stage2' "
+        "} ";
+    InitNetFromProtoString(proto);
+    // Values in [0, 0.4], with channel peaks of 0.9 for the items in
+    // confident, and else 0.9 in the first channel and 0.4 in the second.
+    Blob<Dtype>* data = net_->input_blobs()[0];
+    FillerParameter filler_param;
+    filler_param.set_min(0);
+    filler_param.set_max(0.4);
+    UniformFiller<Dtype> filler(filler_param);
+    filler.Fill(data);
+  }
+
+  void SetPeaks(const bool* confident) {
+    Blob<Dtype>* data = net_->input_blobs()[0];
+    for (int n = 0; n < data->num(); ++n) {
+      data->mutable_cpu_data()[data->offset(n, 0, 1, 2)] = 0.9;
+      data->mutable_cpu_data()[data->offset(n, 1, 2, 0)] =
+          confident[n] ? 0.9 : 0.4;
+    }
+  }
+
+  // Checks the output of each item against the input, which stage1 copies
+  // and stage2 doubles.
+  void CheckEarlyExitOutput(const int* expected_exits) {
+    const Blob<Dtype>* data = net_->input_blobs()[0];
+    const Blob<Dtype>* output = net_->output_blobs()[0];
+    ASSERT_EQ(data->shape(), output->shape());
+    ASSERT_EQ(data->num(), net_->item_exits().size());
+    const int dim = data->count(1);
+    for (int n = 0; n < data->num(); ++n) {
+      EXPECT_EQ(expected_exits[n], net_->item_exits()[n]);
+      const Dtype scale = expected_exits[n] < 0 ? 2 : 1;
+      for (int i = 0; i < dim; ++i) {
+        EXPECT_NEAR(scale * data->cpu_data()[n * dim + i],
+                    output->cpu_data()[n * dim + i], 1e-6);
+      }
+    }
+  }
+
   int seed_;
   shared_ptr<Net<Dtype> > net_;
 };
@@ -1342,6 +1406,55 @@ TYPED_TEST(NetTest, TestSharedWeightsResume) {
   }
 }
 
+TYPED_TEST(NetTest, TestCopyTrainedLayersDuplicateNames) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'DuplicateNames' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "    shape { dim: 2 dim: 3 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'first' "
+      "  inner_product_param { "
+      "    num_output: 2 bias_term: false "
+      "    weight_filler { type: 'constant' value: 1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'second' "
+      "  inner_product_param { "
+      "    num_output: 2 bias_term: false "
+      "    weight_filler { type: 'constant' value: 1 } "
+      "  } "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  // The input is split for the two layers named ip.
+  ASSERT_EQ("Split", string(this->net_->layers()[1]->type()));
+  Blob<Dtype>* weights = this->net_->layers()[2]->blobs()[0].get();
+  caffe_set(weights->count(), Dtype(7), weights->mutable_cpu_data());
+  NetParameter net_param;
+  this->net_->ToProto(&net_param);
+  net_param.mutable_layer()->RemoveLast();
+  // As before layer names were indexed, the first layer of the name gets
+  // the weights.
+  this->InitNetFromProtoString(proto);
+  this->net_->CopyTrainedLayersFrom(net_param);
+  EXPECT_EQ(7, this->net_->layers()[2]->blobs()[0]->cpu_data()[0]);
+  EXPECT_EQ(1, this->net_->layers()[3]->blobs()[0]->cpu_data()[0]);
+  EXPECT_EQ(this->net_->layers()[2], this->net_->layer_by_name("ip"));
+}
+
 TYPED_TEST(NetTest, TestParamPropagateDown) {
   typedef typename TypeParam::Dtype Dtype;
   const bool kBiasTerm = true, kForceBackward = false;
@@ -2601,4 +2714,206 @@ TYPED_TEST(NetTest, TestAllInOneNetDeploy) {
   ASSERT_TRUE(found_data);
 }
 
+TYPED_TEST(NetTest, TestCompiledNet) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'CompiledNet' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "    shape { dim: 2 dim: 3 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'train-only' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'train-only' "
+      "  inner_product_param { num_output: 4 } "
+      "  include { phase: TRAIN } "
+      "} "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'ip1' "
+      "  inner_product_param { num_output: 5 } "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'ip2' "
+      "  inner_product_param { num_output: 6 } "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(caffe::TEST);
+  Net<Dtype> net(param);
+  NetParameter compiled;
+  Net<Dtype>::Compile(param, &compiled);
+  EXPECT_TRUE(compiled.compiled());
+  // The TRAIN layer is filtered out, and the input is split for two layers.
+  ASSERT_EQ(net.layers().size(), compiled.layer_size());
+  for (int i = 0; i < compiled.layer_size(); ++i) {
+    EXPECT_EQ(net.layer_names()[i], compiled.layer(i).name());
+    EXPECT_EQ(caffe::TEST, compiled.layer(i).phase());
+  }
+  EXPECT_EQ("Split", compiled.layer(1).type());
+  net.RecordTopShapes(&compiled);
+  ASSERT_EQ(5, compiled.top_shape_size());
+  EXPECT_EQ(2, compiled.top_shape(4).dim(0));
+  EXPECT_EQ(6, compiled.top_shape(4).dim(1));
+  // Compiled nets are loaded from .caffenet files as they are.
+  string filename;
+  MakeTempFilename(&filename);
+  filename += ".caffenet";
+  WriteProtoToBinaryFile(compiled, filename);
+  Net<Dtype> compiled_net(filename, caffe::TEST);
+  EXPECT_EQ(net.layer_names(), compiled_net.layer_names());
+  EXPECT_EQ(net.blob_names(), compiled_net.blob_names());
+  for (int i = 0; i < net.blobs().size(); ++i) {
+    EXPECT_EQ(net.blobs()[i]->shape(), compiled_net.blobs()[i]->shape());
+  }
+}
+
+TYPED_TEST(NetTest, TestCompiledNetMismatchDeath) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'CompiledNet' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "    shape { dim: 2 dim: 3 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'ip' "
+      "  inner_product_param { num_output: 4 } "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(caffe::TEST);
+  NetParameter compiled;
+  Net<Dtype>::Compile(param, &compiled);
+  {
+    Net<Dtype> net(compiled);
+    net.RecordTopShapes(&compiled);
+  }
+  string filename;
+  MakeTempFilename(&filename);
+  filename += ".caffenet";
+  WriteProtoToBinaryFile(compiled, filename);
+  // The re-executed test does not share the state of the device.
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  // A compiled net is only loaded for the state it was compiled for.
+  EXPECT_DEATH(Net<Dtype> net(filename, caffe::TRAIN),
+               "compiled for another phase, level or stages");
+  EXPECT_DEATH(Net<Dtype> net(filename, caffe::TEST, 1),
+               "compiled for another phase, level or stages");
+  const vector<string> stages(1, "stage");
+  EXPECT_DEATH(Net<Dtype> net(filename, caffe::TEST, 0, &stages),
+               "compiled for another phase, level or stages");
+  // Nor when its layers no longer set up the recorded shapes.
+  compiled.mutable_top_shape(1)->set_dim(1, 5);
+  WriteProtoToBinaryFile(compiled, filename);
+  EXPECT_DEATH(Net<Dtype> net(filename, caffe::TEST),
+               "Top 0 of layer ip set up as 2 4 \\(8\\), not as compiled");
+}
+
+TYPED_TEST(NetTest, TestEarlyExit) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitEarlyExitNet("early_exit { blob: 'stage1' threshold: 0.5 } ");
+  const bool confident[] = {true, false, true, false};
+  this->SetPeaks(confident);
+  Blob<Dtype> data;
+  data.CopyFrom(*this->net_->input_blobs()[0], false, true);
+  // Items 1 and 3 go through stage2, and the input is left as it was.
+  const int expected_exits[] = {0, -1, 0, -1};
+  for (int i = 0; i < 2; ++i) {
+    this->net_->Forward();
+    this->CheckEarlyExitOutput(expected_exits);
+    const Blob<Dtype>* input = this->net_->input_blobs()[0];
+    ASSERT_EQ(data.shape(), input->shape());
+    for (int j = 0; j < data.count(); ++j) {
+      EXPECT_EQ(data.cpu_data()[j], input->cpu_data()[j]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestEarlyExitMean) {
+  this->InitEarlyExitNet(
+      "early_exit { blob: 'stage1' threshold: 0.6 reduction: MEAN } ");
+  const bool confident[] = {false, true, false, false};
+  this->SetPeaks(confident);
+  this->net_->Forward();
+  // All but the confident item have the mean peak (0.9 + 0.4) / 2.
+  const int expected_exits[] = {0, 0, 0, 0};
+  this->CheckEarlyExitOutput(expected_exits);
+  const bool some_confident[] = {true, true, true, false};
+  this->InitEarlyExitNet(
+      "early_exit { blob: 'stage1' threshold: 0.7 reduction: MEAN } ");
+  this->SetPeaks(some_confident);
+  this->net_->Forward();
+  const int expected_some_exits[] = {0, 0, 0, -1};
+  this->CheckEarlyExitOutput(expected_some_exits);
+}
+
+TYPED_TEST(NetTest, TestEarlyExitDisabled) {
+  this->InitEarlyExitNet("early_exit { blob: 'stage1' threshold: 0.5 } ");
+  const bool confident[] = {true, true, true, true};
+  this->SetPeaks(confident);
+  this->net_->set_early_exit(false);
+  this->net_->Forward();
+  EXPECT_TRUE(this->net_->item_exits().empty());
+  this->net_->set_early_exit(true);
+  this->net_->Forward();
+  const int expected_exits[] = {0, 0, 0, 0};
+  this->CheckEarlyExitOutput(expected_exits);
+}
+
+TYPED_TEST(NetTest, TestEarlyExitSeveralOutputsDeath) {
+  // A second output would only hold the items that did not exit.
+  const string& proto =
+      "name: 'EarlyExitNet' "
+      "early_exit { blob: 'stage1' output: 'stage2' threshold: 0.5 } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "    shape { dim: 4 dim: 2 dim: 3 dim: 3 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'stage1' "
+      "  type: 'Power' "
+      "  bottom: 'data' "
+      "  top: 'stage1' "
+      "} "
+      "layer { "
+      "  name: 'stage2' "
+      "  type: 'Eltwise' "
+      "  bottom: 'data' "
+      "  bottom: 'stage1' "
+      "  top: 'stage2' "
+      "} "
+      "layer { "
+      "  name: 'other' "
+      "  type: 'Power' "
+      "  bottom: 'stage1' "
+      "  top: 'other' "
+      "} ";
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_DEATH(this->InitNetFromProtoString(proto),
+               "Early exits need a net with a single output");
+}
+
 }  // namespace caffe
@@ -0,0 +1,333 @@
+#include <boost/thread.hpp>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/sgd_solvers.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/profiler.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ProfilerTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() { Profiler::Get().Disable(); }
+  virtual void TearDown() { Profiler::Get().Disable(); }
+
+  int CountEvents(const vector<ProfileEvent>& events, const string& name,
+      const string& category) {
+    int count = 0;
+    for (int i = 0; i < events.size(); ++i) {
+      if (name == events[i].name && category == events[i].category) {
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  string ReadFile(const string& filename) {
+    std::ifstream input(filename.c_str());
+    std::stringstream contents;
+    contents << input.rdbuf();
+    return contents.str();
+  }
+
+  // A small train net with a weighted layer, so that every layer runs a
+  // forward pass and the weighted and loss layers run a backward pass.
+  string NetProto() {
+    return
+        "name: 'ProfiledNet' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'DummyData' "
+        "  dummy_data_param { "
+        "    shape { dim: 4 dim: 3 } "
+        "    shape { dim: 4 dim: 2 } "
+        "    data_filler { type: 'gaussian' } "
+        "    data_filler { type: 'gaussian' } "
+        "  } "
+        "  top: 'data' "
+        "  top: 'target' "
+        "} "
+        "layer { "
+        "  name: 'innerprod' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 2 "
+        "    weight_filler { type: 'gaussian' } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'innerprod' "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'EuclideanLoss' "
+        "  bottom: 'innerprod' "
+        "  bottom: 'target' "
+        "  top: 'loss' "
+        "} ";
+  }
+};
+
+TEST_F(ProfilerTest, TestDisabledRecordsNothing) {
+  Profiler& profiler = Profiler::Get();
+  EXPECT_FALSE(profiler.enabled());
+  profiler.Record("span", "test", 0, 1);
+  {
+    ProfileScope scope("scope", "test");
+  }
+  vector<ProfileEvent> events;
+  profiler.Drain(&events);
+  EXPECT_EQ(0, events.size());
+}
+
+TEST_F(ProfilerTest, TestRecordAndDrain) {
+  Profiler& profiler = Profiler::Get();
+  profiler.Enable(16);
+  EXPECT_TRUE(profiler.enabled());
+  profiler.set_iter(7);
+  profiler.Record("first", "test", 10, 5);
+  profiler.Record("second", "test", 20, 3);
+  vector<ProfileEvent> events;
+  profiler.Drain(&events);
+  ASSERT_EQ(2, events.size());
+  EXPECT_STREQ("first", events[0].name);
+  EXPECT_STREQ("test", events[0].category);
+  EXPECT_EQ(10, events[0].start_us);
+  EXPECT_EQ(5, events[0].duration_us);
+  EXPECT_EQ(7, events[0].iter);
+  EXPECT_STREQ("second", events[1].name);
+  // Drained events are not returned again.
+  profiler.Drain(&events);
+  EXPECT_EQ(0, events.size());
+  EXPECT_EQ(0, profiler.dropped());
+}
+
+TEST_F(ProfilerTest, TestOverflowDropsOldest) {
+  Profiler& profiler = Profiler::Get();
+  const int capacity = 4;
+  profiler.Enable(capacity);
+  const char* names[] = {"e0", "e1", "e2", "e3", "e4", "e5"};
+  for (int i = 0; i < 6; ++i) {
+    profiler.Record(names[i], "test", i, 1);
+  }
+  vector<ProfileEvent> events;
+  profiler.Drain(&events);
+  ASSERT_EQ(capacity, events.size());
+  for (int i = 0; i < capacity; ++i) {
+    EXPECT_STREQ(names[i + 2], events[i].name);
+  }
+  EXPECT_EQ(2, profiler.dropped());
+}
+
+TEST_F(ProfilerTest, TestScope) {
+  Profiler& profiler = Profiler::Get();
+  profiler.Enable(16);
+  {
+    ProfileScope scope("scope", "test");
+    boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+  }
+  vector<ProfileEvent> events;
+  profiler.Drain(&events);
+  ASSERT_EQ(1, events.size());
+  EXPECT_STREQ("scope", events[0].name);
+  EXPECT_GE(events[0].start_us, 0);
+  EXPECT_GE(events[0].duration_us, 1000);
+}
+
+static void RecordMany(int num_events) {
+  for (int i = 0; i < num_events; ++i) {
+    Profiler::Get().Record("worker", "test", i, 1);
+  }
+}
+
+TEST_F(ProfilerTest, TestConcurrentRecord) {
+  Profiler& profiler = Profiler::Get();
+  const int num_threads = 4;
+  const int num_events = 1000;
+  profiler.Enable(num_threads * num_events);
+  vector<shared_ptr<boost::thread> > threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.push_back(shared_ptr<boost::thread>(
+        new boost::thread(&RecordMany, num_events)));
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    threads[i]->join();
+  }
+  vector<ProfileEvent> events;
+  profiler.Drain(&events);
+  EXPECT_EQ(num_threads * num_events, events.size());
+  EXPECT_EQ(0, profiler.dropped());
+}
+
+TEST_F(ProfilerTest, TestNetForwardBackward) {
+  Caffe::set_mode(Caffe::CPU);
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(NetProto(), &param));
+  Net<float> net(param);
+  Profiler& profiler = Profiler::Get();
+  profiler.Enable(64);
+  net.ForwardBackward();
+  vector<ProfileEvent> events;
+  profiler.Drain(&events);
+  EXPECT_EQ(1, CountEvents(events, "data", "forward"));
+  EXPECT_EQ(1, CountEvents(events, "innerprod", "forward"));
+  EXPECT_EQ(1, CountEvents(events, "loss", "forward"));
+  EXPECT_EQ(0, CountEvents(events, "data", "backward"));
+  EXPECT_EQ(1, CountEvents(events, "innerprod", "backward"));
+  EXPECT_EQ(1, CountEvents(events, "loss", "backward"));
+}
+
+// Produces batches of ones and reports fixed read and transform times.
+class ConstantPrefetchingDataLayer : public BasePrefetchingDataLayer<float> {
+ public:
+  explicit ConstantPrefetchingDataLayer(const LayerParameter& param)
+      : BasePrefetchingDataLayer<float>(param) {}
+  virtual ~ConstantPrefetchingDataLayer() { this->StopInternalThread(); }
+  virtual void DataLayerSetUp(const vector<Blob<float>*>& bottom,
+      const vector<Blob<float>*>& top) {
+    top[0]->Reshape(2, 3, 1, 1);
+    for (int i = 0; i < PREFETCH_COUNT; ++i) {
+      this->prefetch_[i].data_.ReshapeLike(*top[0]);
+    }
+  }
+  virtual inline const char* type() const {
+    return "ConstantPrefetchingData";
+  }
+
+ protected:
+  virtual void load_batch(Batch<float>* batch) {
+    caffe_set(batch->data_.count(), 1.f, batch->data_.mutable_cpu_data());
+    this->ProfileLoadBatch(3, 4);
+  }
+};
+
+TEST_F(ProfilerTest, TestPrefetchingDataLayer) {
+  Caffe::set_mode(Caffe::CPU);
+  Profiler& profiler = Profiler::Get();
+  profiler.Enable(256);
+  LayerParameter param;
+  param.set_name("constant");
+  {
+    ConstantPrefetchingDataLayer layer(param);
+    Blob<float> top_blob;
+    vector<Blob<float>*> bottom;
+    vector<Blob<float>*> top(1, &top_blob);
+    layer.SetUp(bottom, top);
+    layer.Forward(bottom, top);
+    layer.Forward(bottom, top);
+    EXPECT_EQ(1.f, top_blob.cpu_data()[0]);
+  }
+  vector<ProfileEvent> events;
+  profiler.Drain(&events);
+  EXPECT_EQ(2, CountEvents(events, "constant", "data_wait"));
+  const int loaded = CountEvents(events, "constant", "load_batch");
+  EXPECT_GE(loaded, 2);
+  EXPECT_EQ(loaded, CountEvents(events, "constant", "data_read"));
+  EXPECT_EQ(loaded, CountEvents(events, "constant", "data_transform"));
+  for (int i = 0; i < events.size(); ++i) {
+    if (string("data_read") == events[i].category) {
+      EXPECT_EQ(3, events[i].duration_us);
+    } else if (string("data_transform") == events[i].category) {
+      EXPECT_EQ(4, events[i].duration_us);
+    }
+  }
+}
+
+TEST_F(ProfilerTest, TestExportChromeTrace) {
+  Profiler& profiler = Profiler::Get();
+  profiler.Enable(16);
+  profiler.Record("conv\"1", "forward", 3, 4);
+  string filename;
+  MakeTempFilename(&filename);
+  EXPECT_EQ(1, profiler.ExportChromeTrace(filename));
+  const string trace = ReadFile(filename);
+  EXPECT_NE(string::npos, trace.find("\"traceEvents\""));
+  EXPECT_NE(string::npos, trace.find("\"name\": \"conv\\\"1\""));
+  EXPECT_NE(string::npos, trace.find("\"ph\": \"X\", \"ts\": 3, \"dur\": 4"));
+  // The exported event is not written again.
+  EXPECT_EQ(0, profiler.ExportChromeTrace(filename));
+}
+
+TEST_F(ProfilerTest, TestSolverExportsEveryInterval) {
+  Caffe::set_mode(Caffe::CPU);
+  string prefix;
+  MakeTempFilename(&prefix);
+  SolverParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "base_lr: 0.01 lr_policy: 'fixed' max_iter: 4 display: 0 "
+      "profile_interval: 2 net_param { " + NetProto() + " }", &param));
+  param.set_solver_mode(SolverParameter_SolverMode_CPU);
+  param.set_profile_prefix(prefix);
+  SGDSolver<float> solver(param);
+  EXPECT_TRUE(Profiler::Get().enabled());
+  solver.Step(4);
+  for (int iter = 2; iter <= 4; iter += 2) {
+    const string trace = ReadFile(
+        prefix + "_iter_" + format_int(iter) + ".trace.json");
+    EXPECT_NE(string::npos, trace.find("\"name\": \"innerprod\", "
+        "\"cat\": \"backward\""));
+    EXPECT_NE(string::npos, trace.find("\"name\": \"update\", "
+        "\"cat\": \"solver\""));
+    EXPECT_NE(string::npos, trace.find("\"args\": {\"iter\": "
+        + format_int(iter - 1) + "}"));
+  }
+}
+
+TEST_F(ProfilerTest, TestSolveExportsRemainder) {
+  Caffe::set_mode(Caffe::CPU);
+  string prefix;
+  MakeTempFilename(&prefix);
+  SolverParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "base_lr: 0.01 lr_policy: 'fixed' max_iter: 5 display: 0 "
+      "snapshot_after_train: false "
+      "profile_interval: 2 net_param { " + NetProto() + " }", &param));
+  param.set_solver_mode(SolverParameter_SolverMode_CPU);
+  param.set_profile_prefix(prefix);
+  SGDSolver<float> solver(param);
+  solver.Solve();
+  // The last iteration is past the last interval.
+  const string trace = ReadFile(prefix + "_iter_5_final.trace.json");
+  EXPECT_NE(string::npos, trace.find("\"name\": \"innerprod\", "
+      "\"cat\": \"backward\""));
+  EXPECT_NE(string::npos, trace.find("\"args\": {\"iter\": 4}"));
+  EXPECT_EQ(string::npos, trace.find("\"args\": {\"iter\": 3}"));
+  // Nets built after the solver is done are not profiled.
+  EXPECT_FALSE(Profiler::Get().enabled());
+}
+
+TEST_F(ProfilerTest, TestSolverDisablesWhenDestroyed) {
+  Caffe::set_mode(Caffe::CPU);
+  string prefix;
+  MakeTempFilename(&prefix);
+  SolverParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "base_lr: 0.01 lr_policy: 'fixed' max_iter: 4 display: 0 "
+      "profile_interval: 2 net_param { " + NetProto() + " }", &param));
+  param.set_solver_mode(SolverParameter_SolverMode_CPU);
+  param.set_profile_prefix(prefix);
+  {
+    SGDSolver<float> solver(param);
+    solver.Step(1);
+    EXPECT_TRUE(Profiler::Get().enabled());
+  }
+  // The events recorded name the layers of the solver's nets.
+  EXPECT_FALSE(Profiler::Get().enabled());
+  vector<ProfileEvent> events;
+  Profiler::Get().Drain(&events);
+  EXPECT_TRUE(events.empty());
+}
+
+}  // namespace caffe
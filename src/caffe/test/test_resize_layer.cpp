@@ -0,0 +1,198 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/resize_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class ResizeLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  ResizeLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~ResizeLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // Resizes the 2 x 2 input 1 2 / 3 4 and checks the output.
+  void TestForward2x2(const LayerParameter& layer_param, int height,
+      int width, const Dtype* expected) {
+    blob_bottom_->Reshape(1, 1, 2, 2);
+    for (int i = 0; i < 4; ++i) {
+      blob_bottom_->mutable_cpu_data()[i] = i + 1;
+    }
+    ResizeLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    ASSERT_EQ(height, blob_top_->height());
+    ASSERT_EQ(width, blob_top_->width());
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    for (int i = 0; i < height * width; ++i) {
+      EXPECT_NEAR(expected[i], blob_top_->cpu_data()[i], 1e-5) << i;
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ResizeLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(ResizeLayerTest, TestSetup) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  {
+    ResizeLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(2, this->blob_top_->num());
+    EXPECT_EQ(3, this->blob_top_->channels());
+    EXPECT_EQ(8, this->blob_top_->height());
+    EXPECT_EQ(10, this->blob_top_->width());
+  }
+  layer_param.mutable_resize_param()->set_scale(0.5);
+  {
+    ResizeLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(2, this->blob_top_->height());
+    EXPECT_EQ(2, this->blob_top_->width());
+  }
+  layer_param.mutable_resize_param()->set_height(7);
+  layer_param.mutable_resize_param()->set_width(3);
+  {
+    ResizeLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(7, this->blob_top_->height());
+    EXPECT_EQ(3, this->blob_top_->width());
+  }
+  Blob<Dtype> reference(1, 1, 9, 6);
+  this->blob_bottom_vec_.push_back(&reference);
+  {
+    ResizeLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(2, this->blob_top_->num());
+    EXPECT_EQ(3, this->blob_top_->channels());
+    EXPECT_EQ(9, this->blob_top_->height());
+    EXPECT_EQ(6, this->blob_top_->width());
+  }
+}
+
+TYPED_TEST(ResizeLayerTest, TestForwardNearest) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_resize_param()->set_interpolation(
+      ResizeParameter_Interpolation_NEAREST);
+  const Dtype expected[] = {
+    1, 1, 2, 2,
+    1, 1, 2, 2,
+    3, 3, 4, 4,
+    3, 3, 4, 4,
+  };
+  this->TestForward2x2(layer_param, 4, 4, expected);
+}
+
+TYPED_TEST(ResizeLayerTest, TestForwardNearestAlignCorners) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_resize_param()->set_interpolation(
+      ResizeParameter_Interpolation_NEAREST);
+  layer_param.mutable_resize_param()->set_align_corners(true);
+  layer_param.mutable_resize_param()->set_height(3);
+  layer_param.mutable_resize_param()->set_width(4);
+  const Dtype expected[] = {
+    1, 1, 2, 2,
+    3, 3, 4, 4,
+    3, 3, 4, 4,
+  };
+  this->TestForward2x2(layer_param, 3, 4, expected);
+}
+
+TYPED_TEST(ResizeLayerTest, TestForwardBilinear) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  const Dtype expected[] = {
+    1.0, 1.25, 1.75, 2.0,
+    1.5, 1.75, 2.25, 2.5,
+    2.5, 2.75, 3.25, 3.5,
+    3.0, 3.25, 3.75, 4.0,
+  };
+  this->TestForward2x2(layer_param, 4, 4, expected);
+}
+
+TYPED_TEST(ResizeLayerTest, TestForwardBilinearAlignCorners) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_resize_param()->set_align_corners(true);
+  layer_param.mutable_resize_param()->set_height(3);
+  layer_param.mutable_resize_param()->set_width(4);
+  const Dtype third = 1. / 3;
+  const Dtype expected[] = {
+    1, 1 + third, 2 - third, 2,
+    2, 2 + third, 3 - third, 3,
+    3, 3 + third, 4 - third, 4,
+  };
+  this->TestForward2x2(layer_param, 3, 4, expected);
+}
+
+TYPED_TEST(ResizeLayerTest, TestGradientNearest) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_resize_param()->set_interpolation(
+      ResizeParameter_Interpolation_NEAREST);
+  ResizeLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ResizeLayerTest, TestGradientBilinear) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ResizeLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ResizeLayerTest, TestGradientBilinearAlignCorners) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_resize_param()->set_align_corners(true);
+  layer_param.mutable_resize_param()->set_height(7);
+  layer_param.mutable_resize_param()->set_width(9);
+  ResizeLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ResizeLayerTest, TestGradientBilinearDownsample) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_resize_param()->set_height(3);
+  layer_param.mutable_resize_param()->set_width(2);
+  ResizeLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
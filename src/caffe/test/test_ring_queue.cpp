@@ -0,0 +1,127 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/ring_queue.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+typedef RingQueue<Datum*> Queue;
+
+class RingQueueTest : public ::testing::TestWithParam<Queue::Mode> {
+ public:
+  // Pushes datums [begin, end) in order.
+  void Produce(Queue* queue, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      queue->push(&datums_[i]);
+    }
+  }
+
+  // Pops count datums, counting them in seen.
+  void Consume(Queue* queue, int count, vector<int>* seen) {
+    for (int i = 0; i < count; ++i) {
+      ++(*seen)[queue->pop() - &datums_[0]];
+    }
+  }
+
+ protected:
+  RingQueueTest() : datums_(kCount) {}
+
+  static const int kCount = 20000;
+  vector<Datum> datums_;
+};
+
+TEST_P(RingQueueTest, TestFifo) {
+  Queue queue(4, GetParam());
+  EXPECT_EQ(4, queue.capacity());
+  Datum* datum;
+  EXPECT_FALSE(queue.try_pop(&datum));
+  EXPECT_FALSE(queue.try_peek(&datum));
+  // Fill it twice over, to wrap around the ring.
+  for (int round = 0; round < 2; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_TRUE(queue.try_push(&datums_[i]));
+    }
+    EXPECT_FALSE(queue.try_push(&datums_[4]));
+    EXPECT_EQ(4, queue.size());
+    EXPECT_EQ(&datums_[0], queue.peek());
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(&datums_[i], queue.pop());
+    }
+    EXPECT_EQ(0, queue.size());
+  }
+  EXPECT_EQ(0, queue.waits());
+}
+
+TEST_P(RingQueueTest, TestSingleProducerConsumer) {
+  Queue queue(3, GetParam());
+  vector<int> order;
+  boost::thread producer(boost::bind(&RingQueueTest::Produce, this, &queue,
+      0, static_cast<int>(kCount)));
+  for (int i = 0; i < kCount; ++i) {
+    EXPECT_EQ(&datums_[i], queue.pop());
+  }
+  producer.join();
+}
+
+TEST_P(RingQueueTest, TestMultipleProducersConsumers) {
+  if (GetParam() == Queue::SPSC) {
+    return;
+  }
+  Queue queue(8, GetParam());
+  const int kThreads = 4;
+  vector<vector<int> > seen(kThreads, vector<int>(kCount));
+  boost::thread_group threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.create_thread(boost::bind(&RingQueueTest::Produce, this, &queue,
+        i * kCount / kThreads, (i + 1) * kCount / kThreads));
+    threads.create_thread(boost::bind(&RingQueueTest::Consume, this, &queue,
+        kCount / kThreads, &seen[i]));
+  }
+  threads.join_all();
+  for (int j = 0; j < kCount; ++j) {
+    int count = 0;
+    for (int i = 0; i < kThreads; ++i) {
+      count += seen[i][j];
+    }
+    EXPECT_EQ(1, count);
+  }
+}
+
+TEST_P(RingQueueTest, TestParkedPopIsWoken) {
+  Queue queue(2, GetParam());
+  vector<int> seen(kCount);
+  boost::thread consumer(boost::bind(&RingQueueTest::Consume, this, &queue,
+      1, &seen));
+  // Long enough for the consumer to have parked.
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  queue.push(&datums_[7]);
+  consumer.join();
+  EXPECT_EQ(1, seen[7]);
+  EXPECT_EQ(1, queue.waits());
+  EXPECT_GT(queue.wait_us(), 0);
+}
+
+TEST_P(RingQueueTest, TestParkedPopIsInterrupted) {
+  Queue queue(2, GetParam());
+  vector<int> seen(kCount);
+  boost::thread consumer(boost::bind(&RingQueueTest::Consume, this, &queue,
+      1, &seen));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  consumer.interrupt();
+  consumer.join();
+  // The interrupted consumer no longer counts as parked.
+  EXPECT_TRUE(queue.try_push(&datums_[0]));
+  EXPECT_EQ(&datums_[0], queue.pop());
+}
+
+INSTANTIATE_TEST_CASE_P(RingQueueModes, RingQueueTest,
+    ::testing::Values(Queue::SPSC, Queue::MPMC));
+
+}  // namespace caffe
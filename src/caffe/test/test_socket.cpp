@@ -0,0 +1,56 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/socket.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class SocketTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_));
+  }
+  virtual void TearDown() {
+    for (int i = 0; i < 2; ++i) {
+      if (fds_[i] >= 0) {
+        close(fds_[i]);
+      }
+    }
+  }
+
+  int fds_[2];
+};
+
+TEST_F(SocketTest, TestWriteAndReadAll) {
+  std::vector<float> sent(1000);
+  for (int i = 0; i < sent.size(); ++i) {
+    sent[i] = i;
+  }
+  ASSERT_TRUE(WriteAll(fds_[0], sent.data(), sent.size() * sizeof(float)));
+  std::vector<float> received(sent.size());
+  // Read in two parts, the first ending within a float.
+  char* bytes = reinterpret_cast<char*>(received.data());
+  ASSERT_TRUE(ReadAll(fds_[1], bytes, 7));
+  ASSERT_TRUE(ReadAll(fds_[1], bytes + 7, received.size() * sizeof(float) - 7));
+  EXPECT_EQ(sent, received);
+}
+
+TEST_F(SocketTest, TestClosedPeer) {
+  const char data[4] = {1, 2, 3, 4};
+  ASSERT_TRUE(WriteAll(fds_[0], data, 2));
+  close(fds_[0]);
+  fds_[0] = -1;
+  // Two of the four bytes arrive before the peer closes.
+  char received[4];
+  EXPECT_FALSE(ReadAll(fds_[1], received, sizeof(received)));
+  // Writing to the closed peer fails rather than raising SIGPIPE.
+  EXPECT_FALSE(WriteAll(fds_[1], data, sizeof(data)));
+}
+
+}  // namespace caffe
@@ -5,12 +5,9 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
-#include "caffe/layers/concat_layer.hpp"
-#include "caffe/layers/flatten_layer.hpp"
 #include "caffe/layers/pooling_layer.hpp"
-#include "caffe/layers/split_layer.hpp"
 #include "caffe/layers/spp_layer.hpp"
-
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -43,6 +40,77 @@ class SPPLayerTest : public MultiDeviceTest<TypeParam> {
   }
   virtual ~SPPLayerTest() { delete blob_bottom_; delete blob_top_; }
 
+  // Checks SPP of the given input size against PoolingLayers pooling each
+  // level, flattened and concatenated, forward and backward.
+  void TestAgainstPooling(SPPParameter_PoolMethod pool, int height,
+      int width) {
+    typedef typename TypeParam::Dtype Dtype;
+    const int pyramid_height = 3;
+    Blob<Dtype> bottom(2, 3, height, width);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&bottom);
+    vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+    LayerParameter layer_param;
+    layer_param.mutable_spp_param()->set_pyramid_height(pyramid_height);
+    layer_param.mutable_spp_param()->set_pool(pool);
+    SPPLayer<Dtype> layer(layer_param);
+    layer.SetUp(bottom_vec, this->blob_top_vec_);
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+    filler.Fill(this->blob_top_);
+    caffe_copy(this->blob_top_->count(), this->blob_top_->cpu_data(),
+        this->blob_top_->mutable_cpu_diff());
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+    vector<bool> propagate_down(1, true);
+    layer.Backward(this->blob_top_vec_, propagate_down, bottom_vec);
+    Blob<Dtype> expected_diff(2, 3, height, width);
+    caffe_set(expected_diff.count(), Dtype(0),
+        expected_diff.mutable_cpu_data());
+    const int top_dim = this->blob_top_->count(1);
+    int offset = 0;
+    for (int i = 0; i < pyramid_height; ++i) {
+      const int num_bins = 1 << i;
+      const int kernel_h = (height + num_bins - 1) / num_bins;
+      const int kernel_w = (width + num_bins - 1) / num_bins;
+      LayerParameter pooling_param;
+      PoolingParameter* pooling = pooling_param.mutable_pooling_param();
+      pooling->set_kernel_h(kernel_h);
+      pooling->set_kernel_w(kernel_w);
+      pooling->set_stride_h(kernel_h);
+      pooling->set_stride_w(kernel_w);
+      pooling->set_pad_h((kernel_h * num_bins - height + 1) / 2);
+      pooling->set_pad_w((kernel_w * num_bins - width + 1) / 2);
+      pooling->set_pool(pool == SPPParameter_PoolMethod_MAX ?
+          PoolingParameter_PoolMethod_MAX : PoolingParameter_PoolMethod_AVE);
+      PoolingLayer<Dtype> pooling_layer(pooling_param);
+      Blob<Dtype> pooled;
+      vector<Blob<Dtype>*> pooled_vec(1, &pooled);
+      pooling_layer.SetUp(bottom_vec, pooled_vec);
+      ASSERT_EQ(num_bins, pooled.height());
+      ASSERT_EQ(num_bins, pooled.width());
+      pooling_layer.Forward(bottom_vec, pooled_vec);
+      const int level_dim = pooled.count(1);
+      for (int n = 0; n < 2; ++n) {
+        for (int j = 0; j < level_dim; ++j) {
+          const int top_index = n * top_dim + offset + j;
+          EXPECT_NEAR(pooled.cpu_data()[n * level_dim + j],
+              this->blob_top_->cpu_data()[top_index], 1e-5);
+          pooled.mutable_cpu_diff()[n * level_dim + j] =
+              this->blob_top_->cpu_diff()[top_index];
+        }
+      }
+      pooling_layer.Backward(pooled_vec, propagate_down, bottom_vec);
+      caffe_axpy(expected_diff.count(), Dtype(1), bottom.cpu_diff(),
+          expected_diff.mutable_cpu_data());
+      offset += level_dim;
+    }
+    ASSERT_EQ(top_dim, offset);
+    layer.Backward(this->blob_top_vec_, propagate_down, bottom_vec);
+    for (int i = 0; i < bottom.count(); ++i) {
+      EXPECT_NEAR(expected_diff.cpu_data()[i], bottom.cpu_diff()[i], 1e-5);
+    }
+  }
+
   Blob<Dtype>* const blob_bottom_;
   Blob<Dtype>* const blob_bottom_2_;
   Blob<Dtype>* const blob_bottom_3_;
@@ -130,5 +198,30 @@ TYPED_TEST(SPPLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(SPPLayerTest, TestGradientAve) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  SPPParameter* spp_param = layer_param.mutable_spp_param();
+  spp_param->set_pyramid_height(3);
+  spp_param->set_pool(SPPParameter_PoolMethod_AVE);
+  SPPLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(SPPLayerTest, TestMaxAgainstPooling) {
+  // Nested levels, nested rows only, and none nested.
+  this->TestAgainstPooling(SPPParameter_PoolMethod_MAX, 16, 12);
+  this->TestAgainstPooling(SPPParameter_PoolMethod_MAX, 8, 9);
+  this->TestAgainstPooling(SPPParameter_PoolMethod_MAX, 7, 10);
+}
+
+TYPED_TEST(SPPLayerTest, TestAveAgainstPooling) {
+  this->TestAgainstPooling(SPPParameter_PoolMethod_AVE, 16, 12);
+  this->TestAgainstPooling(SPPParameter_PoolMethod_AVE, 8, 9);
+  this->TestAgainstPooling(SPPParameter_PoolMethod_AVE, 7, 10);
+}
 
 }  // namespace caffe
@@ -0,0 +1,244 @@
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <unistd.h>
+#ifdef USE_OPENBLAS
+#include <cblas.h>
+#endif
+
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/util/affinity.hpp"
+
+namespace caffe {
+
+vector<int> ParseCpuList(const string& cpu_list) {
+  vector<int> cpus;
+  vector<string> ranges;
+  const string trimmed = boost::trim_copy(cpu_list);
+  if (trimmed.empty()) {
+    return cpus;
+  }
+  boost::split(ranges, trimmed, boost::is_any_of(","));
+  for (int i = 0; i < ranges.size(); ++i) {
+    vector<string> bounds;
+    boost::split(bounds, ranges[i], boost::is_any_of("-"));
+    CHECK(bounds.size() == 1 || bounds.size() == 2)
+        << "Invalid CPU range \"" << ranges[i] << "\" in \"" << cpu_list
+        << "\"";
+    int first, last;
+    try {
+      first = boost::lexical_cast<int>(boost::trim_copy(bounds[0]));
+      last = boost::lexical_cast<int>(boost::trim_copy(bounds.back()));
+    } catch (boost::bad_lexical_cast&) {
+      LOG(FATAL) << "Invalid CPU range \"" << ranges[i] << "\" in \""
+                 << cpu_list << "\"";
+    }
+    CHECK_GE(first, 0) << "CPU ids are non-negative.";
+    CHECK_LE(first, last) << "Invalid CPU range \"" << ranges[i] << "\"";
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+string FormatCpuList(const vector<int>& cpus) {
+  std::ostringstream cpu_list;
+  for (int i = 0; i < cpus.size(); ++i) {
+    int j = i;
+    while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+      ++j;
+    }
+    cpu_list << (i ? "," : "") << cpus[i];
+    if (j > i) {
+      cpu_list << "-" << cpus[j];
+    }
+    i = j;
+  }
+  return cpu_list.str();
+}
+
+vector<vector<int> > NumaNodeCpus() {
+  vector<vector<int> > nodes;
+  for (int node = 0; ; ++node) {
+    std::ifstream cpulist(("/sys/devices/system/node/node" +
+        boost::lexical_cast<string>(node) + "/cpulist").c_str());
+    string line;
+    if (!cpulist.good() || !std::getline(cpulist, line)) {
+      break;
+    }
+    nodes.push_back(ParseCpuList(line));
+  }
+  if (nodes.empty()) {
+    const int num_cpus = boost::thread::hardware_concurrency();
+    nodes.push_back(vector<int>());
+    for (int cpu = 0; cpu < num_cpus; ++cpu) {
+      nodes[0].push_back(cpu);
+    }
+  }
+  return nodes;
+}
+
+#ifdef __linux__
+static bool ToCpuSet(const vector<int>& cpus, cpu_set_t* cpu_set) {
+  CPU_ZERO(cpu_set);
+  for (int i = 0; i < cpus.size(); ++i) {
+    if (cpus[i] >= CPU_SETSIZE) {
+      return false;
+    }
+    CPU_SET(cpus[i], cpu_set);
+  }
+  return true;
+}
+#endif
+
+bool SetCurrentThreadAffinity(const vector<int>& cpus) {
+  if (cpus.empty()) {
+    return true;
+  }
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  return ToCpuSet(cpus, &cpu_set) &&
+      pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+  return false;
+#endif
+}
+
+vector<int> GetCurrentThreadAffinity() {
+  vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpu_set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+
+static boost::mutex affinity_mutex_;
+static vector<int> role_cpus_[ThreadAffinity::NUM_ROLES];
+static const char* role_names_[ThreadAffinity::NUM_ROLES] =
+    {"compute", "prefetch", "reader", "blas"};
+// The CPUs of the thread configuring the first role, before any is pinned:
+// those of the unrestricted roles.
+static bool allowed_cpus_known_ = false;
+static vector<int> allowed_cpus_;
+
+void ThreadAffinity::set_cpus(Role role, const vector<int>& cpus) {
+  CHECK_GE(role, 0);
+  CHECK_LT(role, NUM_ROLES);
+  boost::mutex::scoped_lock lock(affinity_mutex_);
+  if (!allowed_cpus_known_) {
+    allowed_cpus_ = GetCurrentThreadAffinity();
+    allowed_cpus_known_ = true;
+  }
+  role_cpus_[role] = cpus;
+}
+
+vector<int> ThreadAffinity::cpus(Role role) {
+  CHECK_GE(role, 0);
+  CHECK_LT(role, NUM_ROLES);
+  boost::mutex::scoped_lock lock(affinity_mutex_);
+  return role_cpus_[role];
+}
+
+void ThreadAffinity::Apply(Role role) {
+  vector<int> role_cpus = cpus(role);
+  if (role_cpus.empty()) {
+    // Threads inherit the CPUs of the thread starting them, which may be
+    // the pinned compute thread.
+    boost::mutex::scoped_lock lock(affinity_mutex_);
+    role_cpus = allowed_cpus_;
+  }
+  if (!SetCurrentThreadAffinity(role_cpus)) {
+    LOG(WARNING) << "Cannot pin the " << role_names_[role]
+                 << " thread to CPUs " << FormatCpuList(role_cpus);
+  }
+}
+
+void ThreadAffinity::PinBlasThreads() {
+  const vector<int> blas_cpus = cpus(BLAS);
+  if (blas_cpus.empty()) {
+    return;
+  }
+#if defined(USE_OPENBLAS) && defined(__linux__)
+  cpu_set_t cpu_set;
+  CHECK(ToCpuSet(blas_cpus, &cpu_set)) << "Invalid BLAS CPUs "
+      << FormatCpuList(blas_cpus);
+  openblas_set_num_threads(blas_cpus.size());
+  // The last thread index is the calling thread.
+  const int num_threads = openblas_get_num_threads();
+  for (int i = 0; i + 1 < num_threads; ++i) {
+    if (openblas_setaffinity(i, sizeof(cpu_set), &cpu_set) != 0) {
+      LOG(WARNING) << "Cannot pin the BLAS threads to CPUs "
+                   << FormatCpuList(blas_cpus);
+      return;
+    }
+  }
+#else
+  LOG(WARNING) << "Pinning the BLAS threads needs OpenBLAS on Linux; they "
+               << "keep their CPUs.";
+#endif
+}
+
+void ThreadAffinity::LogTopology() {
+  const vector<vector<int> > nodes = NumaNodeCpus();
+  LOG(INFO) << "CPU topology: " << nodes.size() << " NUMA node(s).";
+  for (int node = 0; node < nodes.size(); ++node) {
+    LOG(INFO) << "  node " << node << ": CPUs " << FormatCpuList(nodes[node]);
+  }
+  vector<vector<int> > all_cpus(NUM_ROLES);
+  for (int role = 0; role < NUM_ROLES; ++role) {
+    all_cpus[role] = cpus(static_cast<Role>(role));
+    if (all_cpus[role].empty()) {
+      LOG(INFO) << "  " << role_names_[role] << " threads: unpinned";
+      continue;
+    }
+    std::ostringstream role_nodes;
+    int num_role_nodes = 0;
+    for (int node = 0; node < nodes.size(); ++node) {
+      vector<int> shared;
+      std::set_intersection(all_cpus[role].begin(), all_cpus[role].end(),
+          nodes[node].begin(), nodes[node].end(), std::back_inserter(shared));
+      if (!shared.empty()) {
+        role_nodes << (num_role_nodes++ ? "," : "") << node;
+      }
+    }
+    LOG(INFO) << "  " << role_names_[role] << " threads: CPUs "
+              << FormatCpuList(all_cpus[role]) << " on node(s) "
+              << role_nodes.str();
+    if (role == COMPUTE && num_role_nodes > 1) {
+      LOG(WARNING) << "The compute CPUs span several NUMA nodes; blobs will "
+                   << "be spread over them.";
+    }
+  }
+  for (int role = 0; role < NUM_ROLES; ++role) {
+    for (int other = role + 1; other < NUM_ROLES; ++other) {
+      vector<int> shared;
+      std::set_intersection(all_cpus[role].begin(), all_cpus[role].end(),
+          all_cpus[other].begin(), all_cpus[other].end(),
+          std::back_inserter(shared));
+      LOG_IF(WARNING, !shared.empty()) << "The " << role_names_[role]
+          << " and " << role_names_[other] << " threads share CPUs "
+          << FormatCpuList(shared);
+    }
+  }
+}
+
+}  // namespace caffe
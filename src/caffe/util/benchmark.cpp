@@ -1,5 +1,9 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include "caffe/common.hpp"
 #include "caffe/util/benchmark.hpp"
 
@@ -165,4 +169,13 @@ float CPUTimer::MicroSeconds() {
   return this->elapsed_microseconds_;
 }
 
+double Percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0.;
+  }
+  int rank = static_cast<int>(std::ceil(p / 100. * sorted.size())) - 1;
+  rank = std::max(0, std::min(rank, static_cast<int>(sorted.size()) - 1));
+  return sorted[rank];
+}
+
 }  // namespace caffe
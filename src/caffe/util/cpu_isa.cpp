@@ -0,0 +1,165 @@
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "caffe/util/cpu_isa.hpp"
+
+// The AVX levels are compiled with GCC and clang on x86, whose target
+// pragmas build them into this file without building the rest of Caffe
+// for them.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && \
+    defined(__SSE2__)
+#define CAFFE_CPU_ISA_AVX
+#endif
+
+// Without contracting multiplies and adds to FMAs, which AVX-512 and
+// -march builds have, so that all levels round the same.
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace caffe {
+
+namespace generic {
+#ifdef __SSE2__
+#define CAFFE_SIMD_SSE2
+#endif
+#include "caffe/util/simd_kernels.hpp"
+#undef CAFFE_SIMD_SSE2
+#undef CAFFE_UTIL_SIMD_KERNELS_H_
+}  // namespace generic
+
+#ifdef CAFFE_CPU_ISA_AVX
+#ifdef __clang__
+#pragma clang attribute push(__attribute__((target("avx2"))), \
+                             apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+namespace avx2 {
+#define CAFFE_SIMD_AVX2
+#include "caffe/util/simd_kernels.hpp"  // NOLINT(build/include)
+#undef CAFFE_SIMD_AVX2
+#undef CAFFE_UTIL_SIMD_KERNELS_H_
+}  // namespace avx2
+#ifdef __clang__
+#pragma clang attribute pop
+#pragma clang attribute push(__attribute__((target("avx512f"))), \
+                             apply_to = function)
+#else
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+namespace avx512 {
+#define CAFFE_SIMD_AVX512
+#include "caffe/util/simd_kernels.hpp"  // NOLINT(build/include)
+#undef CAFFE_SIMD_AVX512
+#undef CAFFE_UTIL_SIMD_KERNELS_H_
+}  // namespace avx512
+#ifdef __clang__
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif  // CAFFE_CPU_ISA_AVX
+
+namespace {
+
+CpuIsa::Level DetectLevel() {
+#ifdef CAFFE_CPU_ISA_AVX
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return CpuIsa::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return CpuIsa::AVX2;
+  }
+#endif
+  return CpuIsa::GENERIC;
+}
+
+// The kernels of each level; those of levels not built are the generic ones.
+class KernelTable {
+ public:
+  KernelTable() : detected_(DetectLevel()), level_(detected_) {
+    for (int i = 0; i < CpuIsa::NUM_LEVELS; ++i) {
+      generic::GetKernels(&kernels_[i]);
+    }
+#ifdef CAFFE_CPU_ISA_AVX
+    avx2::GetKernels(&kernels_[CpuIsa::AVX2]);
+    avx512::GetKernels(&kernels_[CpuIsa::AVX512]);
+#endif
+  }
+
+  CpuKernels kernels_[CpuIsa::NUM_LEVELS];
+  const CpuIsa::Level detected_;
+  CpuIsa::Level level_;
+};
+
+KernelTable& Table() {
+  static KernelTable table;
+  return table;
+}
+
+}  // namespace
+
+CpuIsa::Level CpuIsa::Detected() {
+  return Table().detected_;
+}
+
+CpuIsa::Level CpuIsa::level() {
+  return Table().level_;
+}
+
+void CpuIsa::set_level(Level level) {
+  CHECK(Supported(level)) << "The CPU or the build does not support "
+      << Name(level) << "; the best supported level is " << Name(Detected());
+  Table().level_ = level;
+  LOG(INFO) << "Using the " << Name(level) << " CPU kernels.";
+}
+
+const CpuKernels& CpuIsa::kernels(Level level) {
+  CHECK_GE(level, GENERIC);
+  CHECK_LT(level, NUM_LEVELS);
+  return Table().kernels_[level];
+}
+
+string CpuIsa::Name(Level level) {
+  switch (level) {
+  case GENERIC:
+    return "generic";
+  case AVX2:
+    return "avx2";
+  case AVX512:
+    return "avx512";
+  default:
+    LOG(FATAL) << "Unknown CPU ISA level " << level;
+  }
+  return "";
+}
+
+CpuIsa::Level CpuIsa::FromName(const string& name) {
+  if (name == "auto") {
+    return Detected();
+  }
+  for (int i = 0; i < NUM_LEVELS; ++i) {
+    if (name == Name(static_cast<Level>(i))) {
+      return static_cast<Level>(i);
+    }
+  }
+  LOG(FATAL) << "Unknown CPU ISA " << name
+             << "; use auto, generic, avx2 or avx512.";
+  return GENERIC;
+}
+
+}  // namespace caffe
@@ -0,0 +1,98 @@
+#include <boost/thread.hpp>
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/data_benchmark.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/profiler.hpp"
+
+namespace caffe {
+
+// One instance of the data layer with its top blobs.
+struct DataLayerInstance {
+  shared_ptr<Layer<float> > layer;
+  vector<shared_ptr<Blob<float> > > top_blobs;
+  vector<Blob<float>*> top;
+  vector<Blob<float>*> bottom;
+  int images;
+  double forward_us;
+};
+
+static void Drain(DataLayerInstance* instance, int batches) {
+  CPUTimer timer;
+  for (int i = 0; i < batches; ++i) {
+    timer.Start();
+    instance->layer->Forward(instance->bottom, instance->top);
+    instance->forward_us += timer.MicroSeconds();
+    instance->images += instance->top[0]->num_axes() > 0 ?
+        instance->top[0]->shape(0) : 1;
+  }
+}
+
+DataBenchmarkResult BenchmarkDataLayer(const LayerParameter& param,
+    int num_instances, int warmup, int iterations) {
+  CHECK_GT(num_instances, 0) << "Need at least one layer instance.";
+  CHECK_GE(warmup, 0) << "The number of warm-up batches is negative.";
+  CHECK_GT(iterations, 0) << "Need at least one batch to time.";
+  vector<DataLayerInstance> instances(num_instances);
+  for (int i = 0; i < num_instances; ++i) {
+    DataLayerInstance& instance = instances[i];
+    // A DataReader is shared by the layers of the same name and source, and
+    // only serves as many of them as there are solvers; give every instance
+    // a name of its own so that it gets a reader of its own.
+    LayerParameter instance_param(param);
+    if (num_instances > 1) {
+      instance_param.set_name(param.name() + "_" + format_int(i));
+    }
+    instance.layer = LayerRegistry<float>::CreateLayer(instance_param);
+    for (int j = 0; j < param.top_size(); ++j) {
+      instance.top_blobs.push_back(
+          shared_ptr<Blob<float> >(new Blob<float>()));
+      instance.top.push_back(instance.top_blobs.back().get());
+    }
+    instance.layer->SetUp(instance.bottom, instance.top);
+    instance.images = 0;
+    instance.forward_us = 0;
+    Drain(&instance, warmup);
+    instance.images = 0;
+    instance.forward_us = 0;
+  }
+  // Forget the events of the set up and warm-up.
+  vector<ProfileEvent> events;
+  Profiler& profiler = Profiler::Get();
+  profiler.Drain(&events);
+
+  CPUTimer timer;
+  timer.Start();
+  vector<shared_ptr<boost::thread> > threads;
+  for (int i = 0; i < num_instances; ++i) {
+    threads.push_back(shared_ptr<boost::thread>(new boost::thread(
+        &Drain, &instances[i], iterations)));
+  }
+  for (int i = 0; i < num_instances; ++i) {
+    threads[i]->join();
+  }
+  DataBenchmarkResult result;
+  result.seconds = timer.MicroSeconds() / 1e6;
+  profiler.Drain(&events);
+
+  result.batches = num_instances * iterations;
+  result.images = 0;
+  result.forward_us = 0;
+  for (int i = 0; i < num_instances; ++i) {
+    result.images += instances[i].images;
+    result.forward_us += instances[i].forward_us;
+  }
+  for (int i = 0; i < events.size(); ++i) {
+    result.category_us[events[i].category] += events[i].duration_us;
+    ++result.category_count[events[i].category];
+  }
+  return result;
+}
+
+}  // namespace caffe
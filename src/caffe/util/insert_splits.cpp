@@ -1,8 +1,9 @@
+#include <boost/unordered_map.hpp>
 #include <algorithm>
-#include <map>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "caffe/common.hpp"
 #include "caffe/util/insert_splits.hpp"
@@ -10,29 +11,39 @@
 namespace caffe {
 
 void InsertSplits(const NetParameter& param, NetParameter* param_split) {
-  // Initialize by copying from the input NetParameter.
+  // Initialize by copying from the input NetParameter, taking its layers out
+  // to move them back in order as the split layers are inserted.
   param_split->CopyFrom(param);
-  param_split->clear_layer();
-  map<string, pair<int, int> > blob_name_to_last_top_idx;
-  map<pair<int, int>, pair<int, int> > bottom_idx_to_source_top_idx;
-  map<pair<int, int>, int> top_idx_to_bottom_count;
-  map<pair<int, int>, float> top_idx_to_loss_weight;
-  map<pair<int, int>, int> top_idx_to_bottom_split_idx;
-  map<int, string> layer_idx_to_layer_name;
+  vector<LayerParameter*> layers(param.layer_size());
+  if (param.layer_size() > 0) {
+    param_split->mutable_layer()->ExtractSubrange(0, param.layer_size(),
+        &layers[0]);
+  }
+  // The counts and weights of the tops, and the sources of the bottoms, are
+  // indexed by layer then by top or bottom.
+  boost::unordered_map<string, pair<int, int> > blob_name_to_last_top_idx;
+  vector<vector<pair<int, int> > > bottom_idx_to_source_top_idx(
+      param.layer_size());
+  vector<vector<int> > top_idx_to_bottom_count(param.layer_size());
+  vector<vector<float> > top_idx_to_loss_weight(param.layer_size());
+  vector<vector<int> > top_idx_to_bottom_split_idx(param.layer_size());
   for (int i = 0; i < param.layer_size(); ++i) {
     const LayerParameter& layer_param = param.layer(i);
-    layer_idx_to_layer_name[i] = layer_param.name();
+    bottom_idx_to_source_top_idx[i].resize(layer_param.bottom_size());
+    top_idx_to_bottom_count[i].resize(layer_param.top_size(), 0);
+    top_idx_to_loss_weight[i].resize(layer_param.top_size(), 0);
+    top_idx_to_bottom_split_idx[i].resize(layer_param.top_size(), 0);
     for (int j = 0; j < layer_param.bottom_size(); ++j) {
       const string& blob_name = layer_param.bottom(j);
-      if (blob_name_to_last_top_idx.find(blob_name) ==
-          blob_name_to_last_top_idx.end()) {
+      boost::unordered_map<string, pair<int, int> >::const_iterator top =
+          blob_name_to_last_top_idx.find(blob_name);
+      if (top == blob_name_to_last_top_idx.end()) {
         LOG(FATAL) << "Unknown bottom blob '" << blob_name << "' (layer '"
                    << layer_param.name() << "', bottom index " << j << ")";
       }
-      const pair<int, int>& bottom_idx = make_pair(i, j);
-      const pair<int, int>& top_idx = blob_name_to_last_top_idx[blob_name];
-      bottom_idx_to_source_top_idx[bottom_idx] = top_idx;
-      ++top_idx_to_bottom_count[top_idx];
+      const pair<int, int>& top_idx = top->second;
+      bottom_idx_to_source_top_idx[i][j] = top_idx;
+      ++top_idx_to_bottom_count[top_idx.first][top_idx.second];
     }
     for (int j = 0; j < layer_param.top_size(); ++j) {
       const string& blob_name = layer_param.top(j);
@@ -45,42 +56,44 @@ void InsertSplits(const NetParameter& param, NetParameter* param_split) {
     for (int j = 0; j < last_loss; ++j) {
       const string& blob_name = layer_param.top(j);
       const pair<int, int>& top_idx = blob_name_to_last_top_idx[blob_name];
-      top_idx_to_loss_weight[top_idx] = layer_param.loss_weight(j);
-      if (top_idx_to_loss_weight[top_idx]) {
-        ++top_idx_to_bottom_count[top_idx];
+      float& loss_weight =
+          top_idx_to_loss_weight[top_idx.first][top_idx.second];
+      loss_weight = layer_param.loss_weight(j);
+      if (loss_weight) {
+        ++top_idx_to_bottom_count[top_idx.first][top_idx.second];
       }
     }
   }
   for (int i = 0; i < param.layer_size(); ++i) {
-    LayerParameter* layer_param = param_split->add_layer();
-    layer_param->CopyFrom(param.layer(i));
+    LayerParameter* layer_param = layers[i];
+    param_split->mutable_layer()->AddAllocated(layer_param);
     // Replace any shared bottom blobs with split layer outputs.
     for (int j = 0; j < layer_param->bottom_size(); ++j) {
-      const pair<int, int>& top_idx =
-          bottom_idx_to_source_top_idx[make_pair(i, j)];
-      const int split_count = top_idx_to_bottom_count[top_idx];
+      const pair<int, int>& top_idx = bottom_idx_to_source_top_idx[i][j];
+      const int split_count =
+          top_idx_to_bottom_count[top_idx.first][top_idx.second];
       if (split_count > 1) {
-        const string& layer_name = layer_idx_to_layer_name[top_idx.first];
+        const string& layer_name = param.layer(top_idx.first).name();
         const string& blob_name = layer_param->bottom(j);
-        layer_param->set_bottom(j, SplitBlobName(layer_name,
-            blob_name, top_idx.second, top_idx_to_bottom_split_idx[top_idx]++));
+        layer_param->set_bottom(j, SplitBlobName(layer_name, blob_name,
+            top_idx.second,
+            top_idx_to_bottom_split_idx[top_idx.first][top_idx.second]++));
       }
     }
     // Create split layer for any top blobs used by other layer as bottom
     // blobs more than once.
     for (int j = 0; j < layer_param->top_size(); ++j) {
-      const pair<int, int>& top_idx = make_pair(i, j);
-      const int split_count = top_idx_to_bottom_count[top_idx];
+      const int split_count = top_idx_to_bottom_count[i][j];
       if (split_count > 1) {
-        const string& layer_name = layer_idx_to_layer_name[i];
+        const string& layer_name = param.layer(i).name();
         const string& blob_name = layer_param->top(j);
         LayerParameter* split_layer_param = param_split->add_layer();
-        const float loss_weight = top_idx_to_loss_weight[top_idx];
+        const float loss_weight = top_idx_to_loss_weight[i][j];
         ConfigureSplitLayer(layer_name, blob_name, j, split_count,
             loss_weight, split_layer_param);
         if (loss_weight) {
           layer_param->clear_loss_weight();
-          top_idx_to_bottom_split_idx[top_idx]++;
+          top_idx_to_bottom_split_idx[i][j]++;
         }
       }
     }
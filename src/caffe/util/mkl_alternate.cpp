@@ -0,0 +1,266 @@
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/cpu_isa.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Threads running the element-wise functions on chunks of large arrays.
+// The calling thread takes the first chunk and the workers the others; one
+// caller uses the threads at a time, and any other runs on its own.
+class MathThreads {
+ public:
+  static MathThreads& Get() {
+    // Never destroyed: the workers may outlive static destruction.
+    static MathThreads* threads = new MathThreads();
+    return *threads;
+  }
+
+  // The number of threads sharing an array, the calling one included.
+  int size() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return workers_.size() + 1;
+  }
+
+  void Resize(int size) {
+    boost::mutex::scoped_lock run(run_mutex_);
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stop_ = true;
+    }
+    start_.notify_all();
+    for (int i = 0; i < workers_.size(); ++i) {
+      workers_[i]->join();
+      delete workers_[i];
+    }
+    workers_.clear();
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = false;
+    for (int i = 1; i < size; ++i) {
+      workers_.push_back(new boost::thread(&MathThreads::Work, this, i,
+          generation_));
+    }
+  }
+
+  // Runs kernel(begin, end) over [0, n) in num_chunks chunks, or returns
+  // false if the threads are busy.
+  bool TryRun(int n, int num_chunks,
+      const boost::function<void(int, int)>& kernel) {
+    boost::mutex::scoped_lock run(run_mutex_, boost::try_to_lock);
+    if (!run.owns_lock()) {
+      return false;
+    }
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      num_chunks = std::min<int>(num_chunks, workers_.size() + 1);
+      if (num_chunks < 2) {
+        return false;
+      }
+      kernel_ = &kernel;
+      n_ = n;
+      num_chunks_ = num_chunks;
+      pending_ = workers_.size();
+      ++generation_;
+    }
+    start_.notify_all();
+    kernel(0, ChunkBegin(1));
+    boost::mutex::scoped_lock lock(mutex_);
+    while (pending_ > 0) {
+      done_.wait(lock);
+    }
+    return true;
+  }
+
+ private:
+  MathThreads()
+      : stop_(false), generation_(0), pending_(0), kernel_(NULL), n_(0),
+        num_chunks_(0) {}
+
+  // Chunks start on 16 elements, the cache line of floats, so that no two
+  // threads write the same line.
+  int ChunkBegin(int chunk) const {
+    const int chunk_size = ((n_ + num_chunks_ - 1) / num_chunks_ + 15) & ~15;
+    return std::min(n_, chunk * chunk_size);
+  }
+
+  void Work(int chunk, uint64_t generation) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (true) {
+      while (!stop_ && generation_ == generation) {
+        start_.wait(lock);
+      }
+      if (stop_) {
+        return;
+      }
+      generation = generation_;
+      if (chunk < num_chunks_) {
+        const boost::function<void(int, int)>& kernel = *kernel_;
+        const int begin = ChunkBegin(chunk);
+        const int end = ChunkBegin(chunk + 1);
+        lock.unlock();
+        kernel(begin, end);
+        lock.lock();
+      }
+      if (--pending_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+
+  boost::mutex run_mutex_;
+  boost::mutex mutex_;
+  boost::condition_variable start_;
+  boost::condition_variable done_;
+  vector<boost::thread*> workers_;
+  bool stop_;
+  uint64_t generation_;
+  int pending_;
+  const boost::function<void(int, int)>* kernel_;
+  int n_;
+  int num_chunks_;
+};
+
+// The fewest elements worth handing to another thread.
+const int kMinChunk = 1 << 15;
+
+// Runs kernel(begin, end) over [0, n), on several threads if n is large.
+template <typename Kernel>
+void ParallelFor(int n, const Kernel& kernel) {
+  if (n < 2 * kMinChunk || !MathThreads::Get().TryRun(n, n / kMinChunk,
+      boost::function<void(int, int)>(kernel))) {
+    kernel(0, n);
+  }
+}
+
+template <typename Dtype>
+void ScalarExp(const Dtype* a, Dtype* y, int begin, int end) {
+  for (int i = begin; i < end; ++i) { y[i] = std::exp(a[i]); }
+}
+
+template <typename Dtype>
+void ScalarLn(const Dtype* a, Dtype* y, int begin, int end) {
+  for (int i = begin; i < end; ++i) { y[i] = std::log(a[i]); }
+}
+
+template <typename Dtype>
+void ScalarPowx(const Dtype* a, const float b, Dtype* y, int begin,
+    int end) {
+  for (int i = begin; i < end; ++i) { y[i] = std::pow(a[i], Dtype(b)); }
+}
+
+}  // namespace
+
+void caffe_set_cpu_math_threads(const int threads) {
+  CHECK_GE(threads, 1) << "Need at least the calling thread.";
+  MathThreads::Get().Resize(threads);
+}
+
+int caffe_cpu_math_threads() {
+  return MathThreads::Get().size();
+}
+
+template <>
+void caffe_cpu_normalize_bytes<float>(const int n, const uint8_t* x,
+    const float* mean, const float mean_value, const float scale, float* y) {
+  ParallelFor(n, boost::bind(CpuIsa::kernels().NormalizeBytes, x, mean,
+                             mean_value, scale, y, _1, _2));
+}
+
+template <>
+void caffe_cpu_normalize_bytes<double>(const int n, const uint8_t* x,
+    const double* mean, const double mean_value, const double scale,
+    double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = (static_cast<double>(x[i]) - (mean ? mean[i] : mean_value)) *
+        scale;
+  }
+}
+
+}  // namespace caffe
+
+#ifndef USE_MKL
+
+using caffe::CpuIsa;
+using caffe::CpuKernels;
+using caffe::ParallelFor;
+
+// The kernels of the instruction set level of CpuIsa.
+#define DEFINE_VSL_BINARY_FUNC(name) \
+  void vs##name(const int n, const float* a, const float* b, float* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(b); CHECK(y); \
+    ParallelFor(n, boost::bind(CpuIsa::kernels().vs##name, a, b, y, _1, \
+                               _2)); \
+  } \
+  void vd##name(const int n, const double* a, const double* b, double* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(b); CHECK(y); \
+    ParallelFor(n, boost::bind(CpuIsa::kernels().vd##name, a, b, y, _1, \
+                               _2)); \
+  }
+
+DEFINE_VSL_BINARY_FUNC(Add)
+DEFINE_VSL_BINARY_FUNC(Sub)
+DEFINE_VSL_BINARY_FUNC(Mul)
+DEFINE_VSL_BINARY_FUNC(Div)
+
+#define DEFINE_VSL_UNARY_FUNC(name) \
+  void vs##name(const int n, const float* a, float* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    ParallelFor(n, boost::bind(CpuIsa::kernels().vs##name, a, y, _1, _2)); \
+  } \
+  void vd##name(const int n, const double* a, double* y) { \
+    CHECK_GT(n, 0); CHECK(a); CHECK(y); \
+    ParallelFor(n, boost::bind(CpuIsa::kernels().vd##name, a, y, _1, _2)); \
+  }
+
+DEFINE_VSL_UNARY_FUNC(Sqr)
+DEFINE_VSL_UNARY_FUNC(Abs)
+
+// exp and log are approximated for floats only; doubles keep libm.
+void vsExp(const int n, const float* a, float* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  ParallelFor(n, boost::bind(CpuIsa::kernels().vsExp, a, y, _1, _2));
+}
+
+void vdExp(const int n, const double* a, double* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  ParallelFor(n, boost::bind(&caffe::ScalarExp<double>, a, y, _1, _2));
+}
+
+void vsLn(const int n, const float* a, float* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  ParallelFor(n, boost::bind(CpuIsa::kernels().vsLn, a, y, _1, _2));
+}
+
+void vdLn(const int n, const double* a, double* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  ParallelFor(n, boost::bind(&caffe::ScalarLn<double>, a, y, _1, _2));
+}
+
+void vsPowx(const int n, const float* a, const float b, float* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  if (CpuKernels::PowxVectorized(b)) {
+    ParallelFor(n, boost::bind(CpuIsa::kernels().vsPowx, a, b, y, _1, _2));
+  } else {
+    ParallelFor(n, boost::bind(&caffe::ScalarPowx<float>, a, b, y, _1, _2));
+  }
+}
+
+void vdPowx(const int n, const double* a, const float b, double* y) {
+  CHECK_GT(n, 0); CHECK(a); CHECK(y);
+  if (CpuKernels::PowxVectorized(b)) {
+    ParallelFor(n, boost::bind(CpuIsa::kernels().vdPowx, a, b, y, _1, _2));
+  } else {
+    ParallelFor(n, boost::bind(&caffe::ScalarPowx<double>, a, b, y, _1, _2));
+  }
+}
+
+#endif  // USE_MKL
@@ -0,0 +1,172 @@
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread.hpp>
+#include <unistd.h>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/util/profiler.hpp"
+
+namespace caffe {
+
+// Small, stable per-thread ids for the trace viewer's rows.
+static boost::thread_specific_ptr<int> thread_id_;
+static boost::atomic<int> next_thread_id_(0);
+
+static int ThreadId() {
+  if (!thread_id_.get()) {
+    thread_id_.reset(new int(next_thread_id_.fetch_add(1)));
+  }
+  return *thread_id_;
+}
+
+class Profiler::Ring {
+ public:
+  // A slot's sequence number is 2 * index + 1 while the event of that write
+  // index is being written, and 2 * index + 2 once it is complete.
+  struct Slot {
+    boost::atomic<uint64_t> seq;
+    ProfileEvent event;
+  };
+
+  explicit Ring(int capacity)
+      : capacity_(capacity), slots_(new Slot[capacity]), write_index_(0),
+        read_index_(0),
+        origin_(boost::posix_time::microsec_clock::universal_time()) {
+    for (int i = 0; i < capacity; ++i) {
+      slots_[i].seq.store(0, boost::memory_order_relaxed);
+    }
+  }
+
+  const uint64_t capacity_;
+  boost::scoped_array<Slot> slots_;
+  boost::atomic<uint64_t> write_index_;
+  // Only touched by the draining thread.
+  uint64_t read_index_;
+  const boost::posix_time::ptime origin_;
+};
+
+Profiler& Profiler::Get() {
+  static Profiler instance;
+  return instance;
+}
+
+Profiler::Profiler()
+    : enabled_(false), iter_(0), dropped_(0), ring_() { }
+
+Profiler::~Profiler() { }
+
+void Profiler::Enable(int capacity) {
+  CHECK_GT(capacity, 0) << "The profiler needs room for at least one event.";
+  ring_.reset(new Ring(capacity));
+  dropped_ = 0;
+  enabled_.store(true, boost::memory_order_release);
+  LOG(INFO) << "Profiling enabled with room for " << capacity << " events.";
+}
+
+void Profiler::Disable() {
+  enabled_.store(false, boost::memory_order_release);
+  ring_.reset();
+}
+
+int64_t Profiler::NowMicros() const {
+  if (!ring_) {
+    return 0;
+  }
+  return (boost::posix_time::microsec_clock::universal_time() -
+          ring_->origin_).total_microseconds();
+}
+
+void Profiler::Record(const char* name, const char* category,
+    int64_t start_us, int64_t duration_us) {
+  if (!enabled()) {
+    return;
+  }
+  Ring* ring = ring_.get();
+  const uint64_t index =
+      ring->write_index_.fetch_add(1, boost::memory_order_relaxed);
+  Ring::Slot& slot = ring->slots_[index % ring->capacity_];
+  slot.seq.store(2 * index + 1, boost::memory_order_relaxed);
+  boost::atomic_thread_fence(boost::memory_order_release);
+  slot.event.name = name;
+  slot.event.category = category;
+  slot.event.start_us = start_us;
+  slot.event.duration_us = duration_us;
+  slot.event.iter = iter_.load(boost::memory_order_relaxed);
+  slot.event.thread_id = ThreadId();
+  slot.seq.store(2 * index + 2, boost::memory_order_release);
+}
+
+void Profiler::Drain(vector<ProfileEvent>* events) {
+  events->clear();
+  if (!ring_) {
+    return;
+  }
+  Ring* ring = ring_.get();
+  const uint64_t end = ring->write_index_.load(boost::memory_order_acquire);
+  uint64_t begin = ring->read_index_;
+  if (end - begin > ring->capacity_) {
+    dropped_ += end - begin - ring->capacity_;
+    begin = end - ring->capacity_;
+  }
+  events->reserve(end - begin);
+  for (uint64_t i = begin; i < end; ++i) {
+    Ring::Slot& slot = ring->slots_[i % ring->capacity_];
+    const uint64_t seq = slot.seq.load(boost::memory_order_acquire);
+    if (seq != 2 * i + 2) {
+      // Still being written, or already overwritten by a newer event.
+      ++dropped_;
+      continue;
+    }
+    const ProfileEvent event = slot.event;
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    if (slot.seq.load(boost::memory_order_relaxed) != seq) {
+      ++dropped_;
+      continue;
+    }
+    events->push_back(event);
+  }
+  ring->read_index_ = end;
+}
+
+static string JsonEscape(const char* str) {
+  string escaped;
+  for (const char* c = str; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      escaped += '\\';
+    }
+    escaped += *c;
+  }
+  return escaped;
+}
+
+int Profiler::ExportChromeTrace(const string& filename) {
+  vector<ProfileEvent> events;
+  Drain(&events);
+  std::ofstream output(filename.c_str());
+  if (!output.good()) {
+    LOG(WARNING) << "Cannot write profile to " << filename;
+    return 0;
+  }
+  const int pid = getpid();
+  output << "{\"traceEvents\": [";
+  for (int i = 0; i < events.size(); ++i) {
+    const ProfileEvent& event = events[i];
+    output << (i ? ",\n" : "\n")
+           << "{\"name\": \"" << JsonEscape(event.name)
+           << "\", \"cat\": \"" << JsonEscape(event.category)
+           << "\", \"ph\": \"X\", \"ts\": " << event.start_us
+           << ", \"dur\": " << event.duration_us
+           << ", \"pid\": " << pid << ", \"tid\": " << event.thread_id
+           << ", \"args\": {\"iter\": " << event.iter << "}}";
+  }
+  output << "\n], \"displayTimeUnit\": \"ms\", "
+         << "\"otherData\": {\"dropped_events\": " << dropped_ << "}}\n";
+  LOG(INFO) << "Wrote " << events.size() << " profile events to " << filename;
+  return events.size();
+}
+
+}  // namespace caffe
@@ -0,0 +1,273 @@
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread.hpp>
+#include <string>
+
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/ring_queue.hpp"
+
+namespace caffe {
+
+// How many times a blocked call retries before it parks. On a single CPU,
+// the other end cannot run while we spin, so parking right away is better.
+static int SpinCount() {
+  static const int count = boost::thread::hardware_concurrency() > 1 ? 1000 : 0;
+  return count;
+}
+
+template<typename T>
+class RingQueue<T>::Ring {
+ public:
+  // In MPMC mode, the sequence number of a slot tells whose turn it is: the
+  // producer of position pos once it is pos, the consumer once it is pos + 1.
+  struct Slot {
+    boost::atomic<uint64_t> seq;
+    T value;
+  };
+
+  Ring(int capacity, Mode mode)
+      : capacity_(capacity), mode_(mode), slots_(new Slot[capacity]),
+        head_(0), tail_cache_(0), tail_(0), head_cache_(0), parked_(0),
+        waits_(0), wait_us_(0) {
+    for (int i = 0; i < capacity; ++i) {
+      slots_[i].seq.store(i, boost::memory_order_relaxed);
+    }
+  }
+
+  bool TryPush(const T& t) {
+    if (mode_ == SPSC) {
+      const uint64_t tail = tail_.load(boost::memory_order_relaxed);
+      if (tail - head_cache_ == capacity_) {
+        head_cache_ = head_.load(boost::memory_order_acquire);
+        if (tail - head_cache_ == capacity_) {
+          return false;
+        }
+      }
+      slots_[tail % capacity_].value = t;
+      tail_.store(tail + 1, boost::memory_order_release);
+      return true;
+    }
+    uint64_t pos = tail_.load(boost::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots_[pos % capacity_];
+      const int64_t diff = static_cast<int64_t>(
+          slot.seq.load(boost::memory_order_acquire) - pos);
+      if (diff == 0) {
+        // On failure, the compare-and-swap reloads pos.
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        boost::memory_order_relaxed)) {
+          slot.value = t;
+          slot.seq.store(pos + 1, boost::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // full
+      } else {
+        pos = tail_.load(boost::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool TryPop(T* t, bool remove) {
+    if (mode_ == SPSC) {
+      const uint64_t head = head_.load(boost::memory_order_relaxed);
+      if (head == tail_cache_) {
+        tail_cache_ = tail_.load(boost::memory_order_acquire);
+        if (head == tail_cache_) {
+          return false;
+        }
+      }
+      *t = slots_[head % capacity_].value;
+      if (remove) {
+        head_.store(head + 1, boost::memory_order_release);
+      }
+      return true;
+    }
+    uint64_t pos = head_.load(boost::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots_[pos % capacity_];
+      const int64_t diff = static_cast<int64_t>(
+          slot.seq.load(boost::memory_order_acquire) - (pos + 1));
+      if (diff == 0) {
+        if (!remove) {
+          *t = slot.value;
+          return true;
+        }
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        boost::memory_order_relaxed)) {
+          *t = slot.value;
+          slot.seq.store(pos + capacity_, boost::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // empty
+      } else {
+        pos = head_.load(boost::memory_order_relaxed);
+      }
+    }
+  }
+
+  size_t Size() const {
+    const uint64_t head = head_.load(boost::memory_order_acquire);
+    const uint64_t tail = tail_.load(boost::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+
+  // Wakes up the parked callers, if any, after the ring changed.
+  void Notify() {
+    // Pairs with the fence in Wait: either the parking thread sees the
+    // change when it retries, or this sees it parked.
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if (parked_.load(boost::memory_order_relaxed) > 0) {
+      // Parking threads hold the mutex from their last retry until they
+      // wait, so once we have had it they can be notified.
+      { boost::mutex::scoped_lock lock(mutex_); }
+      condition_.notify_all();
+    }
+  }
+
+  // Retries attempt until it succeeds, spinning then parking.
+  template<typename Attempt>
+  void Wait(Attempt attempt, const string& log_on_wait) {
+    const boost::posix_time::ptime start =
+        boost::posix_time::microsec_clock::universal_time();
+    bool done = false;
+    const int spin_count = SpinCount();
+    for (int i = 0; i < spin_count && !done; ++i) {
+      done = attempt();
+    }
+    if (!done) {
+      boost::mutex::scoped_lock lock(mutex_);
+      Parked parked(&parked_);
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+      while (!attempt()) {
+        if (!log_on_wait.empty()) {
+          LOG_EVERY_N(INFO, 1000)<< log_on_wait;
+        }
+        condition_.wait(lock);
+      }
+    }
+    waits_.fetch_add(1, boost::memory_order_relaxed);
+    wait_us_.fetch_add((boost::posix_time::microsec_clock::universal_time() -
+        start).total_microseconds(), boost::memory_order_relaxed);
+  }
+
+  // Counts a parked thread for as long as it is in scope, even if its wait
+  // is interrupted.
+  class Parked {
+   public:
+    explicit Parked(boost::atomic<int>* count) : count_(count) {
+      count_->fetch_add(1);
+    }
+    ~Parked() { count_->fetch_sub(1); }
+
+   private:
+    boost::atomic<int>* count_;
+  };
+
+  const uint64_t capacity_;
+  const Mode mode_;
+  boost::scoped_array<Slot> slots_;
+  // The consumer and producer ends, on separate cache lines. The caches are
+  // the SPSC producer's and consumer's last view of the other end.
+  char pad0_[64];
+  boost::atomic<uint64_t> head_;
+  uint64_t tail_cache_;
+  char pad1_[64];
+  boost::atomic<uint64_t> tail_;
+  uint64_t head_cache_;
+  char pad2_[64];
+  boost::atomic<int> parked_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  boost::atomic<uint64_t> waits_;
+  boost::atomic<uint64_t> wait_us_;
+};
+
+template<typename T>
+RingQueue<T>::RingQueue(int capacity, Mode mode) {
+  CHECK_GT(capacity, 0) << "A queue needs room for an item.";
+  ring_.reset(new Ring(capacity, mode));
+}
+
+// The blocking calls retry on the ring itself, and notify once they are no
+// longer parked.
+template<typename T>
+void RingQueue<T>::push(const T& t) {
+  if (!ring_->TryPush(t)) {
+    ring_->Wait(boost::bind(&Ring::TryPush, ring_.get(), boost::cref(t)), "");
+  }
+  ring_->Notify();
+}
+
+template<typename T>
+bool RingQueue<T>::try_push(const T& t) {
+  if (!ring_->TryPush(t)) {
+    return false;
+  }
+  ring_->Notify();
+  return true;
+}
+
+template<typename T>
+bool RingQueue<T>::try_pop(T* t) {
+  if (!ring_->TryPop(t, true)) {
+    return false;
+  }
+  ring_->Notify();
+  return true;
+}
+
+template<typename T>
+T RingQueue<T>::pop(const string& log_on_wait) {
+  T t;
+  if (!ring_->TryPop(&t, true)) {
+    ring_->Wait(boost::bind(&Ring::TryPop, ring_.get(), &t, true),
+        log_on_wait);
+  }
+  ring_->Notify();
+  return t;
+}
+
+template<typename T>
+bool RingQueue<T>::try_peek(T* t) {
+  return ring_->TryPop(t, false);
+}
+
+template<typename T>
+T RingQueue<T>::peek() {
+  T t;
+  if (!try_peek(&t)) {
+    ring_->Wait(boost::bind(&Ring::TryPop, ring_.get(), &t, false), "");
+  }
+  return t;
+}
+
+template<typename T>
+size_t RingQueue<T>::size() const {
+  return ring_->Size();
+}
+
+template<typename T>
+int RingQueue<T>::capacity() const {
+  return ring_->capacity_;
+}
+
+template<typename T>
+uint64_t RingQueue<T>::waits() const {
+  return ring_->waits_.load(boost::memory_order_relaxed);
+}
+
+template<typename T>
+uint64_t RingQueue<T>::wait_us() const {
+  return ring_->wait_us_.load(boost::memory_order_relaxed);
+}
+
+template class RingQueue<Batch<float>*>;
+template class RingQueue<Batch<double>*>;
+template class RingQueue<Datum*>;
+
+}  // namespace caffe
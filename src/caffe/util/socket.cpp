@@ -0,0 +1,39 @@
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "caffe/util/socket.hpp"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace caffe {
+
+bool ReadAll(int fd, void* data, size_t size) {
+  char* bytes = static_cast<char*>(data);
+  while (size > 0) {
+    const ssize_t n = read(fd, bytes, size);
+    if (n <= 0) {
+      return false;
+    }
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool WriteAll(int fd, const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    const ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+}  // namespace caffe
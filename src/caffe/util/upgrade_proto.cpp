@@ -88,6 +88,13 @@ void ReadNetParamsFromBinaryFileOrDie(const string& param_file,
   UpgradeNetAsNeeded(param_file, param);
 }
 
+bool IsCompiledNetFile(const string& param_file) {
+  const string suffix = ".caffenet";
+  return param_file.size() >= suffix.size() &&
+      param_file.compare(param_file.size() - suffix.size(), suffix.size(),
+                         suffix) == 0;
+}
+
 bool NetNeedsV0ToV1Upgrade(const NetParameter& net_param) {
   for (int i = 0; i < net_param.layers_size(); ++i) {
     if (net_param.layers(i).has_layer()) {
@@ -6,18 +6,25 @@ namespace bp = boost::python;
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iostream>  // NOLINT(readability/streams)
 #include <map>
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/util/affinity.hpp"
+#include "caffe/util/cpu_isa.hpp"
 #include "caffe/util/signal_handler.h"
 
 using caffe::Blob;
 using caffe::Caffe;
 using caffe::Net;
+using caffe::Percentile;
 using caffe::Layer;
 using caffe::Solver;
 using caffe::shared_ptr;
@@ -54,6 +61,50 @@ DEFINE_string(sigint_effect, "stop",
 DEFINE_string(sighup_effect, "snapshot",
              "Optional; action to take when a SIGHUP signal is received: "
              "snapshot, stop or none.");
+DEFINE_int32(warmup, 1,
+    "Optional; the number of untimed warm-up iterations run by 'time'.");
+DEFINE_bool(forward_only, false,
+    "Optional; only time the forward pass. Implied by '-phase TEST'.");
+DEFINE_string(time_format, "",
+    "Optional; also report 'time' results as 'json' or 'csv'.");
+DEFINE_string(time_output, "",
+    "Optional; file to write the 'time' report to. Defaults to stdout.");
+DEFINE_string(compute_cpus, "",
+    "Optional; CPUs (e.g. '0-7,16-23') running the net and holding its "
+    "memory. Best kept on one NUMA node.");
+DEFINE_string(prefetch_cpus, "",
+    "Optional; CPUs running the prefetch threads of the data layers.");
+DEFINE_string(reader_cpus, "",
+    "Optional; CPUs running the database reader threads of the data layers.");
+DEFINE_string(blas_cpus, "",
+    "Optional; CPUs running the BLAS threads, one thread each. Needs "
+    "OpenBLAS on Linux.");
+DEFINE_int32(math_threads, 1,
+    "Optional; threads sharing the element-wise math of large blobs in CPU "
+    "mode, e.g. caffe_exp, when Caffe is built without MKL.");
+DEFINE_string(cpu_isa, "auto",
+    "Optional; the instruction set of the CPU kernels: auto, generic, avx2 "
+    "or avx512. auto takes the best the CPU supports.");
+
+// Pins the threads to the CPUs given by the flags. The main thread is pinned
+// right away, before any net exists, so that the blobs it first touches are
+// allocated on its NUMA node. The BLAS threads already run by then and are
+// pinned on their own.
+static void set_thread_affinity() {
+  caffe::ThreadAffinity::set_cpus(caffe::ThreadAffinity::COMPUTE,
+      caffe::ParseCpuList(FLAGS_compute_cpus));
+  caffe::ThreadAffinity::set_cpus(caffe::ThreadAffinity::PREFETCH,
+      caffe::ParseCpuList(FLAGS_prefetch_cpus));
+  caffe::ThreadAffinity::set_cpus(caffe::ThreadAffinity::READER,
+      caffe::ParseCpuList(FLAGS_reader_cpus));
+  caffe::ThreadAffinity::set_cpus(caffe::ThreadAffinity::BLAS,
+      caffe::ParseCpuList(FLAGS_blas_cpus));
+  caffe::ThreadAffinity::LogTopology();
+  caffe::ThreadAffinity::Apply(caffe::ThreadAffinity::COMPUTE);
+  caffe::ThreadAffinity::PinBlasThreads();
+  // Started from the pinned main thread, the math threads share its CPUs.
+  caffe::caffe_set_cpu_math_threads(FLAGS_math_threads);
+}
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -330,11 +381,186 @@ int test() {
 RegisterBrewFunction(test);
 
 
+// Summary statistics of a series of timings, in milliseconds.
+struct TimeStats {
+  double mean;
+  double stddev;
+  double min;
+  double p50;
+  double p90;
+  double p99;
+  double max;
+};
+
+static TimeStats compute_time_stats(const vector<double>& samples) {
+  TimeStats stats = {0., 0., 0., 0., 0., 0., 0.};
+  if (samples.empty()) {
+    return stats;
+  }
+  vector<double> sorted(samples);
+  std::sort(sorted.begin(), sorted.end());
+  double sum = 0.;
+  for (int i = 0; i < sorted.size(); ++i) {
+    sum += sorted[i];
+  }
+  stats.mean = sum / sorted.size();
+  double sq_sum = 0.;
+  for (int i = 0; i < sorted.size(); ++i) {
+    sq_sum += (sorted[i] - stats.mean) * (sorted[i] - stats.mean);
+  }
+  stats.stddev = std::sqrt(sq_sum / sorted.size());
+  stats.min = sorted.front();
+  stats.p50 = Percentile(sorted, 50.);
+  stats.p90 = Percentile(sorted, 90.);
+  stats.p99 = Percentile(sorted, 99.);
+  stats.max = sorted.back();
+  return stats;
+}
+
+// Rough work estimate of one layer pass, used to derive the achieved
+// GFLOP/s and GB/s. These are analytic counts from the blob shapes, not
+// measurements: multiply-adds count as two FLOPs, and the bytes are the
+// blobs a pass has to read or write at least once.
+struct LayerCost {
+  double forward_flops;
+  double backward_flops;
+  double forward_bytes;
+  double backward_bytes;
+};
+
+static LayerCost estimate_layer_cost(Layer<float>* layer,
+    const vector<Blob<float>*>& bottom, const vector<Blob<float>*>& top) {
+  double bottom_count = 0.;
+  double top_count = 0.;
+  double param_count = 0.;
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom_count += bottom[i]->count();
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    top_count += top[i]->count();
+  }
+  const vector<shared_ptr<Blob<float> > >& params = layer->blobs();
+  for (int i = 0; i < params.size(); ++i) {
+    param_count += params[i]->count();
+  }
+  const string type = layer->type();
+  double flops = top_count;
+  bool has_weight_gradient = false;
+  if ((type == "Convolution" || type == "Deconvolution" ||
+       type == "InnerProduct") && params.size() > 0 && top.size() > 0) {
+    // Each output (input for deconvolution) of a filter is a dot product of
+    // length weight.count() / weight.shape(0).
+    const Blob<float>& weight = *params[0];
+    const double filter_size =
+        static_cast<double>(weight.count()) / weight.shape(0);
+    if (type == "Convolution") {
+      flops = 2. * top[0]->count() * filter_size;
+    } else if (type == "Deconvolution") {
+      flops = 2. * bottom[0]->count() * filter_size;
+    } else {
+      flops = 2. * top[0]->count() * weight.count() / top[0]->shape(-1);
+    }
+    if (params.size() > 1) {
+      flops += top[0]->count();
+    }
+    has_weight_gradient = true;
+  } else if (type == "Pooling" && top.size() > 0 && bottom.size() > 0) {
+    const caffe::PoolingParameter& pool_param =
+        layer->layer_param().pooling_param();
+    double kernel_area;
+    if (pool_param.global_pooling()) {
+      kernel_area = bottom[0]->count(2);
+    } else if (pool_param.has_kernel_size()) {
+      kernel_area = pool_param.kernel_size() * pool_param.kernel_size();
+    } else {
+      kernel_area = pool_param.kernel_h() * pool_param.kernel_w();
+    }
+    flops = top[0]->count() * kernel_area;
+  }
+  const double dtype_size = sizeof(float);
+  LayerCost cost;
+  cost.forward_flops = flops;
+  // Backward computes the bottom gradient and, for layers with weights, the
+  // weight gradient, each costing about as much as the forward pass.
+  cost.backward_flops = has_weight_gradient ? 2. * flops : flops;
+  cost.forward_bytes = (bottom_count + top_count + param_count) * dtype_size;
+  cost.backward_bytes =
+      (2. * bottom_count + top_count + 2. * param_count) * dtype_size;
+  return cost;
+}
+
+// Throughput in G units per second of `amount` done in `milliseconds`.
+static double giga_per_second(double amount, double milliseconds) {
+  return milliseconds > 0. ? amount / (milliseconds * 1e6) : 0.;
+}
+
+static void write_json_stats(std::ostream* os, const TimeStats& stats) {
+  *os << "{\"mean_ms\": " << stats.mean
+      << ", \"stddev_ms\": " << stats.stddev
+      << ", \"min_ms\": " << stats.min
+      << ", \"p50_ms\": " << stats.p50
+      << ", \"p90_ms\": " << stats.p90
+      << ", \"p99_ms\": " << stats.p99
+      << ", \"max_ms\": " << stats.max << "}";
+}
+
+static void write_json_pass(std::ostream* os, const TimeStats& stats,
+    double flops, double bytes) {
+  *os << "{\"time\": ";
+  write_json_stats(os, stats);
+  *os << ", \"gflop\": " << flops / 1e9
+      << ", \"gbyte\": " << bytes / 1e9
+      << ", \"gflop_per_s\": " << giga_per_second(flops, stats.mean)
+      << ", \"gbyte_per_s\": " << giga_per_second(bytes, stats.mean) << "}";
+}
+
+static string json_escape(const string& str) {
+  string escaped;
+  for (int i = 0; i < str.size(); ++i) {
+    if (str[i] == '"' || str[i] == '\\') {
+      escaped += '\\';
+    }
+    escaped += str[i];
+  }
+  return escaped;
+}
+
+// Quotes a CSV field, doubling the quotes in it, as in RFC 4180.
+static string csv_quote(const string& str) {
+  string quoted = "\"";
+  for (int i = 0; i < str.size(); ++i) {
+    if (str[i] == '"') {
+      quoted += '"';
+    }
+    quoted += str[i];
+  }
+  return quoted + "\"";
+}
+
+static void write_csv_row(std::ostream* os, const string& name,
+    const string& type, const string& pass, const TimeStats& stats,
+    double flops, double bytes) {
+  // Layer and net names may hold commas and quotes.
+  *os << csv_quote(name) << "," << type << "," << pass << ","
+      << stats.mean << "," << stats.stddev << "," << stats.min << ","
+      << stats.p50 << "," << stats.p90 << "," << stats.p99 << ","
+      << stats.max << "," << flops / 1e9 << "," << bytes / 1e9 << ","
+      << giga_per_second(flops, stats.mean) << ","
+      << giga_per_second(bytes, stats.mean) << "\n";
+}
+
 // Time: benchmark the execution time of a model.
 int time() {
   CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to time.";
+  CHECK_GT(FLAGS_iterations, 0) << "Need at least one iteration to time.";
+  CHECK_GE(FLAGS_warmup, 0) << "The number of warm-up iterations is negative.";
+  CHECK(FLAGS_time_format == "" || FLAGS_time_format == "json" ||
+        FLAGS_time_format == "csv")
+      << "time_format must be \"json\" or \"csv\"";
   caffe::Phase phase = get_phase_from_flags(caffe::TRAIN);
   vector<string> stages = get_stages_from_flags();
+  // The TEST phase net does not learn, so only its forward pass is timed.
+  const bool forward_only = FLAGS_forward_only || phase == caffe::TEST;
 
   // Set device id and mode
   vector<int> gpus;
@@ -350,16 +576,21 @@ int time() {
   // Instantiate the caffe net.
   Net<float> caffe_net(FLAGS_model, phase, FLAGS_level, &stages);
 
-  // Do a clean forward and backward pass, so that memory allocation are done
+  // Do clean forward and backward passes, so that memory allocation are done
   // and future iterations will be more stable.
-  LOG(INFO) << "Performing Forward";
   // Note that for the speed benchmark, we will assume that the network does
   // not take any input blobs.
-  float initial_loss;
-  caffe_net.Forward(&initial_loss);
-  LOG(INFO) << "Initial loss: " << initial_loss;
-  LOG(INFO) << "Performing Backward";
-  caffe_net.Backward();
+  LOG(INFO) << "Performing " << FLAGS_warmup << " warm-up iterations";
+  for (int j = 0; j < FLAGS_warmup; ++j) {
+    float initial_loss;
+    caffe_net.Forward(&initial_loss);
+    if (j == 0) {
+      LOG(INFO) << "Initial loss: " << initial_loss;
+    }
+    if (!forward_only) {
+      caffe_net.Backward();
+    }
+  }
 
   const vector<shared_ptr<Layer<float> > >& layers = caffe_net.layers();
   const vector<vector<Blob<float>*> >& bottom_vecs = caffe_net.bottom_vecs();
@@ -367,16 +598,19 @@ int time() {
   const vector<vector<bool> >& bottom_need_backward =
       caffe_net.bottom_need_backward();
   LOG(INFO) << "*** Benchmark begins ***";
-  LOG(INFO) << "Testing for " << FLAGS_iterations << " iterations.";
+  LOG(INFO) << "Testing for " << FLAGS_iterations << " iterations"
+            << (forward_only ? " (forward only)." : ".");
   Timer total_timer;
   total_timer.Start();
   Timer forward_timer;
   Timer backward_timer;
   Timer timer;
-  std::vector<double> forward_time_per_layer(layers.size(), 0.0);
-  std::vector<double> backward_time_per_layer(layers.size(), 0.0);
-  double forward_time = 0.0;
-  double backward_time = 0.0;
+  // Per-iteration samples in milliseconds, indexed by [layer][iteration].
+  vector<vector<double> > forward_time_per_layer(layers.size());
+  vector<vector<double> > backward_time_per_layer(layers.size());
+  vector<double> forward_time;
+  vector<double> backward_time;
+  vector<double> iter_time;
   for (int j = 0; j < FLAGS_iterations; ++j) {
     Timer iter_timer;
     iter_timer.Start();
@@ -384,39 +618,153 @@ int time() {
     for (int i = 0; i < layers.size(); ++i) {
       timer.Start();
       layers[i]->Forward(bottom_vecs[i], top_vecs[i]);
-      forward_time_per_layer[i] += timer.MicroSeconds();
+      forward_time_per_layer[i].push_back(timer.MicroSeconds() / 1000.);
     }
-    forward_time += forward_timer.MicroSeconds();
-    backward_timer.Start();
-    for (int i = layers.size() - 1; i >= 0; --i) {
-      timer.Start();
-      layers[i]->Backward(top_vecs[i], bottom_need_backward[i],
-                          bottom_vecs[i]);
-      backward_time_per_layer[i] += timer.MicroSeconds();
+    forward_time.push_back(forward_timer.MicroSeconds() / 1000.);
+    if (!forward_only) {
+      backward_timer.Start();
+      for (int i = layers.size() - 1; i >= 0; --i) {
+        timer.Start();
+        layers[i]->Backward(top_vecs[i], bottom_need_backward[i],
+                            bottom_vecs[i]);
+        backward_time_per_layer[i].push_back(timer.MicroSeconds() / 1000.);
+      }
+      backward_time.push_back(backward_timer.MicroSeconds() / 1000.);
     }
-    backward_time += backward_timer.MicroSeconds();
-    LOG(INFO) << "Iteration: " << j + 1 << " forward-backward time: "
-      << iter_timer.MilliSeconds() << " ms.";
+    iter_time.push_back(iter_timer.MicroSeconds() / 1000.);
+    LOG(INFO) << "Iteration: " << j + 1
+      << (forward_only ? " forward time: " : " forward-backward time: ")
+      << iter_time.back() << " ms.";
   }
+  total_timer.Stop();
+
+  vector<TimeStats> forward_stats(layers.size());
+  vector<TimeStats> backward_stats(layers.size());
+  vector<LayerCost> costs(layers.size());
+  LayerCost net_cost = {0., 0., 0., 0.};
   LOG(INFO) << "Average time per layer: ";
   for (int i = 0; i < layers.size(); ++i) {
+    forward_stats[i] = compute_time_stats(forward_time_per_layer[i]);
+    backward_stats[i] = compute_time_stats(backward_time_per_layer[i]);
+    costs[i] = estimate_layer_cost(layers[i].get(), bottom_vecs[i],
+        top_vecs[i]);
+    net_cost.forward_flops += costs[i].forward_flops;
+    net_cost.backward_flops += costs[i].backward_flops;
+    net_cost.forward_bytes += costs[i].forward_bytes;
+    net_cost.backward_bytes += costs[i].backward_bytes;
     const caffe::string& layername = layers[i]->layer_param().name();
     LOG(INFO) << std::setfill(' ') << std::setw(10) << layername <<
-      "\tforward: " << forward_time_per_layer[i] / 1000 /
-      FLAGS_iterations << " ms.";
-    LOG(INFO) << std::setfill(' ') << std::setw(10) << layername  <<
-      "\tbackward: " << backward_time_per_layer[i] / 1000 /
+      "\tforward: " << forward_stats[i].mean << " ms" <<
+      " (stddev " << forward_stats[i].stddev <<
+      ", p50 " << forward_stats[i].p50 <<
+      ", p90 " << forward_stats[i].p90 <<
+      ", p99 " << forward_stats[i].p99 << "), " <<
+      giga_per_second(costs[i].forward_flops, forward_stats[i].mean) <<
+      " GFLOP/s, " <<
+      giga_per_second(costs[i].forward_bytes, forward_stats[i].mean) <<
+      " GB/s.";
+    if (!forward_only) {
+      LOG(INFO) << std::setfill(' ') << std::setw(10) << layername <<
+        "\tbackward: " << backward_stats[i].mean << " ms" <<
+        " (stddev " << backward_stats[i].stddev <<
+        ", p50 " << backward_stats[i].p50 <<
+        ", p90 " << backward_stats[i].p90 <<
+        ", p99 " << backward_stats[i].p99 << "), " <<
+        giga_per_second(costs[i].backward_flops, backward_stats[i].mean) <<
+        " GFLOP/s, " <<
+        giga_per_second(costs[i].backward_bytes, backward_stats[i].mean) <<
+        " GB/s.";
+    }
+  }
+  const TimeStats forward_total = compute_time_stats(forward_time);
+  const TimeStats backward_total = compute_time_stats(backward_time);
+  const TimeStats iter_total = compute_time_stats(iter_time);
+  LOG(INFO) << "Average Forward pass: " << forward_total.mean << " ms"
+    << " (stddev " << forward_total.stddev << ", p50 " << forward_total.p50
+    << ", p90 " << forward_total.p90 << ", p99 " << forward_total.p99
+    << ").";
+  if (!forward_only) {
+    LOG(INFO) << "Average Backward pass: " << backward_total.mean << " ms"
+      << " (stddev " << backward_total.stddev << ", p50 "
+      << backward_total.p50 << ", p90 " << backward_total.p90 << ", p99 "
+      << backward_total.p99 << ").";
+    LOG(INFO) << "Average Forward-Backward: " << total_timer.MilliSeconds() /
       FLAGS_iterations << " ms.";
   }
-  total_timer.Stop();
-  LOG(INFO) << "Average Forward pass: " << forward_time / 1000 /
-    FLAGS_iterations << " ms.";
-  LOG(INFO) << "Average Backward pass: " << backward_time / 1000 /
-    FLAGS_iterations << " ms.";
-  LOG(INFO) << "Average Forward-Backward: " << total_timer.MilliSeconds() /
-    FLAGS_iterations << " ms.";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
   LOG(INFO) << "*** Benchmark ends ***";
+
+  if (FLAGS_time_format.empty()) {
+    return 0;
+  }
+  std::ofstream output_file;
+  if (FLAGS_time_output.size()) {
+    output_file.open(FLAGS_time_output.c_str());
+    CHECK(output_file.is_open()) << "Failed to open " << FLAGS_time_output;
+  }
+  std::ostream* os = FLAGS_time_output.size() ? &output_file : &std::cout;
+  const double iter_flops = net_cost.forward_flops +
+      (forward_only ? 0. : net_cost.backward_flops);
+  const double iter_bytes = net_cost.forward_bytes +
+      (forward_only ? 0. : net_cost.backward_bytes);
+  if (FLAGS_time_format == "json") {
+    *os << "{\n  \"net\": \"" << json_escape(caffe_net.name()) << "\",\n"
+        << "  \"phase\": \"" << (phase == caffe::TRAIN ? "TRAIN" : "TEST")
+        << "\",\n"
+        << "  \"mode\": \"" << (gpus.size() ? "GPU" : "CPU") << "\",\n"
+        << "  \"iterations\": " << FLAGS_iterations << ",\n"
+        << "  \"warmup\": " << FLAGS_warmup << ",\n"
+        << "  \"forward_only\": " << (forward_only ? "true" : "false")
+        << ",\n  \"layers\": [";
+    for (int i = 0; i < layers.size(); ++i) {
+      *os << (i ? ",\n" : "\n") << "    {\"name\": \""
+          << json_escape(layers[i]->layer_param().name())
+          << "\", \"type\": \"" << json_escape(layers[i]->type())
+          << "\",\n     \"forward\": ";
+      write_json_pass(os, forward_stats[i], costs[i].forward_flops,
+          costs[i].forward_bytes);
+      if (!forward_only) {
+        *os << ",\n     \"backward\": ";
+        write_json_pass(os, backward_stats[i], costs[i].backward_flops,
+            costs[i].backward_bytes);
+      }
+      *os << "}";
+    }
+    *os << "\n  ],\n  \"net_forward\": ";
+    write_json_pass(os, forward_total, net_cost.forward_flops,
+        net_cost.forward_bytes);
+    if (!forward_only) {
+      *os << ",\n  \"net_backward\": ";
+      write_json_pass(os, backward_total, net_cost.backward_flops,
+          net_cost.backward_bytes);
+    }
+    *os << ",\n  \"net_iteration\": ";
+    write_json_pass(os, iter_total, iter_flops, iter_bytes);
+    *os << "\n}\n";
+  } else {
+    *os << "layer,type,pass,mean_ms,stddev_ms,min_ms,p50_ms,p90_ms,p99_ms,"
+        << "max_ms,gflop,gbyte,gflop_per_s,gbyte_per_s\n";
+    for (int i = 0; i < layers.size(); ++i) {
+      const string& name = layers[i]->layer_param().name();
+      write_csv_row(os, name, layers[i]->type(), "forward", forward_stats[i],
+          costs[i].forward_flops, costs[i].forward_bytes);
+      if (!forward_only) {
+        write_csv_row(os, name, layers[i]->type(), "backward",
+            backward_stats[i], costs[i].backward_flops,
+            costs[i].backward_bytes);
+      }
+    }
+    // Net-level totals use the net name and an empty layer type.
+    write_csv_row(os, caffe_net.name(), "", "forward", forward_total,
+        net_cost.forward_flops, net_cost.forward_bytes);
+    if (!forward_only) {
+      write_csv_row(os, caffe_net.name(), "", "backward", backward_total,
+          net_cost.backward_flops, net_cost.backward_bytes);
+    }
+    write_csv_row(os, caffe_net.name(), "", "iteration", iter_total,
+        iter_flops, iter_bytes);
+  }
+  os->flush();
   return 0;
 }
 RegisterBrewFunction(time);
@@ -437,6 +785,8 @@ int main(int argc, char** argv) {
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
   if (argc == 2) {
+    set_thread_affinity();
+    caffe::CpuIsa::set_level(caffe::CpuIsa::FromName(FLAGS_cpu_isa));
 #ifdef WITH_PYTHON_LAYER
     try {
 #endif
@@ -0,0 +1,84 @@
+// This program compiles a net definition for deployment: it upgrades the net,
+// filters its layers for the given state, inserts the splits and records the
+// shapes of the tops, and writes the result as a binary proto that Net and
+// InferenceSession load without redoing any of it.
+// Usage:
+//    compile_net -model deploy.prototxt -output deploy.caffenet
+//        [-phase TEST] [-level 0] [-stage a,b]
+//
+// The output should end in ".caffenet", by which it is recognized when given
+// in place of a prototxt. It is tied to the shapes of the inputs of the net
+// and to the layers of the library that compiled it: Net checks that its
+// layers set up the recorded shapes, and the net is to be compiled again
+// when they do not.
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using caffe::Caffe;
+using caffe::Net;
+using caffe::NetParameter;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_string(model, "",
+    "The net definition protocol buffer text file.");
+DEFINE_string(output, "",
+    "The compiled net to write, ending in .caffenet.");
+DEFINE_string(phase, "TEST",
+    "The phase to compile the net for: TRAIN or TEST.");
+DEFINE_int32(level, 0,
+    "The level to compile the net for.");
+DEFINE_string(stage, "",
+    "Optional; the stages to compile the net for, separated by ','.");
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Compile a net definition for deployment.\n"
+      "Usage:\n"
+      "    compile_net -model NET_PROTOTXT -output NET_CAFFENET\n");
+  caffe::GlobalInit(&argc, &argv);
+  if (FLAGS_model.empty() || FLAGS_output.empty()) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/compile_net");
+    return 1;
+  }
+  CHECK(FLAGS_phase == "TRAIN" || FLAGS_phase == "TEST")
+      << "Unknown phase " << FLAGS_phase;
+  LOG_IF(WARNING, !caffe::IsCompiledNetFile(FLAGS_output))
+      << FLAGS_output << " does not end in .caffenet; Net will read it as "
+      << "a prototxt.";
+  Caffe::set_mode(Caffe::CPU);
+
+  NetParameter param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  param.mutable_state()->set_phase(
+      FLAGS_phase == "TRAIN" ? caffe::TRAIN : caffe::TEST);
+  param.mutable_state()->set_level(FLAGS_level);
+  if (!FLAGS_stage.empty()) {
+    vector<string> stages;
+    boost::split(stages, FLAGS_stage, boost::is_any_of(","));
+    for (int i = 0; i < stages.size(); ++i) {
+      param.mutable_state()->add_stage(stages[i]);
+    }
+  }
+  NetParameter compiled;
+  Net<float>::Compile(param, &compiled);
+
+  // Set the net up once to record the shapes of its tops.
+  Net<float> net(compiled);
+  net.RecordTopShapes(&compiled);
+  caffe::WriteProtoToBinaryFile(compiled, FLAGS_output);
+  LOG(INFO) << "Wrote " << compiled.layer_size() << " layers and "
+            << compiled.top_shape_size() << " top shapes of " << FLAGS_model
+            << " to " << FLAGS_output;
+  return 0;
+}
@@ -1,16 +1,21 @@
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
 
@@ -20,6 +25,141 @@ using boost::scoped_ptr;
 
 DEFINE_string(backend, "lmdb",
         "The backend {leveldb, lmdb} containing the images");
+DEFINE_string(image_list, "",
+    "Optional; read the images from a list instead of a DB, one per line "
+    "as the image path followed by anything else, e.g. the keypoint labels "
+    "of a HeatmapDataLayer source. INPUT_DB is then ignored and may be "
+    "omitted by passing '-'.");
+DEFINE_string(root_folder, "",
+    "The folder the paths of -image_list are relative to.");
+DEFINE_int32(resize_width, 0, "Width images of -image_list are resized to");
+DEFINE_int32(resize_height, 0, "Height images of -image_list are resized to");
+DEFINE_bool(gray, false, "Read the images of -image_list as grayscale");
+DEFINE_bool(rgb, false,
+    "Store the color channels in RGB order, as HeatmapDataLayer reads them, "
+    "instead of the BGR order of the DB and list images.");
+DEFINE_double(sample, 1.0,
+    "The fraction of the images, picked at random, to compute the "
+    "statistics over.");
+DEFINE_int32(threads, 0,
+    "The number of threads decoding and summing the images; 0 for the "
+    "number of cores.");
+DEFINE_string(channel_stats, "",
+    "Optional; text file to write the per-channel mean and standard "
+    "deviation to, one channel per line.");
+
+#ifdef USE_OPENCV
+// The number of DB records or list entries handed to a thread at once.
+const int kChunkSize = 64;
+
+// Serialized Datums, or image paths, shared out to the threads in chunks.
+// An empty chunk tells a thread to stop.
+class ChunkQueue {
+ public:
+  explicit ChunkQueue(int capacity) : capacity_(capacity) {}
+  void push(const std::vector<std::string>& chunk) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (chunks_.size() >= capacity_) {
+      not_full_.wait(lock);
+    }
+    chunks_.push_back(chunk);
+    not_empty_.notify_one();
+  }
+  void pop(std::vector<std::string>* chunk) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (chunks_.empty()) {
+      not_empty_.wait(lock);
+    }
+    chunk->swap(chunks_.front());
+    chunks_.pop_front();
+    not_full_.notify_one();
+  }
+
+ private:
+  const int capacity_;
+  std::deque<std::vector<std::string> > chunks_;
+  boost::mutex mutex_;
+  boost::condition_variable not_empty_;
+  boost::condition_variable not_full_;
+};
+
+// The partial sums of one thread, in double precision.
+struct ImageStats {
+  ImageStats() : channels(0), height(0), width(0), count(0) {}
+  int channels, height, width;
+  int count;
+  std::vector<double> sum;
+  std::vector<double> channel_sum;
+  std::vector<double> channel_sum_sq;
+};
+
+static void Accumulate(const Datum& datum, ImageStats* stats) {
+  const std::string& data = datum.data();
+  const int size_in_datum = std::max<int>(datum.data().size(),
+      datum.float_data_size());
+  if (stats->count == 0) {
+    stats->channels = datum.channels();
+    stats->height = datum.height();
+    stats->width = datum.width();
+    stats->sum.assign(size_in_datum, 0.);
+    stats->channel_sum.assign(stats->channels, 0.);
+    stats->channel_sum_sq.assign(stats->channels, 0.);
+  }
+  CHECK_EQ(datum.channels(), stats->channels) << "Inconsistent channels";
+  CHECK_EQ(size_in_datum, stats->sum.size()) << "Incorrect data field size "
+      << size_in_datum;
+  const int channels = stats->channels;
+  const int dim = size_in_datum / channels;
+  for (int c = 0; c < channels; ++c) {
+    // Reversing the channels turns BGR into RGB.
+    const int src_c = (FLAGS_rgb && channels == 3) ? channels - 1 - c : c;
+    double* sum = &stats->sum[c * dim];
+    double channel_sum = 0, channel_sum_sq = 0;
+    if (data.size() != 0) {
+      const uint8_t* pixels =
+          reinterpret_cast<const uint8_t*>(data.data()) + src_c * dim;
+      for (int i = 0; i < dim; ++i) {
+        const double value = pixels[i];
+        sum[i] += value;
+        channel_sum += value;
+        channel_sum_sq += value * value;
+      }
+    } else {
+      const float* pixels = datum.float_data().data() + src_c * dim;
+      for (int i = 0; i < dim; ++i) {
+        const double value = pixels[i];
+        sum[i] += value;
+        channel_sum += value;
+        channel_sum_sq += value * value;
+      }
+    }
+    stats->channel_sum[c] += channel_sum;
+    stats->channel_sum_sq[c] += channel_sum_sq;
+  }
+  ++stats->count;
+}
+
+static void SumImages(ChunkQueue* queue, bool from_list, ImageStats* stats) {
+  std::vector<std::string> chunk;
+  Datum datum;
+  for (queue->pop(&chunk); !chunk.empty(); queue->pop(&chunk)) {
+    for (int i = 0; i < chunk.size(); ++i) {
+      if (from_list) {
+        if (!ReadImageToDatum(FLAGS_root_folder + chunk[i], 0,
+                FLAGS_resize_height, FLAGS_resize_width, !FLAGS_gray,
+                &datum)) {
+          LOG(WARNING) << "Skipping unreadable image " << chunk[i];
+          continue;
+        }
+      } else {
+        datum.ParseFromString(chunk[i]);
+        DecodeDatumNative(&datum);
+      }
+      Accumulate(datum, stats);
+    }
+  }
+}
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
   ::google::InitGoogleLogging(argv[0]);
@@ -30,7 +170,7 @@ int main(int argc, char** argv) {
 #endif
 
   gflags::SetUsageMessage("Compute the mean_image of a set of images given by"
-        " a leveldb/lmdb\n"
+        " a leveldb/lmdb or an image list\n"
         "Usage:\n"
         "    compute_image_mean [FLAGS] INPUT_DB [OUTPUT_FILE]\n");
 
@@ -40,81 +180,127 @@ int main(int argc, char** argv) {
     gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/compute_image_mean");
     return 1;
   }
+  CHECK(FLAGS_sample > 0 && FLAGS_sample <= 1)
+      << "The sampled fraction must be in (0, 1].";
+  const int num_threads = FLAGS_threads > 0 ? FLAGS_threads :
+      max<int>(boost::thread::hardware_concurrency(), 1);
+  const bool from_list = !FLAGS_image_list.empty();
 
-  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
-  db->Open(argv[1], db::READ);
-  scoped_ptr<db::Cursor> cursor(db->NewCursor());
-
-  BlobProto sum_blob;
-  int count = 0;
-  // load first datum
-  Datum datum;
-  datum.ParseFromString(cursor->value());
-
-  if (DecodeDatumNative(&datum)) {
-    LOG(INFO) << "Decoding Datum";
-  }
-
-  sum_blob.set_num(1);
-  sum_blob.set_channels(datum.channels());
-  sum_blob.set_height(datum.height());
-  sum_blob.set_width(datum.width());
-  const int data_size = datum.channels() * datum.height() * datum.width();
-  int size_in_datum = std::max<int>(datum.data().size(),
-                                    datum.float_data_size());
-  for (int i = 0; i < size_in_datum; ++i) {
-    sum_blob.add_data(0.);
+  // The threads parse, decode and sum the images; this one reads them in.
+  ChunkQueue queue(4 * num_threads);
+  std::vector<ImageStats> thread_stats(num_threads);
+  boost::thread_group threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.create_thread(
+        boost::bind(&SumImages, &queue, from_list, &thread_stats[i]));
   }
-  LOG(INFO) << "Starting Iteration";
-  while (cursor->valid()) {
-    Datum datum;
-    datum.ParseFromString(cursor->value());
-    DecodeDatumNative(&datum);
-
-    const std::string& data = datum.data();
-    size_in_datum = std::max<int>(datum.data().size(),
-        datum.float_data_size());
-    CHECK_EQ(size_in_datum, data_size) << "Incorrect data field size " <<
-        size_in_datum;
-    if (data.size() != 0) {
-      CHECK_EQ(data.size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) + (uint8_t)data[i]);
+  LOG(INFO) << "Starting Iteration with " << num_threads << " threads";
+  std::vector<std::string> chunk;
+  int num_read = 0;
+  float draw;
+  if (from_list) {
+    std::ifstream infile(FLAGS_image_list.c_str());
+    CHECK(infile.good()) << "Cannot read " << FLAGS_image_list;
+    std::string line;
+    while (std::getline(infile, line)) {
+      const size_t end = line.find_first_of(" \t");
+      const std::string path = line.substr(0, end);
+      if (path.empty()) {
+        continue;
       }
-    } else {
-      CHECK_EQ(datum.float_data_size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) +
-            static_cast<float>(datum.float_data(i)));
+      caffe_rng_uniform<float>(1, 0, 1, &draw);
+      if (draw < FLAGS_sample) {
+        chunk.push_back(path);
+      }
+      if (chunk.size() == kChunkSize) {
+        queue.push(chunk);
+        chunk.clear();
+      }
+      if (++num_read % 10000 == 0) {
+        LOG(INFO) << "Read " << num_read << " files.";
       }
     }
-    ++count;
-    if (count % 10000 == 0) {
-      LOG(INFO) << "Processed " << count << " files.";
+  } else {
+    scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+    db->Open(argv[1], db::READ);
+    scoped_ptr<db::Cursor> cursor(db->NewCursor());
+    for (; cursor->valid(); cursor->Next()) {
+      caffe_rng_uniform<float>(1, 0, 1, &draw);
+      if (draw < FLAGS_sample) {
+        chunk.push_back(cursor->value());
+      }
+      if (chunk.size() == kChunkSize) {
+        queue.push(chunk);
+        chunk.clear();
+      }
+      if (++num_read % 10000 == 0) {
+        LOG(INFO) << "Read " << num_read << " files.";
+      }
     }
-    cursor->Next();
   }
+  if (!chunk.empty()) {
+    queue.push(chunk);
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    queue.push(std::vector<std::string>());
+  }
+  threads.join_all();
 
-  if (count % 10000 != 0) {
-    LOG(INFO) << "Processed " << count << " files.";
+  // Reduce the partial sums.
+  ImageStats stats;
+  for (int i = 0; i < num_threads; ++i) {
+    const ImageStats& partial = thread_stats[i];
+    if (partial.count == 0) {
+      continue;
+    }
+    if (stats.count == 0) {
+      stats = partial;
+      continue;
+    }
+    CHECK_EQ(partial.sum.size(), stats.sum.size())
+        << "Incorrect data field size " << partial.sum.size();
+    caffe_axpy<double>(stats.sum.size(), 1., &partial.sum[0], &stats.sum[0]);
+    for (int c = 0; c < stats.channels; ++c) {
+      stats.channel_sum[c] += partial.channel_sum[c];
+      stats.channel_sum_sq[c] += partial.channel_sum_sq[c];
+    }
+    stats.count += partial.count;
   }
-  for (int i = 0; i < sum_blob.data_size(); ++i) {
-    sum_blob.set_data(i, sum_blob.data(i) / count);
+  const int count = stats.count;
+  CHECK_GT(count, 0) << "No images to compute the mean of.";
+  LOG(INFO) << "Processed " << count << " of " << num_read << " files.";
+
+  BlobProto sum_blob;
+  sum_blob.set_num(1);
+  sum_blob.set_channels(stats.channels);
+  sum_blob.set_height(stats.height);
+  sum_blob.set_width(stats.width);
+  for (int i = 0; i < stats.sum.size(); ++i) {
+    sum_blob.add_data(stats.sum[i] / count);
   }
   // Write to disk
   if (argc == 3) {
     LOG(INFO) << "Write to " << argv[2];
     WriteProtoToBinaryFile(sum_blob, argv[2]);
   }
-  const int channels = sum_blob.channels();
-  const int dim = sum_blob.height() * sum_blob.width();
-  std::vector<float> mean_values(channels, 0.0);
+  const int channels = stats.channels;
+  const double dim = static_cast<double>(stats.sum.size()) / channels * count;
+  std::ofstream stats_file;
+  if (!FLAGS_channel_stats.empty()) {
+    stats_file.open(FLAGS_channel_stats.c_str());
+    CHECK(stats_file.good()) << "Cannot write " << FLAGS_channel_stats;
+    stats_file << "# channel mean std\n";
+  }
   LOG(INFO) << "Number of channels: " << channels;
   for (int c = 0; c < channels; ++c) {
-    for (int i = 0; i < dim; ++i) {
-      mean_values[c] += sum_blob.data(dim * c + i);
+    const double mean = stats.channel_sum[c] / dim;
+    const double stddev = std::sqrt(
+        std::max(stats.channel_sum_sq[c] / dim - mean * mean, 0.));
+    LOG(INFO) << "mean_value channel [" << c << "]:" << mean;
+    LOG(INFO) << "std channel [" << c << "]:" << stddev;
+    if (stats_file.is_open()) {
+      stats_file << c << " " << mean << " " << stddev << "\n";
     }
-    LOG(INFO) << "mean_value channel [" << c << "]:" << mean_values[c] / dim;
   }
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
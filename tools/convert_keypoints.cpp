@@ -0,0 +1,168 @@
+// This program converts a set of images with keypoint annotations to a
+// lmdb/leveldb by storing them as Datum proto buffers with keypoints, for
+// KeypointDataLayer.
+// Usage:
+//   convert_keypoints [FLAGS] ROOTFOLDER/ LISTFILE DB_NAME
+//
+// where ROOTFOLDER is the root folder that holds all the images, and LISTFILE
+// should be a list of files as well as the comma-separated (x, y) pixel
+// coordinates of their keypoints, as the source of HeatmapDataLayer:
+//   subfolder1/file1.JPEG 12.5,30,40,22.5
+//   ....
+// Keypoints with a negative coordinate are stored as not visible.
+
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#endif  // USE_OPENCV
+
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/rng.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using std::pair;
+using boost::scoped_ptr;
+
+DEFINE_bool(gray, false,
+    "When this option is on, treat images as grayscale ones");
+DEFINE_bool(shuffle, false,
+    "Randomly shuffle the order of images and their keypoints");
+DEFINE_string(backend, "lmdb",
+        "The backend {lmdb, leveldb} for storing the result");
+DEFINE_int32(resize_width, 0,
+    "Width images are resized to; the keypoints are scaled along");
+DEFINE_int32(resize_height, 0,
+    "Height images are resized to; the keypoints are scaled along");
+DEFINE_bool(encoded, false,
+    "When this option is on, the encoded image will be save in datum");
+DEFINE_string(encode_type, "png",
+    "What type should we encode the image as ('png','jpg',...).");
+
+int main(int argc, char** argv) {
+#ifdef USE_OPENCV
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Convert a set of images with keypoints to the "
+        "leveldb/lmdb\n"
+        "format used as input for KeypointDataLayer.\n"
+        "Usage:\n"
+        "    convert_keypoints [FLAGS] ROOTFOLDER/ LISTFILE DB_NAME\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 4) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/convert_keypoints");
+    return 1;
+  }
+
+  std::ifstream infile(argv[2]);
+  std::vector<std::pair<std::string, std::vector<float> > > lines;
+  std::string img_name, labels;
+  while (infile >> img_name >> labels) {
+    std::vector<float> keypoints;
+    std::istringstream ss(labels);
+    std::string s;
+    while (std::getline(ss, s, ',')) {
+      keypoints.push_back(atof(s.c_str()));
+    }
+    CHECK_EQ(keypoints.size() % 2, 0) << "Odd number of coordinates for "
+        << img_name;
+    lines.push_back(std::make_pair(img_name, keypoints));
+  }
+  if (FLAGS_shuffle) {
+    // randomly shuffle data
+    LOG(INFO) << "Shuffling data";
+    shuffle(lines.begin(), lines.end());
+  }
+  LOG(INFO) << "A total of " << lines.size() << " images.";
+
+  const int resize_height = std::max<int>(0, FLAGS_resize_height);
+  const int resize_width = std::max<int>(0, FLAGS_resize_width);
+  CHECK((resize_height == 0) == (resize_width == 0))
+      << "Set both resize_height and resize_width, or none.";
+
+  // Create new DB
+  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+  db->Open(argv[3], db::NEW);
+  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+
+  // Storing to db
+  std::string root_folder(argv[1]);
+  Datum datum;
+  int count = 0;
+  for (int line_id = 0; line_id < lines.size(); ++line_id) {
+    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines[line_id].first,
+        !FLAGS_gray);
+    if (!cv_img.data) {
+      continue;
+    }
+    float scale_x = 1, scale_y = 1;
+    if (resize_height > 0) {
+      scale_x = static_cast<float>(resize_width) / cv_img.cols;
+      scale_y = static_cast<float>(resize_height) / cv_img.rows;
+      cv::Mat resized;
+      cv::resize(cv_img, resized, cv::Size(resize_width, resize_height));
+      cv_img = resized;
+    }
+    CVMatToDatum(cv_img, &datum);
+    if (FLAGS_encoded) {
+      std::vector<uchar> buf;
+      CHECK(cv::imencode("." + FLAGS_encode_type, cv_img, buf))
+          << "Cannot encode " << lines[line_id].first;
+      datum.set_data(std::string(reinterpret_cast<char*>(&buf[0]),
+                                 buf.size()));
+      datum.set_encoded(true);
+    }
+    const std::vector<float>& keypoints = lines[line_id].second;
+    datum.clear_keypoint();
+    datum.clear_keypoint_visible();
+    for (int k = 0; k < keypoints.size(); k += 2) {
+      datum.add_keypoint(scale_x * keypoints[k]);
+      datum.add_keypoint(scale_y * keypoints[k + 1]);
+      datum.add_keypoint_visible(keypoints[k] >= 0 && keypoints[k + 1] >= 0);
+    }
+    // sequential
+    string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
+
+    // Put in db
+    string out;
+    CHECK(datum.SerializeToString(&out));
+    txn->Put(key_str, out);
+
+    if (++count % 1000 == 0) {
+      // Commit db
+      txn->Commit();
+      txn.reset(db->NewTransaction());
+      LOG(INFO) << "Processed " << count << " files.";
+    }
+  }
+  // write the last batch
+  if (count % 1000 != 0) {
+    txn->Commit();
+    LOG(INFO) << "Processed " << count << " files.";
+  }
+#else
+  LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  return 0;
+}
@@ -0,0 +1,137 @@
+// This program measures how fast a data layer alone can produce batches.
+// Usage:
+//    data_benchmark -model net.prototxt [-layer name] [-threads 1,2,4]
+//
+// The data layer is taken from a net definition and run without the rest of
+// the net: its batches are drained as fast as possible, and the throughput
+// and the time spent reading (and decoding), transforming and waiting on the
+// prefetch queue are reported. With several thread counts, that many
+// independent instances of the layer run concurrently, each with its own
+// prefetch thread and consumer.
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "boost/lexical_cast.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/data_benchmark.hpp"
+#include "caffe/util/profiler.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using caffe::Caffe;
+using caffe::LayerParameter;
+using caffe::Net;
+using caffe::NetParameter;
+using caffe::Profiler;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_string(model, "",
+    "The net definition protocol buffer text file holding the data layer.");
+DEFINE_string(layer, "",
+    "Optional; the name of the data layer to benchmark. Defaults to the "
+    "first layer of the net.");
+DEFINE_string(phase, "TRAIN",
+    "Optional; the net phase (TRAIN or TEST) used to pick the layer.");
+DEFINE_int32(iterations, 100,
+    "The number of batches each layer instance produces.");
+DEFINE_int32(warmup, 5,
+    "The number of untimed batches each layer instance first produces.");
+DEFINE_string(threads, "1",
+    "Comma-separated numbers of concurrent layer instances to benchmark.");
+
+static LayerParameter GetLayerParameter() {
+  NetParameter param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  CHECK(FLAGS_phase == "TRAIN" || FLAGS_phase == "TEST")
+      << "phase must be \"TRAIN\" or \"TEST\"";
+  param.mutable_state()->set_phase(
+      FLAGS_phase == "TRAIN" ? caffe::TRAIN : caffe::TEST);
+  NetParameter filtered_param;
+  Net<float>::FilterNet(param, &filtered_param);
+  for (int i = 0; i < filtered_param.layer_size(); ++i) {
+    const LayerParameter& layer_param = filtered_param.layer(i);
+    if (FLAGS_layer.empty() || layer_param.name() == FLAGS_layer) {
+      CHECK_EQ(layer_param.bottom_size(), 0) << "Layer " << layer_param.name()
+          << " has bottom blobs, so it is not a data layer.";
+      LayerParameter result(layer_param);
+      result.set_phase(filtered_param.state().phase());
+      return result;
+    }
+  }
+  LOG(FATAL) << "No layer " << FLAGS_layer << " in " << FLAGS_model;
+  return LayerParameter();
+}
+
+static void Benchmark(const LayerParameter& layer_param, int num_threads) {
+  caffe::DataBenchmarkResult result = caffe::BenchmarkDataLayer(layer_param,
+      num_threads, FLAGS_warmup, FLAGS_iterations);
+  std::map<string, double>& category_us = result.category_us;
+  const int batches = result.batches;
+  const int loaded = result.category_count["load_batch"];
+  LOG(INFO) << "*** " << num_threads << " instance(s) of "
+            << layer_param.name() << " (" << layer_param.type() << ") ***";
+  LOG(INFO) << "Produced " << batches << " batches, " << result.images
+            << " images in " << result.seconds << " s.";
+  LOG(INFO) << "Throughput: " << result.images / result.seconds
+            << " images/s, " << batches / result.seconds << " batches/s.";
+  LOG(INFO) << "Per consumed batch: forward "
+            << result.forward_us / batches / 1000
+            << " ms, prefetch queue wait "
+            << category_us["data_wait"] / batches / 1000 << " ms.";
+  if (loaded > 0) {
+    LOG(INFO) << "Per prefetched batch (" << loaded << " batches): load "
+              << category_us["load_batch"] / loaded / 1000 << " ms, read "
+              << category_us["data_read"] / loaded / 1000 << " ms, transform "
+              << category_us["data_transform"] / loaded / 1000 << " ms.";
+  } else {
+    LOG(INFO) << "The layer does not prefetch: the forward time is its "
+              << "read and transform time.";
+  }
+  const Profiler& profiler = Profiler::Get();
+  if (profiler.dropped() > 0) {
+    LOG(WARNING) << profiler.dropped() << " profile events were dropped; "
+                 << "the breakdown is incomplete.";
+  }
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Measure the throughput of a data layer alone.\n"
+      "Usage:\n"
+      "    data_benchmark -model NET_PROTOTXT [-layer NAME] "
+      "[-threads 1,2,4]\n");
+  caffe::GlobalInit(&argc, &argv);
+  if (FLAGS_model.empty()) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/data_benchmark");
+    return 1;
+  }
+  CHECK_GT(FLAGS_iterations, 0) << "Need at least one batch to time.";
+  CHECK_GE(FLAGS_warmup, 0) << "The number of warm-up batches is negative.";
+  Caffe::set_mode(Caffe::CPU);
+  const LayerParameter layer_param = GetLayerParameter();
+
+  vector<string> thread_counts;
+  boost::split(thread_counts, FLAGS_threads, boost::is_any_of(","));
+  // Leave room for a few events per batch of every instance.
+  int max_threads = 1;
+  for (int i = 0; i < thread_counts.size(); ++i) {
+    max_threads = std::max(max_threads,
+        boost::lexical_cast<int>(thread_counts[i]));
+  }
+  Profiler::Get().Enable(
+      8 * max_threads * (FLAGS_warmup + FLAGS_iterations + 4));
+  for (int i = 0; i < thread_counts.size(); ++i) {
+    const int num_threads = boost::lexical_cast<int>(thread_counts[i]);
+    CHECK_GT(num_threads, 0) << "Need at least one layer instance.";
+    Benchmark(layer_param, num_threads);
+  }
+  return 0;
+}
@@ -1,8 +1,13 @@
+#include <cstdio>
+#include <deque>
+#include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
+#include "boost/thread.hpp"
 #include "google/protobuf/text_format.h"
+#include "hdf5.h"
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
@@ -11,6 +16,7 @@
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 
 using caffe::Blob;
 using caffe::Caffe;
@@ -19,6 +25,233 @@ using caffe::Net;
 using std::string;
 namespace db = caffe::db;
 
+// The number of batches of features in flight between the forward passes
+// and the writer thread.
+const int kNumSlots = 3;
+
+// Returns the features as float32, converted into buffer unless they already
+// are.
+template <typename Dtype>
+const float* FloatFeatures(const Blob<Dtype>& features,
+    std::vector<float>* buffer) {
+  buffer->assign(features.cpu_data(), features.cpu_data() + features.count());
+  return buffer->empty() ? NULL : &(*buffer)[0];
+}
+
+template <>
+const float* FloatFeatures(const Blob<float>& features,
+    std::vector<float>* buffer) {
+  return features.cpu_data();
+}
+
+// Writes the features of one blob, a batch at a time.
+template <typename Dtype>
+class FeatureWriter {
+ public:
+  virtual ~FeatureWriter() {}
+  virtual void Write(const Blob<Dtype>& features) = 0;
+  virtual void Close() = 0;
+};
+
+// Writes each feature as a Datum of float_data into a LevelDB or LMDB,
+// committing every 1000 records.
+template <typename Dtype>
+class DBFeatureWriter : public FeatureWriter<Dtype> {
+ public:
+  DBFeatureWriter(const string& db_type, const string& name,
+      const string& blob_name)
+      : db_(db::GetDB(db_type)), blob_name_(blob_name), count_(0) {
+    db_->Open(name, db::NEW);
+    txn_.reset(db_->NewTransaction());
+  }
+  virtual void Write(const Blob<Dtype>& features) {
+    const int batch_size = features.num();
+    const int dim_features = features.count() / batch_size;
+    datum_.set_channels(features.channels());
+    datum_.set_height(features.height());
+    datum_.set_width(features.width());
+    datum_.clear_data();
+    datum_.mutable_float_data()->Resize(dim_features, 0);
+    string out;
+    for (int n = 0; n < batch_size; ++n) {
+      const Dtype* data = features.cpu_data() + features.offset(n);
+      float* datum_data = datum_.mutable_float_data()->mutable_data();
+      for (int d = 0; d < dim_features; ++d) {
+        datum_data[d] = data[d];
+      }
+      CHECK(datum_.SerializeToString(&out));
+      txn_->Put(caffe::format_int(count_, 10), out);
+      if (++count_ % 1000 == 0) {
+        txn_->Commit();
+        txn_.reset(db_->NewTransaction());
+        LOG(ERROR)<< "Extracted features of " << count_ <<
+            " query images for feature blob " << blob_name_;
+      }
+    }
+  }
+  virtual void Close() {
+    if (count_ % 1000 != 0) {
+      txn_->Commit();
+    }
+    LOG(ERROR)<< "Extracted features of " << count_ <<
+        " query images for feature blob " << blob_name_;
+    db_->Close();
+  }
+
+ protected:
+  boost::shared_ptr<db::DB> db_;
+  boost::shared_ptr<db::Transaction> txn_;
+  const string blob_name_;
+  Datum datum_;
+  int count_;
+};
+
+// Appends the features as raw float32 to a file meant to be memory-mapped,
+// e.g. with numpy.memmap, and writes their shape, the number of features
+// first, as text to the file name followed by ".shape".
+template <typename Dtype>
+class RawFeatureWriter : public FeatureWriter<Dtype> {
+ public:
+  RawFeatureWriter(const string& name, const string& blob_name)
+      : name_(name), blob_name_(blob_name), count_(0) {
+    file_ = fopen(name.c_str(), "wb");
+    CHECK(file_) << "Cannot write " << name;
+  }
+  virtual void Write(const Blob<Dtype>& features) {
+    CHECK_GT(features.num_axes(), 0) << blob_name_ << " has no item axis.";
+    if (count_ == 0) {
+      shape_ = features.shape();
+    }
+    // Only the number of items may change.
+    std::vector<int> shape(features.shape());
+    shape[0] = shape_[0];
+    CHECK(shape == shape_) << "The shape of " << blob_name_ << " changed.";
+    CHECK_EQ(fwrite(FloatFeatures(features, &buffer_), sizeof(float),
+        features.count(), file_), features.count())
+        << "Cannot write " << name_;
+    count_ += features.shape(0);
+  }
+  virtual void Close() {
+    CHECK_EQ(fclose(file_), 0) << "Cannot write " << name_;
+    std::ofstream shape_file((name_ + ".shape").c_str());
+    shape_file << count_;
+    for (int i = 1; i < shape_.size(); ++i) {
+      shape_file << " " << shape_[i];
+    }
+    shape_file << "\n";
+    LOG(ERROR)<< "Extracted features of " << count_ <<
+        " query images for feature blob " << blob_name_;
+  }
+
+ protected:
+  const string name_;
+  const string blob_name_;
+  FILE* file_;
+  std::vector<int> shape_;
+  std::vector<float> buffer_;
+  int count_;
+};
+
+// Appends the features to a float32 dataset named after the blob in an
+// HDF5 file, growing along its first axis.
+template <typename Dtype>
+class HDF5FeatureWriter : public FeatureWriter<Dtype> {
+ public:
+  HDF5FeatureWriter(const string& name, const string& blob_name)
+      : name_(name), blob_name_(blob_name), dataset_(-1), count_(0) {
+    file_ = H5Fcreate(name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    CHECK_GE(file_, 0) << "Cannot create " << name;
+  }
+  virtual void Write(const Blob<Dtype>& features) {
+    const int num_axes = features.num_axes();
+    CHECK_GT(num_axes, 0) << blob_name_ << " has no item axis.";
+    std::vector<hsize_t> dims(features.shape().begin(), features.shape().end());
+    if (dataset_ < 0) {
+      std::vector<hsize_t> max_dims(dims);
+      max_dims[0] = H5S_UNLIMITED;
+      hid_t space = H5Screate_simple(num_axes, &dims[0], &max_dims[0]);
+      hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+      CHECK_GE(H5Pset_chunk(properties, num_axes, &dims[0]), 0);
+      dataset_ = H5Dcreate2(file_, blob_name_.c_str(), H5T_NATIVE_FLOAT,
+          space, H5P_DEFAULT, properties, H5P_DEFAULT);
+      CHECK_GE(dataset_, 0) << "Cannot create dataset " << blob_name_;
+      H5Pclose(properties);
+      H5Sclose(space);
+    } else {
+      std::vector<hsize_t> extent(dims);
+      extent[0] = count_ + dims[0];
+      CHECK_GE(H5Dset_extent(dataset_, &extent[0]), 0)
+          << "Cannot grow dataset " << blob_name_;
+    }
+    hid_t file_space = H5Dget_space(dataset_);
+    std::vector<hsize_t> start(num_axes, 0);
+    start[0] = count_;
+    CHECK_GE(H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &start[0], NULL,
+        &dims[0], NULL), 0);
+    hid_t memory_space = H5Screate_simple(num_axes, &dims[0], NULL);
+    CHECK_GE(H5Dwrite(dataset_, H5T_NATIVE_FLOAT, memory_space, file_space,
+        H5P_DEFAULT, FloatFeatures(features, &buffer_)), 0)
+        << "Cannot write " << name_;
+    H5Sclose(memory_space);
+    H5Sclose(file_space);
+    count_ += dims[0];
+  }
+  virtual void Close() {
+    if (dataset_ >= 0) {
+      H5Dclose(dataset_);
+    }
+    CHECK_GE(H5Fclose(file_), 0) << "Cannot write " << name_;
+    LOG(ERROR)<< "Extracted features of " << count_ <<
+        " query images for feature blob " << blob_name_;
+  }
+
+ protected:
+  const string name_;
+  const string blob_name_;
+  hid_t file_;
+  hid_t dataset_;
+  std::vector<float> buffer_;
+  int count_;
+};
+
+// Slots of feature batches passed between the forward passes and the writer
+// thread; -1 tells the writer to stop.
+class SlotQueue {
+ public:
+  void push(int slot) {
+    boost::mutex::scoped_lock lock(mutex_);
+    slots_.push_back(slot);
+    condition_.notify_one();
+  }
+  int pop() {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (slots_.empty()) {
+      condition_.wait(lock);
+    }
+    const int slot = slots_.front();
+    slots_.pop_front();
+    return slot;
+  }
+
+ private:
+  std::deque<int> slots_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+};
+
+template <typename Dtype>
+void write_features(
+    const std::vector<std::vector<boost::shared_ptr<Blob<Dtype> > > >* slots,
+    const std::vector<boost::shared_ptr<FeatureWriter<Dtype> > >* writers,
+    SlotQueue* free_slots, SlotQueue* full_slots) {
+  for (int slot = full_slots->pop(); slot >= 0; slot = full_slots->pop()) {
+    for (int i = 0; i < writers->size(); ++i) {
+      (*writers)[i]->Write(*(*slots)[slot][i]);
+    }
+    free_slots->push(slot);
+  }
+}
+
 template<typename Dtype>
 int feature_extraction_pipeline(int argc, char** argv);
 
@@ -42,7 +275,10 @@ int feature_extraction_pipeline(int argc, char** argv) {
     "Note: you can extract multiple features in one pass by specifying"
     " multiple feature blob names and dataset names separated by ','."
     " The names cannot contain white space characters and the number of blobs"
-    " and datasets must be equal.";
+    " and datasets must be equal.\n"
+    "db_type is leveldb or lmdb to store Datums, raw to write float32 files"
+    " to memory-map, with their shape in <dataset_name>.shape, or hdf5 to"
+    " write a dataset named after the blob to each HDF5 file.";
     return 1;
   }
   int arg_pos = num_required_args;
@@ -118,64 +354,57 @@ int feature_extraction_pipeline(int argc, char** argv) {
 
   int num_mini_batches = atoi(argv[++arg_pos]);
 
-  std::vector<boost::shared_ptr<db::DB> > feature_dbs;
-  std::vector<boost::shared_ptr<db::Transaction> > txns;
-  const char* db_type = argv[++arg_pos];
+  const string db_type(argv[++arg_pos]);
+  std::vector<boost::shared_ptr<FeatureWriter<Dtype> > > writers;
   for (size_t i = 0; i < num_features; ++i) {
     LOG(INFO)<< "Opening dataset " << dataset_names[i];
-    boost::shared_ptr<db::DB> db(db::GetDB(db_type));
-    db->Open(dataset_names.at(i), db::NEW);
-    feature_dbs.push_back(db);
-    boost::shared_ptr<db::Transaction> txn(db->NewTransaction());
-    txns.push_back(txn);
+    if (db_type == "raw") {
+      writers.push_back(boost::shared_ptr<FeatureWriter<Dtype> >(
+          new RawFeatureWriter<Dtype>(dataset_names[i], blob_names[i])));
+    } else if (db_type == "hdf5") {
+      writers.push_back(boost::shared_ptr<FeatureWriter<Dtype> >(
+          new HDF5FeatureWriter<Dtype>(dataset_names[i], blob_names[i])));
+    } else {
+      writers.push_back(boost::shared_ptr<FeatureWriter<Dtype> >(
+          new DBFeatureWriter<Dtype>(db_type, dataset_names[i],
+                                     blob_names[i])));
+    }
   }
 
+  // The writer thread serializes the features of a batch while the next
+  // batches run forward.
+  std::vector<std::vector<boost::shared_ptr<Blob<Dtype> > > > slots(
+      kNumSlots);
+  SlotQueue free_slots, full_slots;
+  for (int slot = 0; slot < kNumSlots; ++slot) {
+    for (size_t i = 0; i < num_features; ++i) {
+      slots[slot].push_back(
+          boost::shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    }
+    free_slots.push(slot);
+  }
+  boost::thread writer(&write_features<Dtype>, &slots, &writers,
+      &free_slots, &full_slots);
+
   LOG(ERROR)<< "Extracting Features";
 
-  Datum datum;
-  std::vector<int> image_indices(num_features, 0);
   for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index) {
     feature_extraction_net->Forward();
-    for (int i = 0; i < num_features; ++i) {
-      const boost::shared_ptr<Blob<Dtype> > feature_blob =
-        feature_extraction_net->blob_by_name(blob_names[i]);
-      int batch_size = feature_blob->num();
-      int dim_features = feature_blob->count() / batch_size;
-      const Dtype* feature_blob_data;
-      for (int n = 0; n < batch_size; ++n) {
-        datum.set_height(feature_blob->height());
-        datum.set_width(feature_blob->width());
-        datum.set_channels(feature_blob->channels());
-        datum.clear_data();
-        datum.clear_float_data();
-        feature_blob_data = feature_blob->cpu_data() +
-            feature_blob->offset(n);
-        for (int d = 0; d < dim_features; ++d) {
-          datum.add_float_data(feature_blob_data[d]);
-        }
-        string key_str = caffe::format_int(image_indices[i], 10);
-
-        string out;
-        CHECK(datum.SerializeToString(&out));
-        txns.at(i)->Put(key_str, out);
-        ++image_indices[i];
-        if (image_indices[i] % 1000 == 0) {
-          txns.at(i)->Commit();
-          txns.at(i).reset(feature_dbs.at(i)->NewTransaction());
-          LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-              " query images for feature blob " << blob_names[i];
-        }
-      }  // for (int n = 0; n < batch_size; ++n)
-    }  // for (int i = 0; i < num_features; ++i)
-  }  // for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index)
-  // write the last batch
-  for (int i = 0; i < num_features; ++i) {
-    if (image_indices[i] % 1000 != 0) {
-      txns.at(i)->Commit();
+    const int slot = free_slots.pop();
+    for (size_t i = 0; i < num_features; ++i) {
+      const Blob<Dtype>& feature_blob =
+          *feature_extraction_net->blob_by_name(blob_names[i]);
+      Blob<Dtype>* copy = slots[slot][i].get();
+      copy->ReshapeLike(feature_blob);
+      caffe::caffe_copy(feature_blob.count(), feature_blob.cpu_data(),
+          copy->mutable_cpu_data());
     }
-    LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-        " query images for feature blob " << blob_names[i];
-    feature_dbs.at(i)->Close();
+    full_slots.push(slot);
+  }
+  full_slots.push(-1);
+  writer.join();
+  for (size_t i = 0; i < num_features; ++i) {
+    writers[i]->Close();
   }
 
   LOG(ERROR)<< "Successfully extracted the features!";
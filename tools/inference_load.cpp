@@ -0,0 +1,147 @@
+// This program loads an inference_server with concurrent clients and reports
+// the latency and throughput at each level of concurrency.
+// Usage:
+//    inference_load [-socket /tmp/caffe_inference.sock]
+//        [-concurrency 1,2,4,8,16] [-requests 200] [-csv curve.csv]
+//
+// Each client opens its own connection and sends its requests one after the
+// other, each as soon as the previous reply arrived, so the concurrency is the
+// number of requests in flight. The inputs are random.
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "boost/lexical_cast.hpp"
+#include "boost/thread.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/socket.hpp"
+
+using caffe::CPUTimer;
+using caffe::Percentile;
+using caffe::ReadAll;
+using caffe::WriteAll;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_string(socket, "/tmp/caffe_inference.sock",
+    "The Unix domain socket of the inference_server.");
+DEFINE_string(concurrency, "1,2,4,8,16",
+    "Comma-separated numbers of concurrent clients to measure.");
+DEFINE_int32(requests, 200,
+    "The number of timed requests each client sends.");
+DEFINE_int32(warmup, 10,
+    "The number of untimed requests each client first sends.");
+DEFINE_string(csv, "",
+    "Optional; file to write the latency/throughput curve to as CSV.");
+
+static int Connect() {
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(fd, 0) << "Cannot create a socket: " << strerror(errno);
+  sockaddr_un address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, FLAGS_socket.c_str(),
+      sizeof(address.sun_path) - 1);
+  CHECK_EQ(connect(fd, reinterpret_cast<sockaddr*>(&address),
+                   sizeof(address)), 0)
+      << "Cannot connect to " << FLAGS_socket << ": " << strerror(errno);
+  return fd;
+}
+
+// Sends the requests of one client, recording their latencies in us.
+static void RunClient(vector<double>* latencies) {
+  const int fd = Connect();
+  uint32_t header[2];
+  CHECK(ReadAll(fd, header, sizeof(header))) << "No header from the server.";
+  vector<float> input(header[0]);
+  vector<float> output(header[1]);
+  caffe::caffe_rng_uniform<float>(input.size(), -0.5, 0.5, input.data());
+  CPUTimer timer;
+  for (int i = 0; i < FLAGS_warmup + FLAGS_requests; ++i) {
+    timer.Start();
+    CHECK(WriteAll(fd, input.data(), input.size() * sizeof(float)))
+        << "The server closed the connection.";
+    CHECK(ReadAll(fd, output.data(), output.size() * sizeof(float)))
+        << "The server closed the connection.";
+    if (i >= FLAGS_warmup) {
+      latencies->push_back(timer.MicroSeconds());
+    }
+  }
+  close(fd);
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Measure the latency and throughput of an "
+      "inference_server.\n"
+      "Usage:\n"
+      "    inference_load [-socket PATH] [-concurrency 1,2,4,8,16]\n");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_requests, 0) << "Need at least one request to time.";
+  CHECK_GE(FLAGS_warmup, 0) << "The number of warm-up requests is negative.";
+  vector<string> levels;
+  boost::split(levels, FLAGS_concurrency, boost::is_any_of(","));
+  std::ofstream csv;
+  if (!FLAGS_csv.empty()) {
+    csv.open(FLAGS_csv.c_str());
+    CHECK(csv.good()) << "Cannot write " << FLAGS_csv;
+    csv << "concurrency,requests,seconds,requests_per_second,mean_ms,"
+        << "p50_ms,p90_ms,p99_ms,max_ms\n";
+  }
+  for (int i = 0; i < levels.size(); ++i) {
+    const int num_clients = boost::lexical_cast<int>(levels[i]);
+    CHECK_GT(num_clients, 0) << "Need at least one client.";
+    vector<vector<double> > client_latencies(num_clients);
+    CPUTimer timer;
+    timer.Start();
+    boost::thread_group clients;
+    for (int j = 0; j < num_clients; ++j) {
+      clients.create_thread(boost::bind(&RunClient, &client_latencies[j]));
+    }
+    clients.join_all();
+    // Includes the warm-up requests, which all clients send concurrently.
+    const double seconds = timer.MicroSeconds() / 1e6;
+    vector<double> latencies;
+    for (int j = 0; j < num_clients; ++j) {
+      latencies.insert(latencies.end(), client_latencies[j].begin(),
+          client_latencies[j].end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (int j = 0; j < latencies.size(); ++j) {
+      sum += latencies[j];
+    }
+    const int requests = num_clients * (FLAGS_warmup + FLAGS_requests);
+    // No latency is recorded with -requests 0.
+    const double mean_ms =
+        latencies.empty() ? 0 : sum / latencies.size() / 1000;
+    const double max_ms = latencies.empty() ? 0 : latencies.back() / 1000;
+    LOG(INFO) << num_clients << " client(s): " << requests / seconds
+              << " requests/s, latency mean " << mean_ms << " ms, p50 "
+              << Percentile(latencies, 50) / 1000 << " ms, p90 "
+              << Percentile(latencies, 90) / 1000 << " ms, p99 "
+              << Percentile(latencies, 99) / 1000 << " ms, max "
+              << max_ms << " ms.";
+    if (csv.is_open()) {
+      csv << num_clients << "," << requests << "," << seconds << ","
+          << requests / seconds << "," << mean_ms << ","
+          << Percentile(latencies, 50) / 1000 << ","
+          << Percentile(latencies, 90) / 1000 << ","
+          << Percentile(latencies, 99) / 1000 << ","
+          << max_ms << "\n";
+    }
+  }
+  return 0;
+}
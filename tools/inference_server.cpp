@@ -0,0 +1,243 @@
+// This program serves a net to local clients over a Unix domain socket,
+// running their single-item requests in dynamic batches.
+// Usage:
+//    inference_server -model deploy.prototxt [-weights net.caffemodel]
+//        [-socket /tmp/caffe_inference.sock] [-max_batch 16]
+//        [-batch_timeout_us 2000] [-workers 1]
+//
+// Requests are queued as they arrive. A worker takes the oldest one and then
+// waits up to batch_timeout_us for more, until it has max_batch of them; it
+// reshapes the input blob to that many items, runs the net once and replies
+// to each request with its slice of the outputs. Each worker runs its own
+// context of a shared InferenceSession, so the weights are held once.
+//
+// Protocol, in native byte order: on connection, the server sends two
+// uint32, the numbers of floats of one input item and of one output item.
+// The client then sends requests, each the floats of one input item, and
+// gets back for each the floats of its output item: the item's slice of
+// every output blob of the net, in order. A connection has one request in
+// flight at a time; clients open several connections for concurrency.
+// See inference_load for a client.
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "boost/thread.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/inference_session.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/socket.hpp"
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::InferenceContext;
+using caffe::InferenceSession;
+using caffe::Net;
+using caffe::ReadAll;
+using caffe::shared_ptr;
+using caffe::string;
+using caffe::vector;
+using caffe::WriteAll;
+
+DEFINE_string(model, "",
+    "The deploy net definition, with a single input blob.");
+DEFINE_string(weights, "",
+    "Optional; the trained weights of the net.");
+DEFINE_string(socket, "/tmp/caffe_inference.sock",
+    "The path of the Unix domain socket to listen on.");
+DEFINE_int32(max_batch, 16,
+    "The maximum number of requests run in one batch.");
+DEFINE_int32(batch_timeout_us, 2000,
+    "How long a worker waits for more requests after the first one of a "
+    "batch, in microseconds.");
+DEFINE_int32(workers, 1,
+    "The number of batches run concurrently.");
+DEFINE_int32(gpu, -1,
+    "Optional; run on this GPU instead of the CPU.");
+
+// One item to run, and its outputs once done.
+struct Request {
+  Request() : done(false) {}
+  vector<float> input;
+  vector<float> output;
+  bool done;
+  boost::mutex mutex;
+  boost::condition_variable condition;
+};
+
+// The requests waiting for a batch.
+class RequestQueue {
+ public:
+  void Push(Request* request) {
+    boost::mutex::scoped_lock lock(mutex_);
+    requests_.push_back(request);
+    condition_.notify_one();
+  }
+
+  // Waits for a request, then for more until max_batch or timeout_us after
+  // the first one.
+  void PopBatch(int max_batch, int timeout_us, vector<Request*>* batch) {
+    batch->clear();
+    boost::mutex::scoped_lock lock(mutex_);
+    while (requests_.empty()) {
+      condition_.wait(lock);
+    }
+    const boost::system_time deadline = boost::get_system_time() +
+        boost::posix_time::microseconds(timeout_us);
+    while (batch->size() < max_batch) {
+      if (requests_.empty() && !condition_.timed_wait(lock, deadline)) {
+        break;
+      }
+      while (!requests_.empty() && batch->size() < max_batch) {
+        batch->push_back(requests_.front());
+        requests_.pop_front();
+      }
+    }
+  }
+
+ private:
+  std::deque<Request*> requests_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+};
+
+static void RunWorker(const InferenceSession<float>* session,
+    RequestQueue* queue) {
+  shared_ptr<InferenceContext<float> > context = session->CreateContext();
+  Net<float>* net = context->net();
+  Blob<float>* input = net->input_blobs()[0];
+  vector<int> shape = input->shape();
+  vector<Request*> batch;
+  while (true) {
+    queue->PopBatch(FLAGS_max_batch, FLAGS_batch_timeout_us, &batch);
+    shape[0] = batch.size();
+    input->Reshape(shape);
+    net->Reshape();
+    const int item_count = input->count(1);
+    for (int i = 0; i < batch.size(); ++i) {
+      std::copy(batch[i]->input.begin(), batch[i]->input.end(),
+          input->mutable_cpu_data() + i * item_count);
+    }
+    const vector<Blob<float>*>& outputs = context->Forward();
+    for (int i = 0; i < batch.size(); ++i) {
+      Request* request = batch[i];
+      request->output.clear();
+      for (int j = 0; j < outputs.size(); ++j) {
+        const int output_count = outputs[j]->count(1);
+        const float* output = outputs[j]->cpu_data() + i * output_count;
+        request->output.insert(request->output.end(), output,
+            output + output_count);
+      }
+      boost::mutex::scoped_lock lock(request->mutex);
+      request->done = true;
+      request->condition.notify_one();
+    }
+  }
+}
+
+static void ServeConnection(int fd, uint32_t input_count,
+    uint32_t output_count, RequestQueue* queue) {
+  const uint32_t header[2] = {input_count, output_count};
+  Request request;
+  request.input.resize(input_count);
+  if (WriteAll(fd, header, sizeof(header))) {
+    while (ReadAll(fd, request.input.data(), input_count * sizeof(float))) {
+      request.done = false;
+      queue->Push(&request);
+      {
+        boost::mutex::scoped_lock lock(request.mutex);
+        while (!request.done) {
+          request.condition.wait(lock);
+        }
+      }
+      if (!WriteAll(fd, request.output.data(),
+                    output_count * sizeof(float))) {
+        break;
+      }
+    }
+  }
+  close(fd);
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Serve a net to local clients, batching their "
+      "requests.\n"
+      "Usage:\n"
+      "    inference_server -model DEPLOY_PROTOTXT [-weights CAFFEMODEL] "
+      "[-socket PATH]\n");
+  caffe::GlobalInit(&argc, &argv);
+  if (FLAGS_model.empty()) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/inference_server");
+    return 1;
+  }
+  CHECK_GT(FLAGS_max_batch, 0) << "A batch holds at least one request.";
+  CHECK_GE(FLAGS_batch_timeout_us, 0) << "The batch timeout is negative.";
+  CHECK_GT(FLAGS_workers, 0) << "Need at least one worker.";
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+
+  InferenceSession<float> session(FLAGS_model, FLAGS_weights);
+  const Net<float>& net = session.weights();
+  CHECK_EQ(net.num_inputs(), 1) << "The net must have a single input.";
+  CHECK_GT(net.input_blobs()[0]->num_axes(), 0)
+      << "The input of the net must have a batch axis.";
+  const uint32_t input_count = net.input_blobs()[0]->count(1);
+  uint32_t output_count = 0;
+  for (int i = 0; i < net.num_outputs(); ++i) {
+    CHECK_GT(net.output_blobs()[i]->num_axes(), 0)
+        << "The outputs of the net must have a batch axis.";
+    output_count += net.output_blobs()[i]->count(1);
+  }
+
+  const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(listen_fd, 0) << "Cannot create a socket: " << strerror(errno);
+  sockaddr_un address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+  CHECK_LT(FLAGS_socket.size(), sizeof(address.sun_path))
+      << "The socket path is too long.";
+  strncpy(address.sun_path, FLAGS_socket.c_str(),
+      sizeof(address.sun_path) - 1);
+  unlink(FLAGS_socket.c_str());
+  CHECK_EQ(bind(listen_fd, reinterpret_cast<sockaddr*>(&address),
+                sizeof(address)), 0)
+      << "Cannot bind " << FLAGS_socket << ": " << strerror(errno);
+  CHECK_EQ(listen(listen_fd, SOMAXCONN), 0)
+      << "Cannot listen on " << FLAGS_socket << ": " << strerror(errno);
+
+  RequestQueue queue;
+  boost::thread_group workers;
+  for (int i = 0; i < FLAGS_workers; ++i) {
+    workers.create_thread(boost::bind(&RunWorker, &session, &queue));
+  }
+  LOG(INFO) << "Serving " << FLAGS_model << " on " << FLAGS_socket
+            << ": " << input_count << " input and " << output_count
+            << " output floats per item, batches of up to "
+            << FLAGS_max_batch << " within " << FLAGS_batch_timeout_us
+            << " us, " << FLAGS_workers << " worker(s).";
+  while (true) {
+    const int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      LOG(WARNING) << "Cannot accept a connection: " << strerror(errno);
+      continue;
+    }
+    boost::thread(&ServeConnection, fd, input_count, output_count,
+        &queue).detach();
+  }
+  return 0;
+}
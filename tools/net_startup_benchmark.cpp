@@ -0,0 +1,236 @@
+// This program measures how long a deployed net takes to become ready: to
+// parse its definition, set up its layers, load its weights and run a first
+// forward pass.
+// Usage:
+//    net_startup_benchmark -model deploy.prototxt [-weights net.caffemodel]
+//        [-iterations 10]
+//    net_startup_benchmark -generate 500 [-iterations 10] [-nolog_nets]
+//        [-compiled]
+//
+// Every iteration builds the net from scratch, as a starting process would;
+// the mean and the fastest time of each step are reported, along with the
+// number of layer types the library registers, which is smaller in
+// inference-only builds for a given net. With -generate, the net is a
+// synthetic stack of residual blocks of about the given number of layers, to
+// measure how the start-up scales with the depth of the net. With -compiled,
+// the net is compiled once, as by compile_net, and every iteration parses the
+// compiled binary form instead of the text.
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "google/protobuf/text_format.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using caffe::Caffe;
+using caffe::CPUTimer;
+using caffe::LayerRegistry;
+using caffe::Net;
+using caffe::LayerParameter;
+using caffe::NetParameter;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_string(model, "",
+    "The deploy net definition protocol buffer text file.");
+DEFINE_string(weights, "",
+    "Optional; the trained weights to load into the net.");
+DEFINE_int32(iterations, 10,
+    "The number of times the net is built from scratch.");
+DEFINE_int32(gpu, -1,
+    "Optional; run in GPU mode on the given device.");
+DEFINE_bool(log_nets, true,
+    "Whether the nets describe themselves as they are built; without it, "
+    "they are built as in deployments that do not show INFO messages.");
+DEFINE_int32(generate, 0,
+    "Optional; instead of -model, time a generated net of about this many "
+    "layers.");
+DEFINE_bool(compiled, false,
+    "Whether to time the net compiled, as deployed from a .caffenet file.");
+
+// The times of one step over the iterations, in milliseconds.
+struct StepTimes {
+  explicit StepTimes(const string& name)
+      : name(name), total(0), fastest(std::numeric_limits<double>::max()) {}
+  void Add(double ms) {
+    total += ms;
+    fastest = std::min(fastest, ms);
+  }
+  void Report(int iterations) const {
+    LOG(INFO) << std::setw(14) << name << ": " << total / iterations
+              << " ms mean, " << fastest << " ms fastest.";
+  }
+
+  string name;
+  double total;
+  double fastest;
+};
+
+// Adds a 3x3 convolution of bottom to top, keeping its shape.
+void AddConvolution(const string& name, const string& bottom,
+    const string& top, NetParameter* param) {
+  LayerParameter* layer = param->add_layer();
+  layer->set_name(name);
+  layer->set_type("Convolution");
+  layer->add_bottom(bottom);
+  layer->add_top(top);
+  caffe::ConvolutionParameter* conv = layer->mutable_convolution_param();
+  conv->set_num_output(16);
+  conv->add_kernel_size(3);
+  conv->add_pad(1);
+  conv->mutable_weight_filler()->set_type("gaussian");
+  conv->mutable_weight_filler()->set_std(0.01);
+}
+
+// Adds an in-place ReLU of blob.
+void AddReLU(const string& name, const string& blob, NetParameter* param) {
+  LayerParameter* layer = param->add_layer();
+  layer->set_name(name);
+  layer->set_type("ReLU");
+  layer->add_bottom(blob);
+  layer->add_top(blob);
+}
+
+// Generates a net of residual blocks of five layers each: two convolutions
+// with their ReLUs, and the sum with the input of the block, which takes a
+// split of it.
+void GenerateNet(int num_layers, NetParameter* param) {
+  param->set_name("generated");
+  LayerParameter* input = param->add_layer();
+  input->set_name("data");
+  input->set_type("Input");
+  input->add_top("data");
+  caffe::BlobShape* shape = input->mutable_input_param()->add_shape();
+  shape->add_dim(1);
+  shape->add_dim(16);
+  shape->add_dim(14);
+  shape->add_dim(14);
+  string block_input = "data";
+  for (int block = 0; param->layer_size() + 5 <= num_layers; ++block) {
+    const string prefix = "block" + caffe::format_int(block);
+    AddConvolution(prefix + "_conv1", block_input, prefix + "_conv1", param);
+    AddReLU(prefix + "_relu1", prefix + "_conv1", param);
+    AddConvolution(prefix + "_conv2", prefix + "_conv1", prefix + "_conv2",
+        param);
+    LayerParameter* sum = param->add_layer();
+    sum->set_name(prefix + "_sum");
+    sum->set_type("Eltwise");
+    sum->add_bottom(block_input);
+    sum->add_bottom(prefix + "_conv2");
+    sum->add_top(prefix + "_sum");
+    AddReLU(prefix + "_relu2", prefix + "_sum", param);
+    block_input = prefix + "_sum";
+  }
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Measure how long a net takes to get ready.\n"
+      "Usage:\n"
+      "    net_startup_benchmark -model DEPLOY_PROTOTXT [-weights WEIGHTS]\n"
+      "    net_startup_benchmark -generate NUM_LAYERS\n");
+  caffe::GlobalInit(&argc, &argv);
+  if (FLAGS_model.empty() == (FLAGS_generate <= 0)) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0],
+        "tools/net_startup_benchmark");
+    return 1;
+  }
+  CHECK_GT(FLAGS_iterations, 0) << "Need at least one iteration to time.";
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+  LOG(INFO) << LayerRegistry<float>::LayerTypeList().size()
+            << " layer types registered.";
+  // The generated net is parsed from text as a model file would be.
+  string generated;
+  if (FLAGS_generate > 0) {
+    NetParameter param;
+    GenerateNet(FLAGS_generate, &param);
+    google::protobuf::TextFormat::PrintToString(param, &generated);
+    FLAGS_model = "a generated net of " + caffe::format_int(param.layer_size())
+        + " layers";
+  }
+  // The compiled net, in binary, with the shapes of its tops.
+  string compiled;
+  if (FLAGS_compiled) {
+    NetParameter param;
+    if (generated.empty()) {
+      caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+    } else {
+      CHECK(google::protobuf::TextFormat::ParseFromString(generated, &param));
+    }
+    param.mutable_state()->set_phase(caffe::TEST);
+    NetParameter compiled_param;
+    Net<float>::Compile(param, &compiled_param);
+    Net<float> net(compiled_param);
+    net.RecordTopShapes(&compiled_param);
+    compiled_param.SerializeToString(&compiled);
+    FLAGS_model += " (compiled)";
+  }
+
+  StepTimes parse("parse"), init("init"), weights("load weights"),
+      forward("first forward"), total("total");
+  CPUTimer timer, total_timer;
+  const int min_log_level = FLAGS_minloglevel;
+  if (!FLAGS_log_nets) {
+    FLAGS_minloglevel = std::max<int>(min_log_level, google::GLOG_WARNING);
+  }
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    total_timer.Start();
+    timer.Start();
+    NetParameter param;
+    if (!compiled.empty()) {
+      CHECK(param.ParseFromString(compiled));
+      caffe::UpgradeNetAsNeeded(FLAGS_model, &param);
+    } else if (generated.empty()) {
+      caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+    } else {
+      CHECK(google::protobuf::TextFormat::ParseFromString(generated, &param));
+      caffe::UpgradeNetAsNeeded(FLAGS_model, &param);
+    }
+    if (!param.compiled()) {
+      param.mutable_state()->set_phase(caffe::TEST);
+    }
+    parse.Add(timer.MicroSeconds() / 1000);
+
+    timer.Start();
+    boost::scoped_ptr<Net<float> > net(new Net<float>(param));
+    init.Add(timer.MicroSeconds() / 1000);
+
+    timer.Start();
+    if (!FLAGS_weights.empty()) {
+      net->CopyTrainedLayersFrom(FLAGS_weights);
+    }
+    weights.Add(timer.MicroSeconds() / 1000);
+
+    timer.Start();
+    net->Forward();
+    forward.Add(timer.MicroSeconds() / 1000);
+    total.Add(total_timer.MicroSeconds() / 1000);
+  }
+  FLAGS_minloglevel = min_log_level;
+  LOG(INFO) << "*** " << FLAGS_iterations << " start-ups of " << FLAGS_model
+            << " ***";
+  parse.Report(FLAGS_iterations);
+  init.Report(FLAGS_iterations);
+  weights.Report(FLAGS_iterations);
+  forward.Report(FLAGS_iterations);
+  total.Report(FLAGS_iterations);
+  return 0;
+}
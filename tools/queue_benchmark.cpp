@@ -0,0 +1,121 @@
+// This program compares the queues that hand data between threads: the
+// mutex-based BlockingQueue and the lock-free RingQueue, in SPSC and MPMC
+// modes.
+// Usage:
+//    queue_benchmark [-iterations 100000] [-capacity 4]
+//
+// The latency is measured by bouncing an item between two threads through a
+// pair of queues, as a prefetch thread and a data layer pass batches: each
+// round trip is two hand-offs. The throughput is measured by streaming items
+// from one thread to another through a single queue; as BlockingQueue is
+// unbounded, its producer never waits there, while the ring queues make it
+// wait for room as the prefetch queues do.
+#include <string>
+
+#include "boost/bind.hpp"
+#include "boost/thread.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/ring_queue.hpp"
+
+using caffe::BlockingQueue;
+using caffe::CPUTimer;
+using caffe::Datum;
+using caffe::RingQueue;
+using caffe::string;
+
+DEFINE_int32(iterations, 100000,
+    "The number of round trips, and of streamed items, to time.");
+DEFINE_int32(capacity, 4,
+    "The capacity of the ring queues; the prefetch queues hold 3 batches.");
+
+// Returns the items it pops from in to out, count times.
+template <typename Queue>
+void Echo(Queue* in, Queue* out, int count) {
+  for (int i = 0; i < count; ++i) {
+    out->push(in->pop());
+  }
+}
+
+template <typename Queue>
+void Drain(Queue* queue, int count) {
+  for (int i = 0; i < count; ++i) {
+    queue->pop();
+  }
+}
+
+// Times round trips through the queue pair, and streaming through ping.
+template <typename Queue>
+void Benchmark(const string& name, Queue* ping, Queue* pong) {
+  Datum datum;
+  const int iterations = FLAGS_iterations;
+  CPUTimer timer;
+  {
+    boost::thread echo(boost::bind(&Echo<Queue>, ping, pong, iterations));
+    timer.Start();
+    for (int i = 0; i < iterations; ++i) {
+      ping->push(&datum);
+      pong->pop();
+    }
+    timer.Stop();
+    echo.join();
+  }
+  const double round_trip_us = timer.MicroSeconds() / iterations;
+  {
+    boost::thread drain(boost::bind(&Drain<Queue>, ping, iterations));
+    timer.Start();
+    for (int i = 0; i < iterations; ++i) {
+      ping->push(&datum);
+    }
+    drain.join();
+    timer.Stop();
+  }
+  LOG(INFO) << name << ": " << round_trip_us / 2 << " us per hand-off, "
+      << iterations / timer.Seconds() / 1e6 << " M items/s streamed";
+}
+
+// Also reports how often, and how long, the callers of the queues blocked.
+void Benchmark(const string& name, RingQueue<Datum*>* ping,
+    RingQueue<Datum*>* pong) {
+  Benchmark<RingQueue<Datum*> >(name, ping, pong);
+  LOG(INFO) << name << ": blocked " << ping->waits() + pong->waits()
+      << " times for " << (ping->wait_us() + pong->wait_us()) / 1000
+      << " ms in total";
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  ::google::InitGoogleLogging(argv[0]);
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Compare the hand-off latency and throughput of "
+      "the inter-thread queues.\n"
+      "Usage:\n"
+      "    queue_benchmark [-iterations 100000] [-capacity 4]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_iterations, 0) << "Need at least one item to time.";
+
+  {
+    BlockingQueue<Datum*> ping, pong;
+    Benchmark("BlockingQueue", &ping, &pong);
+  }
+  {
+    RingQueue<Datum*> ping(FLAGS_capacity, RingQueue<Datum*>::SPSC);
+    RingQueue<Datum*> pong(FLAGS_capacity, RingQueue<Datum*>::SPSC);
+    Benchmark("RingQueue SPSC", &ping, &pong);
+  }
+  {
+    RingQueue<Datum*> ping(FLAGS_capacity, RingQueue<Datum*>::MPMC);
+    RingQueue<Datum*> pong(FLAGS_capacity, RingQueue<Datum*>::MPMC);
+    Benchmark("RingQueue MPMC", &ping, &pong);
+  }
+  return 0;
+}